@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# f-crm-cli: The f-crm data layer on the command line.
+# No QtWidgets, so it starts fast and runs without a display.
+#
+#-------------------------------------------------
+
+QT       = core gui sql
+TARGET = f-crm-cli
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+QMAKE_TARGET_COMPANY = The Last Viking LTD
+QMAKE_TARGET_PRODUCT = f-crm-cli
+QMAKE_TARGET_DESCRIPTION = Command line interface for f-crm
+QMAKE_TARGET_COPYRIGHT = Copyright (c) 2018 by Jarle (jgaa) Aase
+
+linux {
+    DIST_DIR = $$(DIST_DIR)
+    isEmpty(DIST_DIR) {
+        DIST_DIR = $$_PRO_FILE_PWD_/../dist/desktop-linux
+    }
+    target.path = $${DIST_DIR}/root/usr/bin
+    INSTALLS += target
+}
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(f-crm-core.pri)
+
+SOURCES += \
+    src/climain.cpp
@@ -0,0 +1,66 @@
+# The data layer, shared by f-crm and f-crm-cli.
+# Nothing in here may depend on QtWidgets.
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/src/database.cpp \
+    $$PWD/src/statementcache.cpp \
+    $$PWD/src/contactnamecache.cpp \
+    $$PWD/src/contactfilter.cpp \
+    $$PWD/src/searchmodel.cpp \
+    $$PWD/src/blobstore.cpp \
+    $$PWD/src/detailcache.cpp \
+    $$PWD/src/importer.cpp \
+    $$PWD/src/exporter.cpp \
+    $$PWD/src/mailingester.cpp \
+    $$PWD/src/filedrop.cpp \
+    $$PWD/src/filemonitor.cpp \
+    $$PWD/src/logging.cpp \
+    $$PWD/src/contactsmodel.cpp \
+    $$PWD/src/channelsmodel.cpp \
+    $$PWD/src/channel.cpp \
+    $$PWD/src/contact.cpp \
+    $$PWD/src/intent.cpp \
+    $$PWD/src/intentsmodel.cpp \
+    $$PWD/src/action.cpp \
+    $$PWD/src/actionsmodel.cpp \
+    $$PWD/src/utility.cpp \
+    $$PWD/src/document.cpp \
+    $$PWD/src/documentsmodel.cpp \
+    $$PWD/src/journalmodel.cpp \
+    $$PWD/src/upcomingmodel.cpp
+
+HEADERS += \
+    $$PWD/src/database.h \
+    $$PWD/src/statementcache.h \
+    $$PWD/src/contactnamecache.h \
+    $$PWD/src/contactfilter.h \
+    $$PWD/src/searchmodel.h \
+    $$PWD/src/blobstore.h \
+    $$PWD/src/detailcache.h \
+    $$PWD/src/importer.h \
+    $$PWD/src/exporter.h \
+    $$PWD/src/mailingester.h \
+    $$PWD/src/filedrop.h \
+    $$PWD/src/filemonitor.h \
+    $$PWD/src/workerhost.h \
+    $$PWD/src/logging.h \
+    $$PWD/src/contactsmodel.h \
+    $$PWD/src/channelsmodel.h \
+    $$PWD/src/channel.h \
+    $$PWD/src/contact.h \
+    $$PWD/src/intent.h \
+    $$PWD/src/intentsmodel.h \
+    $$PWD/src/action.h \
+    $$PWD/src/actionsmodel.h \
+    $$PWD/src/utility.h \
+    $$PWD/src/document.h \
+    $$PWD/src/documentsmodel.h \
+    $$PWD/src/journalmodel.h \
+    $$PWD/src/upcomingmodel.h \
+    $$PWD/src/version.h \
+    $$PWD/src/strategy.h \
+    $$PWD/src/transaction.h \
+    $$PWD/src/ringbuffer.h \
+    $$PWD/src/release.h
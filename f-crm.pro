@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui widgets sql
+QT       += core gui widgets sql network
 TARGET = f-crm
 TEMPLATE = app
 CONFIG += c++14
@@ -45,27 +45,18 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 
+include(f-crm-core.pri)
+
 SOURCES += \
     src/main.cpp \
     src/mainwindow.cpp \
-    src/database.cpp \
-    src/logging.cpp \
-    src/contactsmodel.cpp \
-    src/channelsmodel.cpp \
+    src/searchdialog.cpp \
+    src/refreshscheduler.cpp \
     src/channeldialog.cpp \
-    src/channel.cpp \
     src/persondialog.cpp \
-    src/contact.cpp \
-    src/intent.cpp \
-    src/intentsmodel.cpp \
     src/intentdialog.cpp \
-    src/action.cpp \
     src/actiondialog.cpp \
-    src/actionsmodel.cpp \
-    src/utility.cpp \
     src/actionexecutedialog.cpp \
-    src/document.cpp \
-    src/documentsmodel.cpp \
     src/documentdialog.cpp \
     src/tableviewwithdrop.cpp \
     src/documentproxymodel.cpp \
@@ -74,35 +65,20 @@ SOURCES += \
     src/intentproxymodel.cpp \
     src/actionproxymodel.cpp \
     src/settingsdialog.cpp \
-    src/journalmodel.cpp \
     src/journalproxymodel.cpp \
     src/favoritesdialog.cpp \
-    src/upcomingmodel.cpp \
-    src/aboutdialog.cpp
+    src/aboutdialog.cpp \
+    src/ipcserver.cpp
 
 HEADERS += \
     src/mainwindow.h \
-    src/database.h \
-    src/logging.h \
-    src/version.h \
-    src/contactsmodel.h \
-    src/strategy.h \
-    src/release.h \
-    src/channelsmodel.h \
+    src/searchdialog.h \
+    src/refreshscheduler.h \
     src/channeldialog.h \
-    src/channel.h \
     src/persondialog.h \
-    src/contact.h \
-    src/intent.h \
-    src/intentsmodel.h \
     src/intentdialog.h \
-    src/action.h \
     src/actiondialog.h \
-    src/actionsmodel.h \
-    src/utility.h \
     src/actionexecutedialog.h \
-    src/document.h \
-    src/documentsmodel.h \
     src/documentdialog.h \
     src/tableviewwithdrop.h \
     src/documentproxymodel.h \
@@ -111,11 +87,10 @@ HEADERS += \
     src/intentproxymodel.h \
     src/actionproxymodel.h \
     src/settingsdialog.h \
-    src/journalmodel.h \
     src/journalproxymodel.h \
     src/favoritesdialog.h \
-    src/upcomingmodel.h \
-    src/aboutdialog.h
+    src/aboutdialog.h \
+    src/ipcserver.h
 
 FORMS += \
         ui/mainwindow.ui \
@@ -127,7 +102,8 @@ FORMS += \
     ui/documentdialog.ui \
     ui/settingsdialog.ui \
     ui/favoritesdialog.ui \
-    ui/aboutdialog.ui
+    ui/aboutdialog.ui \
+    ui/searchdialog.ui
 
 RESOURCES += \
     resources.qrc
@@ -1,8 +1,14 @@
+#include <algorithm>
+
+#include <QMessageBox>
+
 #include "src/actiondialog.h"
 #include "ui_actiondialog.h"
 #include "action.h"
 #include "channel.h"
 #include "utility.h"
+#include "journalmodel.h"
+#include "transaction.h"
 
 ActionDialog::ActionDialog(const int contact, QWidget *parent) :
     QDialog(parent),
@@ -32,8 +38,9 @@ ActionDialog::ActionDialog(const int contact, QWidget *parent) :
     }
 
     ui->person->addItem(company, "Company", 0);
-    QSqlQuery persons(QStringLiteral("select id, name from contact where contact = %1 order by name")
-                      .arg(contact));
+    auto& persons = Database::instance().query(
+                QStringLiteral("select id, name from contact where contact = ? order by name"),
+                {contact});
     while(persons.next()) {
         ui->person->addItem(person, persons.value(1).toString(), persons.value(0).toInt());
     }
@@ -67,6 +74,7 @@ void ActionDialog::setRecord(const QSqlRecord &rec)
     ui->fromDate->setDate(date);
     ui->toTime->setDateTime(QDateTime::fromTime_t(rec.value("due_date").toLongLong()));
 
+    loadDependencies(rec.value("intent").toInt(), 0);
     checkAccess();
 }
 
@@ -77,6 +85,7 @@ void ActionDialog::setModel(ActionsModel *model, QModelIndex &ix)
     Q_ASSERT(ix.isValid());
 
     mapper_ = new QDataWidgetMapper(this);
+    model_ = model;
 
     mapper_->setModel(model);
     mapper_->addMapping(ui->state, model->property("state_col").toInt(), "currentData");
@@ -117,9 +126,52 @@ void ActionDialog::setModel(ActionsModel *model, QModelIndex &ix)
         ui->person->setCurrentIndex(ui->person->findData(val));
     }
 
+    action_ = model->data(model->index(ix.row(), model->fieldIndex("id"), {}),
+                          Qt::DisplayRole).toInt();
+    loadDependencies(model->intent(), action_);
     checkAccess();
 }
 
+void ActionDialog::loadDependencies(const int intent, const int action)
+{
+    ui->dependsOn->clear();
+
+    // A new action depends on the last action in the intent,
+    // like when the actions were a plain sequence.
+    const auto current = action ? ActionsModel::dependencies(action) : QList<int>{};
+    QListWidgetItem *last = {};
+
+    auto& actions = Database::instance().query(
+                QStringLiteral("select id, name, state from action where intent = ? and id != ? order by sequence"),
+                {intent, action});
+    while(actions.next()) {
+        const auto id = actions.value(0).toInt();
+        auto item = new QListWidgetItem(
+                    GetActionStateIcon(actions.value(2).toInt()),
+                    actions.value(1).toString(), ui->dependsOn);
+        item->setData(Qt::UserRole, id);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState(current.contains(id) ? Qt::Checked : Qt::Unchecked);
+        last = item;
+    }
+
+    if (!action && last) {
+        last->setCheckState(Qt::Checked);
+    }
+}
+
+QList<int> ActionDialog::selectedDependencies() const
+{
+    QList<int> ids;
+    for(int i = 0; i < ui->dependsOn->count(); ++i) {
+        const auto item = ui->dependsOn->item(i);
+        if (item->checkState() == Qt::Checked) {
+            ids << item->data(Qt::UserRole).toInt();
+        }
+    }
+    return ids;
+}
+
 void ActionDialog::checkAccess()
 {
     if (ui->type->currentData().toInt() == static_cast<int>(ActionType::CHANNEL)) {
@@ -154,16 +206,63 @@ void ActionDialog::accept()
         rec_.setValue("start_date", static_cast<uint>(ToTime(ui->fromDate->date())));
         rec_.setValue("due_date", static_cast<uint>(ui->toTime->dateTime().toTime_t()));
 
-        emit addAction(rec_);
+        emit addAction(rec_, selectedDependencies());
     }
 
     if (mapper_) {
-        mapper_->submit();
+        // The transaction is rolled back before the message box is shown,
+        // so its event loop does not keep the database locked.
+        const auto error = saveEdit();
+        if (!error.isEmpty()) {
+            QMessageBox::warning(this, "Edit Action", error);
+            return;
+        }
     }
 
     QDialog::accept();
 }
 
+QString ActionDialog::saveEdit()
+{
+    // The dependencies and the fields are saved together
+    Transaction transaction;
+
+    auto depends_on = selectedDependencies();
+    auto current = ActionsModel::dependencies(action_);
+    std::sort(depends_on.begin(), depends_on.end());
+    std::sort(current.begin(), current.end());
+    if (current != depends_on) {
+        if (!ActionsModel::setDependencies(action_, depends_on)) {
+            return QStringLiteral("The action can not depend on an action that "
+                                  "(directly or indirectly) depends on it.");
+        }
+
+        if (!JournalModel::instance().addEntry(JournalModel::Type::EDIT_ACTION,
+                                               QStringLiteral("Changed the dependencies of action: %1")
+                                               .arg(ui->name->text()),
+                                               model_->contact(),
+                                               ui->person->currentData().toInt(),
+                                               model_->intent(),
+                                               action_)) {
+            return QStringLiteral("Failed to save the dependencies");
+        }
+    }
+
+    if (!mapper_->submit()) {
+        return QStringLiteral("Failed to save the action");
+    }
+
+    // It may not wait for anything any more
+    model_->releaseAction(action_);
+
+    if (!transaction.commit()) {
+        model_->select();
+        return QStringLiteral("Failed to save the action");
+    }
+
+    return {};
+}
+
 void ActionDialog::reject()
 {
     if (mapper_) {
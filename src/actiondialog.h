@@ -23,14 +23,22 @@ public:
     void setModel(ActionsModel *model, QModelIndex& ix);
 
 signals:
-    void addAction(const QSqlRecord& rec);
+    void addAction(const QSqlRecord& rec, const QList<int>& dependsOn);
 
 private:
     void checkAccess();
+    void loadDependencies(const int intent, const int action);
+    QList<int> selectedDependencies() const;
+
+    // Saves the edited action and its dependencies in one transaction.
+    // Returns an error message for the user, or an empty string.
+    QString saveEdit();
 
     Ui::ActionDialog *ui;
     QSqlRecord rec_;
     QDataWidgetMapper *mapper_ = {};
+    ActionsModel *model_ = {};
+    int action_ = {};
 
     // QDialog interface
 public slots:
@@ -32,11 +32,7 @@ QVariant ActionProxyModel::data(const QModelIndex &ix, int role) const
             if (ix.column() == h_person) {
                 const auto id = model_->data(ix, Qt::DisplayRole).toInt();
                 if (id > 0) {
-                    QSqlQuery query(QStringLiteral("select name from contact where id = %1")
-                                    .arg(id));
-                    if (query.next()) {
-                        return query.value(0).toString();
-                    }
+                    return Database::instance().contactNames().name(id);
                 }
             }
         } else if (role == Qt::DecorationRole) {
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <set>
+#include <vector>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QRunnable>
@@ -15,6 +17,7 @@
 #include "src/action.h"
 #include "src/strategy.h"
 #include "src/journalmodel.h"
+#include "src/transaction.h"
 
 using namespace std;
 
@@ -64,21 +67,28 @@ void ActionsModel::setContact(int id)
 {
     contact_ = id;
     intent_ = 0;
+    cache_.setContact(id);
 
+    // setFilter() selects by itself once the model has rows
     setFilter("id = -1");
-    select();
+    if (!query().isActive()) {
+        select();
+    }
 }
 
 void ActionsModel::setIntent(int id)
 {
     intent_ = id;
     setFilter(QStringLiteral("contact = %1 and intent = %2").arg(contact_).arg(intent_));
-    select();
+    if (!query().isActive()) {
+        select();
+    }
 }
 
 void ActionsModel::removeActions(const QModelIndexList &indexes)
 {
     Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
 
     set<int> rows;
     for(const auto& ix : indexes) {
@@ -94,25 +104,32 @@ void ActionsModel::removeActions(const QModelIndexList &indexes)
                        << lastError().text();
         }
 
-        JournalModel::instance().addEntry(JournalModel::Type::DELETE_ACTION,
+        if (!JournalModel::instance().addEntry(JournalModel::Type::DELETE_ACTION,
                                     QStringLiteral("Deleted action: %1")
                                     .arg(rec.value("name").toString()),
                                     rec.value("contact").toInt(),
                                     rec.value("person").toInt(),
                                     0,
-                                    rec.value("id").toInt());
+                                    rec.value("id").toInt())) {
+            return; // Rolled back
+        }
     }
 
     if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
+        qWarning() << "Failed to remove actions (submitAll): "
                    << lastError().text();
+        transaction.rollback();
+        select();
+        return;
     }
+
+    transaction.commit();
 }
 
-void ActionsModel::addAction(const QSqlRecord &origRec)
+void ActionsModel::addAction(const QSqlRecord &origRec, const QList<int> &dependsOn)
 {
     QSqlRecord rec = origRec;
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
 
 //    for(int i = 0; i < rec.count(); ++i) {
@@ -126,33 +143,61 @@ void ActionsModel::addAction(const QSqlRecord &origRec)
         rec.setNull(h_person_);
     }
 
-    if (!insertRecord(-1, rec)) {
+    Transaction transaction;
+
+    // New actions get the highest sequence, so appending keeps the order
+    rec.setGenerated(h_id_, false);
+    const auto row = rowCount();
+    if (!insertRecord(row, rec)) {
         qWarning() << "Failed to add new action (insertRecord): "
                    << lastError().text();
         return;
     }
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new action (submitAll): "
-                   << lastError().text();
-        return;
-    }
+    qDebug() << "Created new action";
 
-    qDebug() << "Created new intent";
+    const auto id = data(index(row, h_id_, {}), Qt::DisplayRole).toInt();
 
-    JournalModel::instance().addEntry(JournalModel::Type::ADD_ACTION,
+    if (!setDependencies(id, dependsOn)
+            || !JournalModel::instance().addEntry(JournalModel::Type::ADD_ACTION,
                                 QStringLiteral("Added action: %1").arg(origRec.value("name").toString()),
                                 origRec.value("contact").toInt(),
                                 origRec.value("person").toInt(),
                                 0,
-                                query().lastInsertId().toInt());
+                                id)
+            || !transaction.commit()) {
+        transaction.rollback();
+        select(); // Drop the row we inserted
+    }
 }
 
 void ActionsModel::setCompleted(const QModelIndex& ix)
 {
+    const auto rec = record(ix.row());
+    if (rec.value(h_state_).toInt() == static_cast<int>(ActionState::DONE)) {
+        return;
+    }
+
+    Transaction transaction;
+
     const auto aix = index(ix.row(), h_state_, {});
-    setData(aix, static_cast<int>(ActionState::DONE));
-    openNextActions();
+    if (!setData(aix, static_cast<int>(ActionState::DONE))) {
+        qWarning() << "Failed to complete action (setData): "
+                   << lastError().text();
+        return;
+    }
+    openNextActions(rec.value(h_id_).toInt());
+
+    if (!JournalModel::instance().addEntry(JournalModel::Type::EDIT_ACTION,
+                                QStringLiteral("Completed action: %1").arg(rec.value(h_name_).toString()),
+                                rec.value(h_contact_).toInt(),
+                                rec.value(h_person_).toInt(),
+                                rec.value(h_intent_).toInt(),
+                                rec.value(h_id_).toInt())
+            || !transaction.commit()) {
+        transaction.rollback();
+        select();
+    }
 }
 
 void ActionsModel::moveUp(const QModelIndex &ix)
@@ -165,34 +210,115 @@ void ActionsModel::moveDown(const QModelIndex &ix)
    doMove(ix, 1);
 }
 
-void ActionsModel::openNextActions()
+void ActionsModel::openNextActions(const int action)
 {
-    int prev_state = -1;
+    // Only the direct dependents of action can have become ready, and
+    // they are all opened by one statement.
+    releaseWaiting(QStringLiteral("id in (select action from action_dependency where depends_on = ?) "
+                                  "and exists (select 1 from action where id = ? and state >= %1)")
+                   .arg(static_cast<int>(ActionState::DONE)),
+                   {action, action});
+}
+
+void ActionsModel::releaseAction(const int action)
+{
+    releaseWaiting(QStringLiteral("id = ?"), {action});
+}
+
+void ActionsModel::releaseWaiting(const QString &condition, const QVariantList &args)
+{
+    // DONE, CANCELLED and FAILED all count as finished.
+    auto& query = Database::instance().query(
+                QStringLiteral("update action set state = %1 "
+                               "where state = %2 "
+                               "and %3 "
+                               "and not exists (select 1 from action_dependency as d "
+                                               "join action as p on p.id = d.depends_on "
+                                               "where d.action = action.id and p.state < %4)")
+                .arg(static_cast<int>(ActionState::OPEN))
+                .arg(static_cast<int>(ActionState::WAITING))
+                .arg(condition)
+                .arg(static_cast<int>(ActionState::DONE)),
+                args);
+
+    if (!query.isActive() || query.numRowsAffected() <= 0) {
+        return;
+    }
+
+    qDebug() << "Released " << query.numRowsAffected() << " WAITING action(s)";
+
+    // Re-read the rows that may have changed
     for(int row = 0; row < rowCount(); ++row) {
-        const auto state_ix = index(row, h_state_, {});
-        const auto state = data(state_ix, Qt::DisplayRole).toInt();
-        if (state == static_cast<int>(ActionState::WAITING)) {
-            if (prev_state >= static_cast<int>(ActionState::DONE)) {
-                qDebug() << "Releasing a new WAITING action";
-                setData(state_ix, static_cast<int>(ActionState::OPEN));
-                break;
-            }
+        if (data(index(row, h_state_, {}), Qt::DisplayRole).toInt()
+                == static_cast<int>(ActionState::WAITING)) {
+            selectRow(row);
+        }
+    }
+}
+
+QList<int> ActionsModel::dependencies(const int action)
+{
+    QList<int> ids;
+    auto& query = Database::instance().query(
+                QStringLiteral("select depends_on from action_dependency where action = ?"),
+                {action});
+    while(query.next()) {
+        ids << query.value(0).toInt();
+    }
+    query.finish();
+    return ids;
+}
+
+bool ActionsModel::setDependencies(const int action, const QList<int> &dependsOn)
+{
+    Transaction transaction;
+
+    if (!Database::instance().query(
+                QStringLiteral("delete from action_dependency where action = ?"),
+                {action}).isActive()) {
+        return false;
+    }
+
+    for(const auto other : dependsOn) {
+        // It's a cycle if we can get back to action by following
+        // the dependencies from other
+        const auto cycle = Database::instance().scalar(
+                    QStringLiteral("with recursive up(id) as ("
+                                   "select ? union "
+                                   "select d.depends_on from action_dependency as d join up on d.action = up.id) "
+                                   "select count(*) from up where id = ?"),
+                    {other, action}).toInt();
+        if (cycle) {
+            qWarning() << "Action #" << action << " can not depend on action #" << other
+                       << ", as that would make a cycle";
+            return false; // Rolled back
+        }
+
+        if (!Database::instance().query(
+                    QStringLiteral("insert into action_dependency (action, depends_on) values (?, ?)"),
+                    {action, other}).isActive()) {
+            return false;
         }
-        prev_state = state;
     }
+
+    return transaction.commit();
 }
 
 void ActionsModel::updateState()
 {
-    QSqlQuery query(QStringLiteral("select state from intent where id=%1 ")
-              .arg(intent_));
-    if (query.next() && query.value(0).toInt() >= static_cast<int>(IntentState::PROGRESS)) {
+    // Only a closed intent (succeeded, failed or terminated) cancels its
+    // open actions. PROGRESS is where the work gets done.
+    const auto intent_state = Database::instance().scalar(
+                QStringLiteral("select state from intent where id = ?"), {intent_});
+    if (intent_state.isValid() && intent_state.toInt() > static_cast<int>(IntentState::PROGRESS)) {
+        Transaction transaction;
         for(int i = 0; i < rowCount(); ++i) {
             const auto state = data(index(i, h_state_, {}), Qt::DisplayRole).toInt();
             if (state < static_cast<int>(ActionState::DONE)) {
                 setData(index(i, h_state_), static_cast<int>(ActionState::CANCELLED));
             }
         }
+        transaction.commit();
     }
 }
 
@@ -200,26 +326,104 @@ void ActionsModel::doMove(const QModelIndex &ix, const int offset)
 {
     if (!ix.isValid()
             || ((ix.row() + offset) < 0)
-            || ((ix.row() + offset) >= columnCount())) {
+            || ((ix.row() + offset) >= rowCount())) {
         return;
     }
 
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    // Moving down past the next row means going in before the one after that
+    moveActions({ix}, ix.row() + (offset > 0 ? offset + 1 : offset));
+}
+
+void ActionsModel::moveActions(const QModelIndexList &indexes, int destinationRow)
+{
+    set<int> moved;
+    for(const auto& ix : indexes) {
+        if (ix.isValid()) {
+            moved.insert(ix.row());
+        }
+    }
 
-    const auto other_ix = index(ix.row() + offset, h_sequence_, {});
-    const auto curr_ix = index(ix.row(), h_sequence_, {});
+    if (moved.empty()) {
+        return;
+    }
 
-    const auto other_seq = data(other_ix, Qt::DisplayRole);
-    const auto curr_seq = data(curr_ix, Qt::DisplayRole);
+    destinationRow = max(0, min(destinationRow, rowCount()));
 
-    setData(other_ix, curr_seq);
-    setData(curr_ix, other_seq);
+    // The rows in the order they will have after the move
+    vector<int> rows;
+    int pos = 0;
+    for(int row = 0; row < rowCount(); ++row) {
+        if (!moved.count(row)) {
+            if (row < destinationRow) {
+                ++pos;
+            }
+            rows.push_back(row);
+        }
+    }
+    rows.insert(rows.begin() + pos, moved.begin(), moved.end());
 
-    if (!submitAll()) {
-        qWarning() << "Failed to swap actions: "
-                   << lastError().text();
+    bool changed = false;
+    for(size_t i = 0; i < rows.size(); ++i) {
+        changed |= rows[i] != static_cast<int>(i);
+    }
+
+    if (!changed) {
         return;
     }
+
+    const auto count = static_cast<int>(moved.size());
+    const auto end = pos + count;
+    const auto low = pos > 0 ? sequence(rows[pos - 1]) : 0;
+    const auto high = end < static_cast<int>(rows.size())
+            ? sequence(rows[end])
+            : low + (count + 1) * sequenceGap;
+
+    Transaction transaction;
+
+    if (high - low > count) {
+        // Spread the moved rows out in the gap between their new neighbours
+        const auto step = (high - low) / (count + 1);
+        for(int i = 0; i < count; ++i) {
+            if (!setSequence(rows[pos + i], low + step * (i + 1))) {
+                return; // Rolled back
+            }
+        }
+    } else {
+        qDebug() << "Renumbering the actions in intent #" << intent_;
+        for(size_t i = 0; i < rows.size(); ++i) {
+            const auto seq = static_cast<int>(i + 1) * sequenceGap;
+            if (sequence(rows[i]) != seq && !setSequence(rows[i], seq)) {
+                return; // Rolled back
+            }
+        }
+    }
+
+    if (!transaction.commit()) {
+        return;
+    }
+
+    // The rows must change places in the view, and QSqlTableModel cannot
+    // move cached rows. The model only holds the actions for one intent,
+    // so one select is cheap.
+    Database::instance().detailCache().invalidate(contact_);
+    select();
+}
+
+int ActionsModel::sequence(const int row) const
+{
+    return data(index(row, h_sequence_, {}), Qt::DisplayRole).toInt();
+}
+
+bool ActionsModel::setSequence(const int row, const int sequence)
+{
+    const auto id = data(index(row, h_id_, {}), Qt::DisplayRole).toInt();
+    if (!Database::instance().query(
+                QStringLiteral("update action set sequence = ? where id = ?"),
+                {sequence, id}).isActive()) {
+        qWarning() << "Failed to move action #" << id;
+        return false;
+    }
+    return true;
 }
 
 QVariant ActionsModel::data(const QModelIndex &ix, int role) const
@@ -282,10 +486,14 @@ QSqlRecord ActionsModel::getRecord()
     Q_ASSERT(intent_ > 0);
     Q_ASSERT(contact_ > 0);
 
-    // Sequence must be above any sequence used for this intent so we get at the end
-    QSqlQuery query(QStringLiteral("select max(sequence) from action where intent = %1").arg(intent_));
-    query.next();
-    const auto seq = query.value(0).toInt() + 1;
+    // Sequence must be above any sequence used for this intent so we get at the end.
+    // The model is sorted by sequence, so once all the rows are loaded, that's the last one.
+    const auto seq = (canFetchMore()
+                      ? Database::instance().scalar(
+                            QStringLiteral("select max(sequence) from action where contact = ? and intent = ?"),
+                            {contact_, intent_}).toInt()
+                      : (rowCount() ? sequence(rowCount() - 1) : 0))
+            + sequenceGap;
 
     auto today = QDateTime::currentDateTime();
     auto rec = record();
@@ -317,3 +525,10 @@ QSqlRecord ActionsModel::getRecord()
 
     return rec;
 }
+
+bool ActionsModel::select()
+{
+    return cache_.select(selectStatement(), [this] {
+        return QSqlTableModel::select();
+    });
+}
@@ -18,6 +18,12 @@ class ActionsModel : public QSqlTableModel
 {
     Q_OBJECT
 public:
+    // The distance between the sequence numbers of neighbouring actions
+    // when they are (re)numbered. Moves take the midpoint between the new
+    // neighbours, so only when a gap is used up are the actions in the
+    // intent renumbered.
+    static constexpr int sequenceGap = 1024;
+
     ActionsModel(QSettings& settings, QObject *parent, QSqlDatabase db);
 
     DEF_COLUMN(id)
@@ -38,23 +44,49 @@ public:
     void setContact(int id);
     void setIntent(int id);
     int contact() const { return contact_; }
+    int intent() const { return intent_; }
 
     // Get a record with default values
     QSqlRecord getRecord();
 
+    // The actions that action depends on
+    static QList<int> dependencies(const int action);
+
+    // Replace the dependencies for action. Fails, and changes nothing,
+    // if that would make a cycle.
+    static bool setDependencies(const int action, const QList<int>& dependsOn);
+
 public slots:
     void removeActions(const QModelIndexList& indexes);
-    void addAction(const QSqlRecord& rec);
+    void addAction(const QSqlRecord& rec, const QList<int>& dependsOn);
     void setCompleted(const QModelIndex& ix);
     void moveUp(const QModelIndex& ix);
     void moveDown(const QModelIndex& ix);
-    void openNextActions();
+
+    // Move the rows in indexes, in their current order, so they come
+    // just before destinationRow (or last, if it's rowCount()).
+    // All the changes are done in one transaction, followed by one select.
+    void moveActions(const QModelIndexList& indexes, int destinationRow);
+
+    // Open the WAITING actions that depend on action, if action is finished
+    // and they don't wait for anything else.
+    void openNextActions(const int action);
+
+    // Open action if it is WAITING and doesn't wait for anything any more,
+    // like after its dependencies are changed.
+    void releaseAction(const int action);
     void updateState();
 
 private:
+    // Open the WAITING actions that match condition (on action) and have
+    // no unfinished dependencies, and re-read them.
+    void releaseWaiting(const QString& condition, const QVariantList& args);
     void doMove(const QModelIndex &ix, const int offset);
+    int sequence(const int row) const;
+    bool setSequence(const int row, const int sequence);
 
     QSettings& settings_;
+    DetailCacheClient cache_{*this};
 
     int h_id_ = {};
     int h_sequence_ = {};
@@ -79,6 +111,8 @@ public:
     int intent_ = {};
 
     // QSqlTableModel interface
+public slots:
+    bool select() override;
 protected:
     bool updateRowInTable(int row, const QSqlRecord &values) override;
 };
@@ -0,0 +1,151 @@
+#include "src/blobstore.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QUuid>
+#include <QVariant>
+
+BlobStore::BlobStore(QSqlDatabase db, const bool compress)
+    : db_{std::move(db)}, compress_{compress}
+{
+}
+
+QString BlobStore::write(QIODevice &in)
+{
+    // We don't know the hash until we have seen all the data, so the
+    // chunks are written under a temporary key that we rename at the end.
+    const auto tmp_key = QStringLiteral("tmp-%1").arg(QUuid::createUuid().toString());
+
+    QSqlQuery query(db_);
+    query.prepare("INSERT INTO blob (hash, size, refcount) VALUES (?, 0, 0)");
+    query.addBindValue(tmp_key);
+    if (!query.exec()) {
+        qWarning() << "Failed to add blob: " << query.lastError().text();
+        return {};
+    }
+
+    QSqlQuery chunk(db_);
+    chunk.prepare("INSERT INTO blob_chunk (hash, seq, compressed, data) VALUES (?, ?, ?, ?)");
+
+    QCryptographicHash hasher(QCryptographicHash::Sha256);
+    qint64 total = 0;
+    for(int seq = 0;; ++seq) {
+        auto data = in.read(chunkSize);
+        if (data.isEmpty()) {
+            break;
+        }
+
+        hasher.addData(data);
+        total += data.size();
+
+        bool compressed = false;
+        if (compress_) {
+            auto packed = qCompress(data);
+            if (packed.size() < data.size()) {
+                data = std::move(packed);
+                compressed = true;
+            }
+        }
+
+        chunk.bindValue(0, tmp_key);
+        chunk.bindValue(1, seq);
+        chunk.bindValue(2, compressed);
+        chunk.bindValue(3, data);
+        if (!chunk.exec()) {
+            qWarning() << "Failed to add blob chunk: " << chunk.lastError().text();
+            query.prepare("DELETE FROM blob WHERE hash = ?");
+            query.addBindValue(tmp_key);
+            query.exec();
+            return {};
+        }
+    }
+
+    const QString hash = hasher.result().toHex();
+
+    if (size(hash) >= 0) {
+        // We have it already. Drop the copy (the chunks cascade).
+        query.prepare("DELETE FROM blob WHERE hash = ?");
+        query.addBindValue(tmp_key);
+    } else {
+        // The chunks follow the new key (ON UPDATE CASCADE)
+        query.prepare("UPDATE blob SET hash = ?, size = ? WHERE hash = ?");
+        query.addBindValue(hash);
+        query.addBindValue(total);
+        query.addBindValue(tmp_key);
+    }
+
+    if (!query.exec()) {
+        qWarning() << "Failed to store blob " << hash << ": " << query.lastError().text();
+        return {};
+    }
+
+    return hash;
+}
+
+QString BlobStore::write(const QByteArray &data)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    return write(buffer);
+}
+
+bool BlobStore::read(const QString &hash, QIODevice &out)
+{
+    QSqlQuery query(db_);
+    query.setForwardOnly(true);
+    query.prepare("SELECT compressed, data FROM blob_chunk WHERE hash = ? ORDER BY seq");
+    query.addBindValue(hash);
+    if (!query.exec()) {
+        qWarning() << "Failed to read blob " << hash << ": " << query.lastError().text();
+        return false;
+    }
+
+    while(query.next()) {
+        auto data = query.value(1).toByteArray();
+        if (query.value(0).toBool()) {
+            data = qUncompress(data);
+        }
+
+        if (out.write(data) != data.size()) {
+            qWarning() << "Failed to write blob " << hash << ": " << out.errorString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QByteArray BlobStore::read(const QString &hash)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    if (!read(hash, buffer)) {
+        return {};
+    }
+    return buffer.data();
+}
+
+qint64 BlobStore::size(const QString &hash)
+{
+    QSqlQuery query(db_);
+    query.prepare("SELECT size FROM blob WHERE hash = ?");
+    query.addBindValue(hash);
+    if (query.exec() && query.next()) {
+        return query.value(0).toLongLong();
+    }
+    return -1;
+}
+
+int BlobStore::collectGarbage()
+{
+    QSqlQuery query(db_);
+    if (!query.exec("DELETE FROM blob WHERE refcount <= 0")) {
+        qWarning() << "Failed to remove unused blobs: " << query.lastError().text();
+        return 0;
+    }
+    return query.numRowsAffected();
+}
@@ -0,0 +1,48 @@
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QSqlDatabase>
+#include <QString>
+
+// Content-addressed storage for document content.
+//
+// Each distinct content is stored once, in the blob table, keyed by the
+// hex encoded sha256 of the data. The data itself is split in chunks
+// (blob_chunk) that are optionally compressed with qCompress(). Documents
+// reference blobs with document.content_hash, and triggers keep
+// blob.refcount in sync and delete blobs nobody references any more.
+//
+// Reads and writes go through one chunk at a time, so memory use does
+// not depend on the size of the content.
+class BlobStore
+{
+public:
+    static constexpr int chunkSize = 256 * 1024;
+
+    explicit BlobStore(QSqlDatabase db, const bool compress = true);
+
+    // Store all the data from in (a blocking device, like a file).
+    // Returns the hash, or an empty string on failure.
+    // Do this in the same transaction as the update that references
+    // the blob, or it will be left with a refcount of 0.
+    QString write(QIODevice& in);
+    QString write(const QByteArray& data);
+
+    // Write the content for hash to out
+    bool read(const QString& hash, QIODevice& out);
+    QByteArray read(const QString& hash);
+
+    // Uncompressed size, or -1 if we don't have it
+    qint64 size(const QString& hash);
+
+    // Remove blobs that are not referenced. Returns the number removed.
+    int collectGarbage();
+
+private:
+    QSqlDatabase db_;
+    const bool compress_;
+};
+
+#endif // BLOBSTORE_H
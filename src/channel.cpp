@@ -86,3 +86,149 @@ const std::array<ChannelType, 10> &GetChannelTypeEnums()
 
     return enums;
 }
+
+namespace {
+
+QString stripPrefix(const QString& value, const QString& prefix)
+{
+    if (value.startsWith(prefix, Qt::CaseInsensitive)) {
+        return value.mid(prefix.size());
+    }
+    return value;
+}
+
+QString normalizePhone(const QString& value)
+{
+    const auto trimmed = stripPrefix(value.trimmed(), QStringLiteral("tel:"));
+
+    QString digits;
+    digits.reserve(trimmed.size() + 1);
+    for(const auto ch : trimmed) {
+        if (ch.isDigit()) {
+            digits += ch;
+        }
+    }
+
+    if (trimmed.startsWith('+')) {
+        digits.prepend('+');
+    } else if (digits.startsWith(QStringLiteral("00"))) {
+        digits.replace(0, 2, '+');
+    }
+
+    return digits == QStringLiteral("+") ? QString{} : digits;
+}
+
+// "@Name", "https://github.com/name/" or "u/name" -> "name"
+QString normalizeHandle(const QString& value)
+{
+    auto handle = value.trimmed().toLower();
+    if (handle.contains('/')) {
+        // QString::SkipEmptyParts is deprecated from Qt 5.14
+        auto parts = handle.split('/');
+        parts.removeAll({});
+        handle = parts.isEmpty() ? QString{} : parts.last();
+        const auto query = handle.indexOf('?');
+        if (query >= 0) {
+            handle.truncate(query);
+        }
+    }
+
+    if (handle.startsWith('@')) {
+        handle.remove(0, 1);
+    }
+
+    return handle;
+}
+
+QString normalizeWeb(const QString& value)
+{
+    auto url = value.trimmed().toLower();
+    url = stripPrefix(url, QStringLiteral("https://"));
+    url = stripPrefix(url, QStringLiteral("http://"));
+    url = stripPrefix(url, QStringLiteral("www."));
+    while(url.endsWith('/')) {
+        url.chop(1);
+    }
+    return url;
+}
+
+} // anonymous namespace
+
+QString NormalizeChannelValue(const ChannelType type, const QString &value)
+{
+    switch(type) {
+    case ChannelType::EMAIL:
+        return stripPrefix(value.trimmed(), QStringLiteral("mailto:")).toLower();
+    case ChannelType::PHONE:
+    case ChannelType::MOBILE:
+        return normalizePhone(value);
+    case ChannelType::SKYPE:
+        return stripPrefix(value.trimmed(), QStringLiteral("skype:")).toLower();
+    case ChannelType::LINKEDIN:
+    case ChannelType::REDDIT:
+    case ChannelType::FACEBOOK:
+    case ChannelType::GITHUB:
+        return normalizeHandle(value);
+    case ChannelType::WEB:
+        return normalizeWeb(value);
+    case ChannelType::OTHER:
+        break;
+    }
+
+    return value.trimmed().toLower();
+}
+
+QString NormalizeChannelValue(const int type, const QString &value)
+{
+    if (type < 0 || static_cast<size_t>(type) >= GetChannelTypeEnums().size()) {
+        return NormalizeChannelValue(ChannelType::OTHER, value);
+    }
+    return NormalizeChannelValue(ToChannelType(type), value);
+}
+
+ChannelType GetMatchingChannelType(const ChannelType type)
+{
+    switch(type) {
+    case ChannelType::PHONE:
+        return ChannelType::MOBILE;
+    case ChannelType::MOBILE:
+        return ChannelType::PHONE;
+    default:
+        return type;
+    }
+}
+
+ChannelType GuessChannelType(const QString &value)
+{
+    const auto trimmed = value.trimmed();
+    if (trimmed.contains('@') && !trimmed.startsWith('@')) {
+        return ChannelType::EMAIL;
+    }
+
+    int digits = 0;
+    for(const auto ch : stripPrefix(trimmed, QStringLiteral("tel:"))) {
+        if (ch.isDigit()) {
+            ++digits;
+        } else if (!QStringLiteral("+-(). /").contains(ch)) {
+            return ChannelType::OTHER;
+        }
+    }
+
+    return digits ? ChannelType::PHONE : ChannelType::OTHER;
+}
+
+bool IsPersonalChannel(const ChannelType type)
+{
+    switch(type) {
+    case ChannelType::EMAIL:
+    case ChannelType::MOBILE:
+    case ChannelType::SKYPE:
+    case ChannelType::LINKEDIN:
+    case ChannelType::REDDIT:
+    case ChannelType::FACEBOOK:
+    case ChannelType::GITHUB:
+        return true;
+    default:
+        return false;
+    }
+}
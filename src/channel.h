@@ -25,4 +25,26 @@ QString GetChannelTypeName(const int type);
 const std::array<ChannelType, 10>& GetChannelTypeEnums();
 ChannelType ToChannelType(const int type);
 
+// The lookup key for a channel value, kept in channel.norm.
+// Emails, handles and web addresses are lowercased, handles and profile
+// URL's are reduced to the user name, and phone numbers to their digits,
+// with "+" for an international prefix ("+47 22 33" and "004722 33" both
+// give "+472233"). Returns an empty string if nothing is left.
+QString NormalizeChannelValue(const ChannelType type, const QString& value);
+QString NormalizeChannelValue(const int type, const QString& value);
+
+// The type whose normalized values are compared with those of type, in
+// lookups on channel (type, norm). That is the type itself, except that
+// phone and mobile numbers match each other. Use it as
+// "type IN (type, GetMatchingChannelType(type))".
+ChannelType GetMatchingChannelType(const ChannelType type);
+
+// Guess the type of a value without one, for lookups
+ChannelType GuessChannelType(const QString& value);
+
+// True for the types where a value belongs to one person, so that two
+// contacts with the same value are probably duplicates. Phone numbers
+// can be a shared switchboard; mobile numbers are personal.
+bool IsPersonalChannel(const ChannelType type);
+
 #endif // CHANNEL_H
@@ -8,9 +8,9 @@
 #include <QSqlField>
 
 #include "src/strategy.h"
+#include "src/transaction.h"
 
 #include "src/channel.h"
-#include "src/channeldialog.h"
 #include "src/channelsmodel.h"
 
 using namespace std;
@@ -28,12 +28,14 @@ ChannelsModel::ChannelsModel(QSettings &settings, QObject *parent, QSqlDatabase
     h_value_ = fieldIndex("value");
     h_verified_ = fieldIndex("verified");
     h_name_ = fieldIndex("name");
+    h_norm_ = fieldIndex("norm");
 
     Q_ASSERT(h_contact_ > 0
             && h_type_ > 0
             && h_value_ > 0
             && h_verified_ > 0
             && h_name_> 0
+            && h_norm_ > 0
     );
 
     setSort(h_value_, Qt::AscendingOrder);
@@ -42,13 +44,19 @@ ChannelsModel::ChannelsModel(QSettings &settings, QObject *parent, QSqlDatabase
 
 void ChannelsModel::setContact(int id)
 {
+    cache_.setContact(id);
+
+    // setFilter() selects by itself once the model has rows
     setFilter(QStringLiteral("contact = %1").arg(id));
-    select();
+    if (!query().isActive()) {
+        select();
+    }
 }
 
 void ChannelsModel::removeChannels(const QModelIndexList &indexes)
 {
     Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
 
     set<int> rows;
     for(const auto& ix : indexes) {
@@ -63,48 +71,109 @@ void ChannelsModel::removeChannels(const QModelIndexList &indexes)
     }
 
     if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
+        qWarning() << "Failed to remove channels (submitAll): "
                    << lastError().text();
+        transaction.rollback();
+        select();
+        return;
     }
+
+    transaction.commit();
 }
 
 void ChannelsModel::verifyChannels(const QModelIndexList &indexes, bool verified)
 {
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
     set<int> rows;
     for(const auto& ix : indexes) {
         rows.insert(ix.row());
     }
 
+    // Each setData() updates one row and re-reads only that row.
+    // They are committed together.
+    Transaction transaction;
     for(const int row : rows) {
         const auto ix = index(row, h_verified_, {});
-        setData(ix, verified);
-    }
-
-    if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
-                   << lastError().text();
+        if (!setData(ix, verified)) {
+            qWarning() << "Failed to verify channel (setData): "
+                       << lastError().text();
+        }
     }
+    transaction.commit();
 }
 
-void ChannelsModel::addChannel(const QSqlRecord &rec)
+void ChannelsModel::addChannel(const QSqlRecord &origRec)
 {
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
+    // The row is appended and stays at the end until the next select()
+    QSqlRecord rec{origRec};
+    rec.setGenerated(h_id_, false);
     if (!insertRecord(-1, rec)) {
         qWarning() << "Failed to add new channel (insertRecord): "
                    << lastError().text();
         return;
     }
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new channel (submitAll): "
-                   << lastError().text();
-        return;
+    qDebug() << "Created new channel";
+
+    const auto type = ToChannelType(rec.value(h_type_).toInt());
+    if (IsPersonalChannel(type)) {
+        const auto contact = rec.value(h_contact_).toInt();
+        for(const auto owner : findOwners(type, rec.value(h_value_).toString())) {
+            if (owner != contact) {
+                qWarning() << GetChannelTypeName(type) << " " << rec.value(h_value_).toString()
+                           << " is also used by "
+                           << Database::instance().contactNames().name(owner);
+            }
+        }
+    }
+}
+
+QList<int> ChannelsModel::findOwners(const ChannelType type, const QString &value)
+{
+    QList<int> owners;
+    const auto norm = NormalizeChannelValue(type, value);
+    if (norm.isEmpty()) {
+        return owners;
     }
 
-    qDebug() << "Created new channel";
+    auto& query = Database::instance().query(
+                QStringLiteral("SELECT DISTINCT contact FROM channel "
+                               "WHERE type IN (?, ?) AND norm = ? LIMIT 50"),
+                {static_cast<int>(type), static_cast<int>(GetMatchingChannelType(type)), norm});
+    while(query.next()) {
+        owners << query.value(0).toInt();
+    }
+    return owners;
+}
+
+bool ChannelsModel::insertRowIntoTable(const QSqlRecord &values)
+{
+    QSqlRecord rec{values};
+    setNorm(rec);
+    return QSqlTableModel::insertRowIntoTable(rec);
+}
+
+bool ChannelsModel::updateRowInTable(int row, const QSqlRecord &values)
+{
+    // Only the changed fields are generated, but all have their values
+    if (!values.isGenerated(h_type_) && !values.isGenerated(h_value_)) {
+        return QSqlTableModel::updateRowInTable(row, values);
+    }
+
+    QSqlRecord rec{values};
+    setNorm(rec);
+    return QSqlTableModel::updateRowInTable(row, rec);
+}
+
+void ChannelsModel::setNorm(QSqlRecord &rec) const
+{
+    const auto norm = NormalizeChannelValue(rec.value(h_type_).toInt(),
+                                            rec.value(h_value_).toString());
+    rec.setValue(h_norm_, norm.isEmpty() ? QVariant{QVariant::String} : QVariant{norm});
+    rec.setGenerated(h_norm_, true);
 }
 
 
@@ -127,3 +196,10 @@ QVariant ChannelsModel::headerData(int section, Qt::Orientation orientation, int
 
     return QSqlTableModel::headerData(section, orientation, role);
 }
+
+bool ChannelsModel::select()
+{
+    return cache_.select(selectStatement(), [this] {
+        return QSqlTableModel::select();
+    });
+}
@@ -7,6 +7,7 @@
 #include <QMetaType>
 #include <QSqlDatabase>
 
+#include "channel.h"
 #include "database.h"
 
 // Create read-only properties like 'name_col' for the database columns
@@ -25,9 +26,14 @@ public:
     DEF_COLUMN(value)
     DEF_COLUMN(verified)
     DEF_COLUMN(name)
+    DEF_COLUMN(norm)
 
     void setContact(int id);
 
+    // The contacts or persons with a channel of the same type that has
+    // the same normalized value (an index lookup on channel (type, norm)).
+    static QList<int> findOwners(const ChannelType type, const QString& value);
+
 public slots:
     void removeChannels(const QModelIndexList& indexes);
     void verifyChannels(const QModelIndexList& indexes, bool verified = true);
@@ -35,6 +41,7 @@ public slots:
 
 private:
     QSettings& settings_;
+    DetailCacheClient cache_{*this};
 
     int h_id_ = {};
     int h_contact_ = {};
@@ -42,11 +49,24 @@ private:
     int h_value_ = {};
     int h_verified_ = {};
     int h_name_ = {};
+    int h_norm_ = {};
 
     // QAbstractItemModel interface
 public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    // QSqlTableModel interface
+public slots:
+    bool select() override;
+
+    // Keep channel.norm in sync with the type and value
+protected:
+    bool insertRowIntoTable(const QSqlRecord &values) override;
+    bool updateRowInTable(int row, const QSqlRecord &values) override;
+
+private:
+    void setNorm(QSqlRecord& rec) const;
 };
 
 
@@ -0,0 +1,514 @@
+// f-crm-cli: f-crm without the GUI, for scripts, cron jobs and mail filters.
+//
+// It uses the same database, data layer and journal as the GUI, but runs on
+// QCoreApplication, and only creates the models the command needs.
+
+#include <atomic>
+#include <iostream>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDate>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QTextStream>
+
+#include "src/database.h"
+#include "src/transaction.h"
+#include "src/contactsmodel.h"
+#include "src/actionsmodel.h"
+#include "src/journalmodel.h"
+#include "src/importer.h"
+#include "src/mailingester.h"
+#include "src/exporter.h"
+#include "src/channel.h"
+#include "src/utility.h"
+#include "src/version.h"
+
+using namespace std;
+
+namespace {
+
+// Exit codes
+constexpr int ok = 0;
+constexpr int failed = 1;
+constexpr int usage = 2;
+
+bool verbose = false;
+
+// Diagnostics go to stderr, so stdout is only the result
+void messageHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+{
+    if ((type == QtDebugMsg || type == QtInfoMsg) && !verbose) {
+        return;
+    }
+
+    cerr << msg.toLocal8Bit().constData() << endl;
+
+    if (type == QtFatalMsg) {
+        abort();
+    }
+}
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+int error(const QString& message, const int code = failed)
+{
+    cerr << message.toLocal8Bit().constData() << endl;
+    return code;
+}
+
+// Run a SELECT statement and write the rows as tab separated values, or JSON Lines
+int cmdQuery(const QCommandLineParser& parser, const QStringList& args)
+{
+    if (args.size() != 1) {
+        return error("Usage: query SQL", usage);
+    }
+
+    auto db = Database::instance().getDb();
+
+    // Changes must go through the other commands, so they are journaled
+    QSqlQuery pragma(db);
+    pragma.exec("PRAGMA query_only = ON");
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(args.at(0))) {
+        return error(query.lastError().text());
+    }
+
+    const auto rec = query.record();
+    const bool json = parser.isSet("json");
+
+    if (!json) {
+        QStringList names;
+        for(int i = 0; i < rec.count(); ++i) {
+            names << rec.fieldName(i);
+        }
+        out() << names.join('\t') << '\n';
+    }
+
+    while(query.next()) {
+        if (json) {
+            QJsonObject obj;
+            for(int i = 0; i < rec.count(); ++i) {
+                obj.insert(rec.fieldName(i), QJsonValue::fromVariant(query.value(i)));
+            }
+            out() << QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)) << '\n';
+        } else {
+            for(int i = 0; i < rec.count(); ++i) {
+                if (i) {
+                    out() << '\t';
+                }
+                auto value = query.value(i).toString();
+                value.replace('\t', ' ');
+                value.replace('\n', ' ');
+                out() << value;
+            }
+            out() << '\n';
+        }
+    }
+
+    return ok;
+}
+
+int cmdAddContact(const QCommandLineParser& parser, const QStringList& args, QSettings& settings)
+{
+    if (args.size() != 1) {
+        return error("Usage: add-contact NAME [--person] [--parent ID] [--notes TEXT] [--email ADDRESS] [--phone NUMBER]", usage);
+    }
+
+    JournalModel journal(settings, nullptr, {});
+    ContactsModel contacts(settings, nullptr, {});
+
+    const auto parent = parser.value("parent").toInt();
+    if (parent) {
+        contacts.setParent(parent);
+    }
+
+    auto rec = contacts.record();
+    rec.setValue("name", args.at(0));
+    rec.setValue("type", static_cast<int>((parent || parser.isSet("person"))
+                                          ? ContactType::INDIVID : ContactType::CORPORATION));
+    if (parent) {
+        rec.setValue("contact", parent);
+    }
+    if (parser.isSet("notes")) {
+        rec.setValue("notes", parser.value("notes"));
+    }
+
+    Transaction transaction;
+
+    if (!contacts.insertContact(rec)) {
+        return error("Failed to add the contact");
+    }
+
+    const auto id = contacts.data(contacts.index(0, contacts.fieldIndex("id"), {}),
+                                  Qt::DisplayRole).toInt();
+
+    const auto addChannels = [id](const QStringList& values, const ChannelType type) {
+        for(const auto& value : values) {
+            const auto norm = NormalizeChannelValue(type, value);
+            if (!Database::instance().query(
+                        QStringLiteral("insert into channel (contact, type, value, norm) values (?, ?, ?, ?)"),
+                        {id, static_cast<int>(type), value,
+                         norm.isEmpty() ? QVariant{QVariant::String} : QVariant{norm}}).isActive()) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (!addChannels(parser.values("email"), ChannelType::EMAIL)
+            || !addChannels(parser.values("phone"), ChannelType::PHONE)
+            || !transaction.commit()) {
+        return error("Failed to add the contact");
+    }
+
+    out() << id << '\n';
+    return ok;
+}
+
+// update-contact ID field=value ...
+int cmdUpdateContact(const QStringList& args, QSettings& settings)
+{
+    if (args.size() < 2) {
+        return error("Usage: update-contact ID FIELD=VALUE...", usage);
+    }
+
+    const auto id = args.at(0).toInt();
+    auto& db = Database::instance();
+
+    static const QStringList readonly{"id", "contact", "created_date"};
+    const auto rec = db.getDb().record("contact");
+
+    QStringList assignments, fields;
+    QVariantList values;
+    for(int i = 1; i < args.size(); ++i) {
+        const auto eq = args.at(i).indexOf('=');
+        const auto field = args.at(i).left(eq);
+        if (eq <= 0 || rec.indexOf(field) < 0 || readonly.contains(field)) {
+            return error(QStringLiteral("Can not set %1").arg(args.at(i)), usage);
+        }
+        assignments << QStringLiteral("%1 = ?").arg(field);
+        fields << field;
+        values << args.at(i).mid(eq + 1);
+    }
+    values << id;
+
+    JournalModel journal(settings, nullptr, {});
+    Transaction transaction;
+
+    const auto parent = db.scalar(QStringLiteral("select contact from contact where id = ?"), {id});
+    auto& query = db.query(QStringLiteral("update contact set %1 where id = ?").arg(assignments.join(", ")),
+                           values);
+    if (!query.isActive() || query.numRowsAffected() != 1) {
+        return error(QStringLiteral("No contact #%1").arg(id));
+    }
+
+    const bool person = !parent.isNull();
+    if (!journal.addEntry(person ? JournalModel::Type::UPDATED_PERSON : JournalModel::Type::UPDATED_CONTACT,
+                          QStringLiteral("Updated %1").arg(fields.join(", ")),
+                          person ? parent.toInt() : id,
+                          person ? id : 0)
+            || !transaction.commit()) {
+        return error("Failed to update the contact");
+    }
+
+    db.contactNames().invalidate(id);
+    return ok;
+}
+
+// add-action CONTACT INTENT NAME
+int cmdAddAction(const QCommandLineParser& parser, const QStringList& args, QSettings& settings)
+{
+    if (args.size() != 3) {
+        return error("Usage: add-action CONTACT INTENT NAME [--due yyyy-MM-dd] [--after ACTION]...", usage);
+    }
+
+    const auto contact = args.at(0).toInt();
+    const auto intent = args.at(1).toInt();
+
+    if (!Database::instance().scalar(
+                QStringLiteral("select count(*) from intent where id = ? and contact = ?"),
+                {intent, contact}).toInt()) {
+        return error(QStringLiteral("Contact #%1 has no intent #%2").arg(contact).arg(intent));
+    }
+
+    JournalModel journal(settings, nullptr, {});
+    ActionsModel actions(settings, nullptr, {});
+    actions.setContact(contact);
+    actions.setIntent(intent);
+    while(actions.canFetchMore()) {
+        actions.fetchMore();
+    }
+
+    auto rec = actions.getRecord();
+    rec.setValue("name", args.at(2));
+
+    if (parser.isSet("due")) {
+        const auto due = QDate::fromString(parser.value("due"), Qt::ISODate);
+        if (!due.isValid()) {
+            return error(QStringLiteral("Invalid date: %1").arg(parser.value("due")), usage);
+        }
+        rec.setValue("due_date", static_cast<uint>(ToTime(due)));
+    }
+
+    // Like in the action dialog, a new action waits for the last one by default
+    QList<int> depends_on;
+    const auto id_col = actions.fieldIndex("id");
+    const auto rows = actions.rowCount();
+    if (parser.isSet("after")) {
+        for(const auto& id : parser.values("after")) {
+            depends_on << id.toInt();
+        }
+    } else if (rows) {
+        depends_on << actions.data(actions.index(rows - 1, id_col, {}), Qt::DisplayRole).toInt();
+    }
+
+    actions.addAction(rec, depends_on);
+    if (actions.rowCount() <= rows) {
+        return error("Failed to add the action");
+    }
+
+    out() << actions.data(actions.index(rows, id_col, {}), Qt::DisplayRole).toInt() << '\n';
+    return ok;
+}
+
+// done ACTION...
+int cmdDone(const QStringList& args, QSettings& settings)
+{
+    if (args.isEmpty()) {
+        return error("Usage: done ACTION...", usage);
+    }
+
+    JournalModel journal(settings, nullptr, {});
+    ActionsModel actions(settings, nullptr, {});
+    const auto id_col = actions.fieldIndex("id");
+    int rval = ok;
+
+    for(const auto& arg : args) {
+        const auto id = arg.toInt();
+        auto& query = Database::instance().query(
+                    QStringLiteral("select contact, intent from action where id = ?"), {id});
+        if (!query.next()) {
+            rval = error(QStringLiteral("No action #%1").arg(arg));
+            continue;
+        }
+        const auto contact = query.value(0).toInt();
+        const auto intent = query.value(1).toInt();
+        query.finish();
+
+        if (actions.contact() != contact || actions.intent() != intent) {
+            actions.setContact(contact);
+            actions.setIntent(intent);
+            while(actions.canFetchMore()) {
+                actions.fetchMore();
+            }
+        }
+
+        bool found = false;
+        for(int row = 0; row < actions.rowCount(); ++row) {
+            if (actions.data(actions.index(row, id_col, {}), Qt::DisplayRole).toInt() == id) {
+                actions.setCompleted(actions.index(row, id_col, {}));
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            // Like an action without an intent, which the model does not list
+            rval = error(QStringLiteral("Action #%1 can not be completed here").arg(arg));
+        }
+    }
+
+    return rval;
+}
+
+int cmdImport(const QStringList& args)
+{
+    if (args.size() != 1) {
+        return error("Usage: import FILE", usage);
+    }
+
+    const std::atomic_bool cancelled{false};
+    ImportWorker worker(Database::instance().path(), cancelled);
+    ImportSummary summary;
+    QObject::connect(&worker, &ImportWorker::finished, [&summary](const ImportSummary& result) {
+        summary = result;
+    });
+    QObject::connect(&worker, &ImportWorker::progress, [](qint64, qint64, int records) {
+        qInfo() << "Imported " << records << " records";
+    });
+
+    worker.run(args.at(0));
+
+    out() << QStringLiteral("Added %1 companies, %2 persons and %3 channels. "
+                            "Skipped %4 records, and %5 duplicates.")
+             .arg(summary.companies).arg(summary.persons).arg(summary.channels)
+             .arg(summary.skipped).arg(summary.duplicates)
+          << '\n';
+
+    if (!summary.error.isEmpty()) {
+        return error(summary.error);
+    }
+    return ok;
+}
+
+int cmdImportMail(const QStringList& args)
+{
+    if (args.isEmpty()) {
+        return error("Usage: import-mail PATH...", usage);
+    }
+
+    const std::atomic_bool cancelled{false};
+    MailIngestWorker worker(Database::instance().path(), cancelled);
+    MailIngestSummary summary;
+    QObject::connect(&worker, &MailIngestWorker::finished, [&summary](const MailIngestSummary& result) {
+        summary = result;
+    });
+    QObject::connect(&worker, &MailIngestWorker::progress, [](int files, int messages) {
+        qInfo() << "Read " << messages << " messages in " << files << " files";
+    });
+
+    worker.run(args);
+
+    out() << summary.text() << '\n';
+
+    if (!summary.error.isEmpty()) {
+        return error(summary.error);
+    }
+    return ok;
+}
+
+int cmdExport(const QCommandLineParser& parser, const QStringList& args)
+{
+    if (args.size() != 1) {
+        return error("Usage: export DIRECTORY [--format csv|jsonl|vcard] [--full] [--content]", usage);
+    }
+
+    Exporter::Options options;
+    options.directory = args.at(0);
+    options.incremental = !parser.isSet("full");
+    options.content = parser.isSet("content");
+    if (parser.isSet("format") && !Exporter::toFormat(parser.value("format"), options.format)) {
+        return error(QStringLiteral("Unknown format: %1").arg(parser.value("format")), usage);
+    }
+
+    Exporter exporter(Database::instance().getDb(), options);
+    if (!exporter.run()) {
+        return error(exporter.error());
+    }
+
+    for(const auto& file : exporter.files()) {
+        out() << file << '\n';
+    }
+    return ok;
+}
+
+int cmdMaintenance(const QCommandLineParser& parser)
+{
+    return Database::instance().optimize(parser.isSet("vacuum")) ? ok : failed;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Same settings as the GUI
+    app.setOrganizationName("TheLastViking");
+    app.setOrganizationDomain("lastviking.eu");
+#ifdef QT_DEBUG
+    app.setApplicationName("f-crm-debug");
+#else
+    app.setApplicationName("f-crm");
+#endif
+    app.setApplicationVersion(F_CRM_VERSION);
+
+    qInstallMessageHandler(messageHandler);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+                "Command line interface to the f-crm database.\n\n"
+                "Commands:\n"
+                "  query SQL                      Run a read-only query\n"
+                "  add-contact NAME               Add a company, or a person with --person or --parent\n"
+                "  update-contact ID FIELD=VALUE  Update fields for a contact\n"
+                "  add-action CONTACT INTENT NAME Add an action to an intent\n"
+                "  done ACTION...                 Mark actions as done\n"
+                "  import FILE                    Import contacts from a CSV or vCard file\n"
+                "  import-mail PATH...            Link mbox files, Maildir folders and .eml files to the contacts\n"
+                "  export DIRECTORY               Export what changed since the last export there\n"
+                "  maintenance                    Clean up and optimize the database");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"db", "Use the database at <path> instead of the one in the settings.", "path"},
+        {"verbose", "Log debug messages to stderr."},
+        {"json", "query: Write JSON Lines instead of tab separated values."},
+        {"person", "add-contact: Add an individual, not a company."},
+        {"parent", "add-contact: Add a person to company <id>.", "id"},
+        {"notes", "add-contact: Notes.", "text"},
+        {"email", "add-contact: Email address. Can be repeated.", "address"},
+        {"phone", "add-contact: Phone number. Can be repeated.", "number"},
+        {"due", "add-action: Due date.", "yyyy-MM-dd"},
+        {"after", "add-action: Depends on action <id>. Can be repeated.", "id"},
+        {"format", "export: csv, jsonl or vcard.", "format"},
+        {"full", "export: Export everything, not only what changed."},
+        {"content", "export: Also write the document content."},
+        {"vacuum", "maintenance: Also VACUUM the database."},
+    });
+    parser.addPositionalArgument("command", "The command to run.");
+    parser.process(app);
+
+    verbose = parser.isSet("verbose");
+
+    auto args = parser.positionalArguments();
+    if (args.isEmpty()) {
+        parser.showHelp(usage);
+    }
+    const auto command = args.takeFirst();
+
+    QSettings settings;
+    const auto dbpath = parser.value("db");
+    if (dbpath.isEmpty() && settings.value("dbpath").toString().isEmpty()) {
+        return error("No database is configured. Run f-crm once, or use --db.");
+    }
+
+    // Opening a path that is not there would create an empty database
+    const auto effective_path = dbpath.isEmpty() ? settings.value("dbpath").toString() : dbpath;
+    if (effective_path != ":memory:" && !QFileInfo(effective_path).isFile()) {
+        return error(QStringLiteral("No database at %1").arg(effective_path));
+    }
+
+    std::unique_ptr<Database> db;
+    try {
+        db = std::make_unique<Database>(nullptr, dbpath);
+    } catch(const std::exception& ex) {
+        return error(QStringLiteral("Failed to open the database: %1").arg(ex.what()));
+    }
+
+    if (command == "query") return cmdQuery(parser, args);
+    if (command == "add-contact") return cmdAddContact(parser, args, settings);
+    if (command == "update-contact") return cmdUpdateContact(args, settings);
+    if (command == "add-action") return cmdAddAction(parser, args, settings);
+    if (command == "done") return cmdDone(args, settings);
+    if (command == "import") return cmdImport(args);
+    if (command == "import-mail") return cmdImportMail(args);
+    if (command == "export") return cmdExport(parser, args);
+    if (command == "maintenance") return cmdMaintenance(parser);
+
+    return error(QStringLiteral("Unknown command: %1").arg(command), usage);
+}
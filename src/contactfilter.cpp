@@ -0,0 +1,165 @@
+#include "src/contactfilter.h"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "src/contactsmodel.h"
+#include "src/database.h"
+
+namespace {
+// Wait this long after the last keystroke before we search
+constexpr int debounce_ms = 250;
+}
+
+ContactFilterWorker::ContactFilterWorker(const QString &dbpath, const std::atomic_int &generation)
+    : connection_{QStringLiteral("contact-filter"), dbpath}, generation_{generation}
+{
+}
+
+void ContactFilterWorker::search(int generation, const QString &text, int parent, int maxIds)
+{
+    if (generation != generation_) {
+        return; // Superseded while it was queued
+    }
+
+    db_ = connection_.open();
+    if (!db_.isValid()) {
+        return;
+    }
+
+    QString escaped = text;
+    escaped.replace("\\", "\\\\");
+    escaped.replace("_", "\\_");
+    escaped.replace("%", "\\%");
+    const auto pattern = QStringLiteral("%%1%").arg(escaped);
+
+    // The contacts are read in the order of the contact_contact_name index,
+    // a chunk at a time, and SQLite matches the names. Each chunk starts
+    // after the last contact of the one before, so a search that is
+    // superseded can stop between two short queries.
+    const auto select = QStringLiteral(
+                "select id, name, name like ? ESCAPE '\\' from contact "
+                "where %1 and name is not null %2 "
+                "order by name, id limit ?")
+            .arg(parent ? "contact = ?" : "contact is NULL");
+
+    QSqlQuery first(db_), next(db_);
+    if (!first.prepare(select.arg(QString{}))
+            || !next.prepare(select.arg("and name >= ? and (name > ? or id > ?)"))) {
+        qWarning() << "Contact filter query failed: " << first.lastError().text()
+                   << next.lastError().text();
+        return;
+    }
+
+    QList<int> ids;
+    bool more = false;
+    QVariant last_name;
+    int last_id = 0;
+    for(auto query = &first;; query = &next) {
+        query->addBindValue(pattern);
+        if (parent) {
+            query->addBindValue(parent);
+        }
+        if (query == &next) {
+            query->addBindValue(last_name);
+            query->addBindValue(last_name);
+            query->addBindValue(last_id);
+        }
+        query->addBindValue(chunkSize);
+
+        if (!query->exec()) {
+            qWarning() << "Contact filter query failed: " << query->lastError().text();
+            return;
+        }
+
+        int rows = 0;
+        while(query->next()) {
+            ++rows;
+            last_id = query->value(0).toInt();
+            last_name = query->value(1);
+            if (query->value(2).toBool()) {
+                if (ids.size() == maxIds) {
+                    more = true;
+                    break;
+                }
+                ids << last_id;
+            }
+        }
+        query->finish();
+
+        if (more || rows < chunkSize) {
+            break;
+        }
+
+        if (generation != generation_) {
+            return;
+        }
+    }
+
+    emit found(generation, text, ids, more);
+}
+
+ContactFilter::ContactFilter(ContactsModel &model, QObject *parent)
+    : QObject(parent)
+    , model_{model}
+    , host_{new ContactFilterWorker(Database::instance().path(), generation_)}
+{
+    timer_.setSingleShot(true);
+    timer_.setInterval(debounce_ms);
+    connect(&timer_, &QTimer::timeout, this, &ContactFilter::start);
+    connect(host_.worker(), &ContactFilterWorker::found, this, &ContactFilter::onFound);
+}
+
+ContactFilter::~ContactFilter()
+{
+    ++generation_;
+}
+
+void ContactFilter::setText(const QString &text)
+{
+    text_ = text;
+
+    // Anything in flight is for an older text
+    ++generation_;
+
+    if (text.isEmpty()) {
+        // Cheap, and should not feel delayed
+        timer_.stop();
+        model_.setNameFilter(text);
+        emit listed(model_.rowCount(), false);
+        return;
+    }
+
+    timer_.start();
+}
+
+void ContactFilter::setContact(int id, const QString &name)
+{
+    text_ = name;
+    ++generation_;
+    timer_.stop();
+    model_.setNameFilter(name, {id});
+    emit listed(model_.rowCount(), false);
+}
+
+void ContactFilter::start()
+{
+    const auto worker = host_.worker();
+    const int generation = generation_;
+    const auto text = text_;
+    const auto parent = model_.parentContact();
+    host_.post([worker, generation, text, parent] {
+        worker->search(generation, text, parent, maxIds);
+    });
+}
+
+void ContactFilter::onFound(int generation, const QString &text, const QList<int> &ids, bool more)
+{
+    if (generation != generation_) {
+        return;
+    }
+
+    model_.setNameFilter(text, ids);
+    emit listed(ids.size(), more);
+}
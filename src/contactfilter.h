@@ -0,0 +1,80 @@
+#ifndef CONTACTFILTER_H
+#define CONTACTFILTER_H
+
+#include <atomic>
+
+#include <QList>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+#include <QTimer>
+
+#include "database.h"
+#include "workerhost.h"
+
+class ContactsModel;
+
+// Runs the name lookups for the contact filter on a worker thread
+class ContactFilterWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Contacts read per query, between the checks for a newer search
+    static constexpr int chunkSize = 2000;
+
+    ContactFilterWorker(const QString& dbpath, const std::atomic_int& generation);
+
+public slots:
+    void search(int generation, const QString& text, int parent, int maxIds);
+
+signals:
+    // ids are the first maxIds matches, in name order. more is true if
+    // there are more matches than that.
+    void found(int generation, const QString& text, const QList<int>& ids, bool more);
+
+private:
+    WorkerConnection connection_;
+    const std::atomic_int& generation_;
+    QSqlDatabase db_;
+};
+
+// Debounced, asynchronous name filter for a ContactsModel.
+//
+// The text is looked up on a separate database connection in a worker
+// thread when the user stops typing. The names are read in chunks, in the
+// order the model lists them, and a lookup that is superseded by newer
+// text stops at the next chunk. The model then just selects the matching
+// id's. If there are many matches, only the first page of them is listed.
+class ContactFilter : public QObject
+{
+    Q_OBJECT
+public:
+    // Most contacts listed for a filter text
+    static constexpr int maxIds = 500;
+
+    ContactFilter(ContactsModel& model, QObject *parent);
+    ~ContactFilter();
+
+public slots:
+    void setText(const QString& text);
+
+    // List only the contact id, for its name in the filter
+    void setContact(int id, const QString& name);
+
+signals:
+    // The model lists count contacts. more is true if more contacts match.
+    void listed(int count, bool more);
+
+private slots:
+    void start();
+    void onFound(int generation, const QString& text, const QList<int>& ids, bool more);
+
+private:
+    ContactsModel& model_;
+    QTimer timer_;
+    QString text_;
+    std::atomic_int generation_{0};
+    WorkerHost<ContactFilterWorker> host_;
+};
+
+#endif // CONTACTFILTER_H
@@ -0,0 +1,40 @@
+#include "src/contactnamecache.h"
+
+#include <QVariant>
+
+#include "src/statementcache.h"
+
+ContactNameCache::ContactNameCache(StatementCache &statements)
+    : statements_{statements}
+{
+}
+
+QString ContactNameCache::name(const int id)
+{
+    if (id <= 0) {
+        return {};
+    }
+
+    auto it = names_.find(id);
+    if (it != names_.end()) {
+        return *it;
+    }
+
+    const auto value = statements_.scalar(
+                QStringLiteral("select name from contact where id = ?"), {id});
+    if (!value.isValid()) {
+        return {};
+    }
+
+    return *names_.insert(id, value.toString());
+}
+
+void ContactNameCache::invalidate(const int id)
+{
+    names_.remove(id);
+}
+
+void ContactNameCache::clear()
+{
+    names_.clear();
+}
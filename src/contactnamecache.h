@@ -0,0 +1,33 @@
+#ifndef CONTACTNAMECACHE_H
+#define CONTACTNAMECACHE_H
+
+#include <QHash>
+#include <QString>
+
+class StatementCache;
+
+// Maps contact id's to their names without a database round-trip for
+// every painted cell.
+//
+// Names are looked up on first use. ContactsModel invalidates entries
+// when contacts are renamed or removed. Misses are not cached, and id's
+// are never re-used (AUTOINCREMENT), so inserts need no invalidation.
+//
+// Only use this from the thread that owns the applications database connection.
+class ContactNameCache
+{
+public:
+    explicit ContactNameCache(StatementCache& statements);
+
+    // Get the name of a contact or person. Returns an empty string if not found.
+    QString name(const int id);
+
+    void invalidate(const int id);
+    void clear();
+
+private:
+    StatementCache& statements_;
+    QHash<int, QString> names_;
+};
+
+#endif // CONTACTNAMECACHE_H
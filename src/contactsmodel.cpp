@@ -15,6 +15,7 @@
 #include "src/strategy.h"
 #include "src/release.h"
 #include "src/journalmodel.h"
+#include "src/transaction.h"
 
 using namespace std;
 
@@ -65,6 +66,25 @@ ContactsModel::ContactsModel(QSettings& settings, QObject *parent, QSqlDatabase
 
     setSort(h_name_, Qt::AscendingOrder);
     setNameFilter({});
+
+    // Keep the shared name lookup in sync with our edits
+    connect(this, &QSqlTableModel::beforeUpdate, this, [this](int row, QSqlRecord& rec) {
+        if (rec.isGenerated(h_name_)) {
+            Database::instance().contactNames().invalidate(
+                        QSqlTableModel::data(index(row, h_id_, {}), Qt::DisplayRole).toInt());
+        }
+    });
+
+    connect(this, &QSqlTableModel::beforeDelete, this, [this](int row) {
+        auto& names = Database::instance().contactNames();
+        if (QSqlTableModel::data(index(row, h_type_, {}), Qt::DisplayRole).toInt()
+                == static_cast<int>(ContactType::CORPORATION)) {
+            // The persons belonging to the company are deleted by the database
+            names.clear();
+        } else {
+            names.invalidate(QSqlTableModel::data(index(row, h_id_, {}), Qt::DisplayRole).toInt());
+        }
+    });
 }
 
 
@@ -92,6 +112,10 @@ QVariant ContactsModel::data(const QModelIndex &ix, int role) const
             if (ix.column() == h_stars_) {
                 return getStars(std::max(0, QSqlTableModel::data(ix, Qt::DisplayRole).toInt()));
             }
+        } else if (role == Qt::ToolTipRole) {
+            if (ix.column() == h_name_) {
+                return actionSummary(QSqlTableModel::data(index(ix.row(), h_id_, {}), Qt::DisplayRole).toInt());
+            }
         }
 
     }
@@ -120,14 +144,17 @@ int ContactsModel::getContactId(const QModelIndex &ix) const
                 Qt::DisplayRole).toInt();
 }
 
-void ContactsModel::setNameFilter(const QString &filter)
+QString ContactsModel::parentFilter() const
 {
-    QString parent_filter;
     if (parent_) {
-        parent_filter = QStringLiteral("contact = %1").arg(parent_);
-    } else {
-        parent_filter = "contact is NULL";
+        return QStringLiteral("contact = %1").arg(parent_);
     }
+    return "contact is NULL";
+}
+
+void ContactsModel::setNameFilter(const QString &filter)
+{
+    const auto parent_filter = parentFilter();
 
     if (filter.isEmpty()) {
         setFilter(parent_filter);
@@ -135,6 +162,7 @@ void ContactsModel::setNameFilter(const QString &filter)
         // We have to escape certain characters
         QString escaped = filter;
         escaped.replace("'", "''");
+        escaped.replace("\\", "\\\\");
         escaped.replace("_", "\\_");
         escaped.replace("%", "\\%");
         QString full_filter;
@@ -143,6 +171,23 @@ void ContactsModel::setNameFilter(const QString &filter)
     }
 }
 
+void ContactsModel::setNameFilter(const QString &filter, const QList<int> &ids)
+{
+    if (filter.isEmpty()) {
+        setNameFilter(filter);
+        return;
+    }
+
+    QStringList values;
+    values.reserve(ids.size());
+    for(const auto id : ids) {
+        values << QString::number(id);
+    }
+
+    // Primary key lookups, instead of scanning all the names again
+    setFilter(QStringLiteral("%1 and id in (%2)").arg(parentFilter()).arg(values.join(',')));
+}
+
 void ContactsModel::setParent(int contact)
 {
     parent_ = contact;
@@ -152,6 +197,7 @@ void ContactsModel::setParent(int contact)
 void ContactsModel::removeContacts(const QModelIndexList &indexes)
 {
     Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
 
     const auto internal_edit_save = internal_edit_;
     internal_edit_ = true;
@@ -171,13 +217,15 @@ void ContactsModel::removeContacts(const QModelIndexList &indexes)
         const auto parent = rec.value("contact").toInt();
         const bool is_company = rec.value(h_type_).toInt() == static_cast<int>(ContactType::CORPORATION);
 
-        JournalModel::instance().addEntry(JournalModel::Type::DELETED_SOMETHING,
+        if (!JournalModel::instance().addEntry(JournalModel::Type::DELETED_SOMETHING,
                                           QStringLiteral("Deleted %1 #%2 %3")
                                           .arg(is_company ? "Contact" : "Person")
                                           .arg(rec.value(h_id_).toInt())
                                           .arg(rec.value(h_name_).toString()),
                                           parent ? parent : id,
-                                          parent ? id : 0);
+                                          parent ? id : 0)) {
+            return; // Rolled back
+        }
 
         if (!removeRow(row, {})) {
             qWarning() << "Failed to remove row " << row << ": "
@@ -186,51 +234,57 @@ void ContactsModel::removeContacts(const QModelIndexList &indexes)
     }
 
     if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
+        qWarning() << "Failed to remove contacts (submitAll): "
                    << lastError().text();
+        transaction.rollback();
+        select();
+        return;
     }
+
+    transaction.commit();
 }
 
 void ContactsModel::addPerson(const QSqlRecord &rec)
 {
     QSqlRecord my_rec{rec};
     insertContact(my_rec);
-    select();
 }
 
 void ContactsModel::toggleFavoriteStatus(const int row)
 {
     Q_ASSERT(row >= 0);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
+
+    // setData() updates the field and re-reads only this row
     const auto ix = index(row, h_favorite_, {});
     const bool new_status = !data(ix, Qt::DisplayRole).toBool();
     if (!setData(ix, new_status)) {
-        qWarning() << "Failed to set stars (setData): "
+        qWarning() << "Failed to update flag (setData): "
                    << lastError().text();
         return;
     }
 
     const auto id = data(index(row, h_id_, {}), Qt::DisplayRole).toInt();
 
-    if (!submitAll()) {
-        qWarning() << "Failed to update flag (submitAll): "
-                   << lastError().text();
-        return;
-    }
-
-    JournalModel::instance().addEntry(
+    if (!JournalModel::instance().addEntry(
                 JournalModel::Type::UPDATED_CONTACT,
                 new_status ? "Set the Favourite flag" : "Removed the Favourite flag",
-                id);
+                id)
+            || !transaction.commit()) {
+        transaction.rollback();
+        selectRow(row);
+    }
 }
 
 void ContactsModel::setStars(const int row, const int stars)
 {
     Q_ASSERT(row >= 0);
     Q_ASSERT(stars >= 0 && stars <= 5);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
 
     const auto ix = index(row, h_stars_, {});
     if (!setData(ix, stars)) {
@@ -238,18 +292,17 @@ void ContactsModel::setStars(const int row, const int stars)
                    << lastError().text();
         return;
     }
-    if (!submitAll()) {
-        qWarning() << "Failed to update flag (submitAll): "
-                   << lastError().text();
-        return;
-    }
     const auto id = data(index(row, h_id_, {}), Qt::DisplayRole).toInt();
 
-    JournalModel::instance().addEntry(
+    if (!JournalModel::instance().addEntry(
                 JournalModel::Type::UPDATED_CONTACT,
                 QStringLiteral("Set %1 stars")
                 .arg(stars),
-                id);
+                id)
+            || !transaction.commit()) {
+        transaction.rollback();
+        selectRow(row);
+    }
 }
 
 bool ContactsModel::insertContact(QSqlRecord &rec)
@@ -258,19 +311,18 @@ bool ContactsModel::insertContact(QSqlRecord &rec)
     rec.setValue(h_created_date_, now);
     rec.setValue(h_last_activity_date_, now);
 
+    Transaction transaction;
+
+    // Let the model fetch the new id and re-read the row,
+    // instead of re-selecting the whole table.
+    rec.setGenerated(h_id_, false);
     if (!insertRecord(0, rec)) {
         qWarning() << "Failed to add new contact (insertRecord): "
                    << lastError().text();
         return false;
     }
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
-                   << lastError().text();
-        return false;
-    }
-
-    const auto contact_id = query().lastInsertId().toInt();
+    const auto contact_id = data(index(0, h_id_, {}), Qt::DisplayRole).toInt();
     const auto what = parent_ ? "Person" : "Contact";
     const auto contact_type = rec.value(h_type_).toInt();
 
@@ -278,11 +330,16 @@ bool ContactsModel::insertContact(QSqlRecord &rec)
             ? JournalModel::Type::ADD_COMPANY
             : JournalModel::Type::ADD_PERSON;
 
-    JournalModel::instance().addEntry(
+    if (!JournalModel::instance().addEntry(
                 log_type,
                 QStringLiteral("Added %1: %2").arg(what).arg(rec.value(h_name_).toString()),
                 parent_ ? parent_ : contact_id,
-                parent_ ? contact_id : 0);
+                parent_ ? contact_id : 0)
+            || !transaction.commit()) {
+        transaction.rollback();
+        select(); // Drop the row we inserted
+        return false;
+    }
 
     qDebug() << QStringLiteral("Created new %1 #").arg(what) << contact_id;
     return true;
@@ -296,6 +353,34 @@ const QIcon& ContactsModel::getFavoriteIcon(const bool enable)
     return enable ? fav : not_fav;
 }
 
+QVariant ContactsModel::actionSummary(const int contact)
+{
+    auto& db = Database::instance();
+
+    // Kept by the triggers on action. Overdue depends on the time, so it
+    // is counted here.
+    auto& counters = db.query(
+                QStringLiteral("select open_actions, done_actions, cancelled_actions, failed_actions "
+                               "from action_counter where contact = ?"), {contact});
+    if (!counters.next()) {
+        counters.finish();
+        return {};
+    }
+
+    const auto open = counters.value(0).toInt();
+    const auto done = counters.value(1).toInt();
+    const auto cancelled = counters.value(2).toInt();
+    const auto failed = counters.value(3).toInt();
+    counters.finish();
+
+    const auto overdue = open ? db.scalar(
+                QStringLiteral("select count(*) from action where contact = ? and state < 4 and due_date < ?"),
+                {contact, static_cast<uint>(time(nullptr))}).toInt() : 0;
+
+    return QStringLiteral("%1 open actions (%2 overdue), %3 done, %4 cancelled, %5 failed")
+            .arg(open).arg(overdue).arg(done).arg(cancelled).arg(failed);
+}
+
 const QIcon &ContactsModel::getStars(const int stars)
 {
     static const std::array<QIcon,6> icons = {{
@@ -312,7 +397,6 @@ const QIcon &ContactsModel::getStars(const int stars)
 
 QModelIndex ContactsModel::createContact(const ContactType type)
 {
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
     auto rec = record();
 
     rec.setValue(h_name_, QStringLiteral(""));
@@ -322,7 +406,7 @@ QModelIndex ContactsModel::createContact(const ContactType type)
         return {};
     }
 
-    return index(0, h_name_, {}); // Assume that we insterted at end in the model
+    return index(0, h_name_, {}); // insertContact() puts it at the top
 }
 
 
@@ -40,15 +40,24 @@ public:
 
     QModelIndex createContact(const ContactType type);
 
+    // Add rec as a new contact (or person, if we have a parent) and journal it
+    bool insertContact(QSqlRecord& rec);
+
 public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     int getContactId(const QModelIndex& ix) const;
 
+    // The company we list persons for, or 0 if we list top-level contacts
+    int parentContact() const noexcept { return parent_; }
+
 public slots:
     void setNameFilter(const QString& filter);
 
+    // Show only the contacts in ids, which was looked up (elsewhere) for filter
+    void setNameFilter(const QString& filter, const QList<int>& ids);
+
     // If used, this instance is for contacts belonging to a company (parent contact)
     void setParent(int contact);
     void removeContacts(const QModelIndexList& indexes);
@@ -57,10 +66,13 @@ public slots:
     void setStars(const int row, const int stars);
 
 private:
-    bool insertContact(QSqlRecord& rec);
+    QString parentFilter() const;
     static const QIcon& getFavoriteIcon(const bool enable);
     static const QIcon& getStars(const int stars);
 
+    // The action counters for a contact (action_counter), as a tooltip
+    static QVariant actionSummary(const int contact);
+
     QSettings& settings_;
 
     int h_id_ = {};
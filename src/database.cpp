@@ -1,17 +1,49 @@
 #include "src/database.h"
 
+#include <array>
+
 #include <QDebug>
 #include <QFileInfo>
+#include <QStringList>
+#include <QUuid>
+
+#include "src/blobstore.h"
+#include "src/channel.h"
+
+Database *Database::instance_;
+
+namespace {
+const auto DRIVER{QStringLiteral("QSQLITE")};
+
+// The text columns we index for full-text search. Each table gets its
+// own external content FTS5 table, named <table>_fts.
+struct SearchSource {
+    const char *table;
+    QStringList columns;
+};
+
+const std::array<SearchSource, 5>& searchSources() {
+    static const std::array<SearchSource, 5> sources = {{
+        {"contact", {"name", "notes", "address1", "address2"}},
+        {"document", {"name", "notes", "location"}},
+        {"intent", {"abstract", "notes"}},
+        {"action", {"name", "desired_outcome", "notes"}},
+        {"journal", {"text"}},
+    }};
 
+    return sources;
+}
+}
 
-Database::Database(QObject *parent)
+Database::Database(QObject *parent, const QString &path)
     : QObject(parent)
 {
-    static const auto DRIVER{QStringLiteral("QSQLITE")};
+    Q_ASSERT(!instance_);
 
     QSettings settings;
 
-    const auto dbpath = settings.value("dbpath").toString();
+    const auto dbpath = path.isEmpty() ? settings.value("dbpath").toString() : path;
+    path_ = dbpath;
     const bool new_database = (dbpath == ":memory:") || (!QFileInfo(dbpath).isFile());
 
     if(!QSqlDatabase::isDriverAvailable(DRIVER)) {
@@ -27,6 +59,22 @@ Database::Database(QObject *parent)
     }
 
     QSqlQuery("PRAGMA foreign_keys = ON");
+    QSqlQuery(QStringLiteral("PRAGMA busy_timeout = %1").arg(busyTimeout));
+
+    // The importer, mail ingester, file drop and file monitor write on
+    // their own connections while the models read. With a write-ahead log
+    // the readers and the writer don't block each other. It is a
+    // property of the database file, so this only changes it once.
+    if (dbpath != ":memory:") {
+        QSqlQuery wal("PRAGMA journal_mode = WAL");
+        if (!wal.next() || wal.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0) {
+            qWarning() << "Failed to enable the write-ahead log for " << dbpath;
+        }
+    }
+
+    statements_ = std::make_unique<StatementCache>(db_);
+    contact_names_ = std::make_unique<ContactNameCache>(*statements_);
+    detail_cache_ = std::make_unique<DetailCache>();
 
     if (new_database) {
         qInfo() << "Creating new database at location: " << dbpath;
@@ -39,17 +87,33 @@ Database::Database(QObject *parent)
     }
 
     const auto dbver = query.value(FCRM_VERSION).toInt();
+    query.finish();
     qDebug() << "Database schema version is " << dbver;
-    if (dbver != currentVersion) {
+    if (dbver < currentVersion) {
+        upgradeDatabase(dbver);
+    } else if (dbver > currentVersion) {
         qWarning() << "Database schema version is "
                    << dbver
-                   << " while I expected " << currentVersion;
+                   << " while I expected " << currentVersion
+                   << ". The database was probably created by a newer version of f-crm.";
     }
 
+    prepareSearchIndex();
+
+    instance_ = this;
 }
 
 Database::~Database()
 {
+    if (instance_ == this) {
+        instance_ = {};
+    }
+
+    // The prepared statements must go before the connection
+    detail_cache_.reset();
+    contact_names_.reset();
+    statements_.reset();
+
     // Close the database and remove the connection to make our tests happy (no warnings).
     const auto name = db_.connectionName();
     db_.close();
@@ -57,6 +121,157 @@ Database::~Database()
     db_.removeDatabase(name);
 }
 
+QSqlDatabase Database::openConnection(const QString &name, const QString &path)
+{
+    auto db = QSqlDatabase::addDatabase(DRIVER, name);
+    db.setDatabaseName(path);
+
+    if (!db.open()) {
+        qWarning() << "Failed to open database connection " << name << ": "
+                   << db.lastError().text();
+        throw Error("Failed to open database");
+    }
+
+    QSqlQuery query(db);
+    query.exec("PRAGMA foreign_keys = ON");
+    query.exec(QStringLiteral("PRAGMA busy_timeout = %1").arg(workerBusyTimeout));
+
+    return db;
+}
+
+WorkerConnection::WorkerConnection(const QString &name, const QString &path)
+    : name_{name}, path_{path}
+{
+}
+
+WorkerConnection::~WorkerConnection()
+{
+    if (own_connection_ && db_.isValid()) {
+        const auto name = db_.connectionName();
+        db_.close();
+        db_ = {};
+        QSqlDatabase::removeDatabase(name);
+    }
+}
+
+QSqlDatabase WorkerConnection::open()
+{
+    if (db_.isValid()) {
+        return db_;
+    }
+
+    if (path_ == ":memory:") {
+        // Run on the applications connection, in the main thread
+        db_ = QSqlDatabase::database();
+        return db_;
+    }
+
+    try {
+        db_ = Database::openConnection(
+                    QStringLiteral("%1-%2").arg(name_, QUuid::createUuid().toString()),
+                    path_);
+        own_connection_ = true;
+    } catch(const std::exception& ex) {
+        qWarning() << name_ << ": " << ex.what();
+        return {};
+    }
+
+    return db_;
+}
+
+bool Database::optimize(const bool vacuum)
+{
+    Q_ASSERT(transaction_depth_ == 0);
+
+    const auto removed = BlobStore(db_).collectGarbage();
+    qDebug() << "Removed " << removed << " unreferenced blobs";
+
+    QSqlQuery query(db_);
+    if (has_search_index_) {
+        for(const auto& src : searchSources()) {
+            const QString fts = QStringLiteral("%1_fts").arg(src.table);
+            if (!query.exec(QStringLiteral("INSERT INTO \"%1\"(\"%1\") VALUES ('optimize')").arg(fts))) {
+                qWarning() << "Failed to optimize " << fts << ": " << query.lastError().text();
+                return false;
+            }
+        }
+    }
+
+    if (!query.exec("ANALYZE")) {
+        qWarning() << "ANALYZE failed: " << query.lastError().text();
+        return false;
+    }
+
+    if (vacuum) {
+        // Prepared statements would keep the old pages alive
+        statements_->clear();
+        if (!query.exec("VACUUM")) {
+            qWarning() << "VACUUM failed: " << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Database::beginTransaction()
+{
+    if (transaction_depth_++ == 0) {
+        rollback_only_ = false;
+        if (!db_.transaction()) {
+            qWarning() << "Failed to start transaction: " << db_.lastError().text();
+            --transaction_depth_;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Database::commitTransaction()
+{
+    Q_ASSERT(transaction_depth_ > 0);
+
+    if (--transaction_depth_ > 0) {
+        return !rollback_only_;
+    }
+
+    if (rollback_only_) {
+        qWarning() << "Rolling back transaction, as a nested transaction failed";
+        db_.rollback();
+        contact_names_->clear();
+        detail_cache_->clear();
+        emit rolledBack();
+        return false;
+    }
+
+    if (!db_.commit()) {
+        qWarning() << "Failed to commit transaction: " << db_.lastError().text();
+        db_.rollback();
+        contact_names_->clear();
+        detail_cache_->clear();
+        emit rolledBack();
+        return false;
+    }
+
+    return true;
+}
+
+void Database::rollbackTransaction()
+{
+    Q_ASSERT(transaction_depth_ > 0);
+
+    if (--transaction_depth_ > 0) {
+        rollback_only_ = true;
+        return;
+    }
+
+    db_.rollback();
+    contact_names_->clear();
+    detail_cache_->clear();
+    emit rolledBack();
+}
+
 void Database::createDatabase()
 {
     db_.transaction();
@@ -70,9 +285,11 @@ void Database::createDatabase()
         exec(R"(CREATE TABLE "document" ( `id` INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT UNIQUE, `contact` INTEGER NOT NULL, `person` INTEGER, `intent` INTEGER, `activity` INTEGER, `type` INTEGER NOT NULL DEFAULT 0, `cls` INTEGER NOT NULL, `direction` INTEGER NOT NULL, `entity` INTEGER NOT NULL, `name` TEXT NOT NULL, `notes` TEXT, `added_date` INTEGER NOT NULL, `file_date` INTEGER, `location` TEXT, `content` BLOB, FOREIGN KEY(`contact`) REFERENCES `contact`(`id`) ON DELETE CASCADE, FOREIGN KEY(`person`) REFERENCES `contact`(`id`) ON DELETE CASCADE, FOREIGN KEY(`intent`) REFERENCES `intent`(`id`) ON DELETE CASCADE, FOREIGN KEY(`activity`) REFERENCES `action`(`id`) ON DELETE CASCADE ))");
         exec(R"(CREATE TABLE "journal" ( `id` INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT UNIQUE, `type` INTEGER NOT NULL, `date` INTEGER NOT NULL, `contact` INTEGER, `person` INTEGER, `intent` INTEGER, `channel` INTEGER, `activity` INTEGER, `document` INTEGER, `text` TEXT NOT NULL, FOREIGN KEY(`contact`) REFERENCES `contact`(`id`) ON DELETE SET NULL, FOREIGN KEY(`person`) REFERENCES `contact`(`id`) ON DELETE SET NULL, FOREIGN KEY(`intent`) REFERENCES `intent`(`id`) ON DELETE SET NULL, FOREIGN KEY(`channel`) REFERENCES `channel`(`id`) ON DELETE SET NULL, FOREIGN KEY(`activity`) REFERENCES `action`(`id`) ON DELETE SET NULL, FOREIGN KEY(`document`) REFERENCES `document`(`id`) ON DELETE SET NULL ))");
 
+        // Version 1 is the original schema. Everything after that is
+        // applied by upgradeDatabase(), for new and old databases alike.
         QSqlQuery query(db_);
         query.prepare("INSERT INTO f_crm (version) VALUES (:version)");
-        query.bindValue(":version", currentVersion);
+        query.bindValue(":version", 1);
         if(!query.exec()) {
             throw Error(QStringLiteral("Failed to initialize database: %1").arg(query.lastError().text()));
         }
@@ -85,6 +302,301 @@ void Database::createDatabase()
     db_.commit();
 }
 
+void Database::upgradeDatabase(const int fromVersion)
+{
+    for(int version = fromVersion + 1; version <= currentVersion; ++version) {
+        qInfo() << "Upgrading database schema to version " << version;
+
+        db_.transaction();
+
+        try {
+            switch(version) {
+            case 2:
+                upgradeToVersion2();
+                break;
+            case 3:
+                upgradeToVersion3();
+                break;
+            case 4:
+                upgradeToVersion4();
+                break;
+            case 5:
+                upgradeToVersion5();
+                break;
+            case 6:
+                upgradeToVersion6();
+                break;
+            case 7:
+                upgradeToVersion7();
+                break;
+            case 8:
+                upgradeToVersion8();
+                break;
+            case 9:
+                upgradeToVersion9();
+                break;
+            case 10:
+                upgradeToVersion10();
+                break;
+            case 11:
+                upgradeToVersion11();
+                break;
+            default:
+                throw Error(QStringLiteral("No migration to database schema version %1").arg(version));
+            }
+
+            setVersion(version);
+
+        } catch(const std::exception&) {
+            db_.rollback();
+            throw;
+        }
+
+        db_.commit();
+    }
+}
+
+void Database::setVersion(const int version)
+{
+    QSqlQuery query(db_);
+    query.prepare("UPDATE f_crm SET version = :version");
+    query.bindValue(":version", version);
+    if(!query.exec()) {
+        throw Error(QStringLiteral("Failed to update the schema version: %1").arg(query.lastError().text()));
+    }
+}
+
+void Database::upgradeToVersion2()
+{
+    // Indexes matching the queries we run when a contact is selected.
+    exec(R"(CREATE INDEX IF NOT EXISTS "action_contact_intent_sequence" ON "action" (`contact`, `intent`, `sequence`))");
+    exec(R"(CREATE INDEX IF NOT EXISTS "action_state_start_date" ON "action" (`state`, `start_date`))");
+    exec(R"(CREATE INDEX IF NOT EXISTS "journal_contact_date" ON "journal" (`contact`, `date`))");
+    exec(R"(CREATE INDEX IF NOT EXISTS "document_contact_added_date" ON "document" (`contact`, `added_date`))");
+    exec(R"(CREATE INDEX IF NOT EXISTS "channel_contact_value" ON "channel" (`contact`, `value`))");
+    exec(R"(CREATE INDEX IF NOT EXISTS "contact_contact_name" ON "contact" (`contact`, `name`))");
+    exec("ANALYZE");
+}
+
+void Database::upgradeToVersion3()
+{
+    // Content-addressed, de-duplicated storage for document content. See BlobStore.
+    exec(R"(CREATE TABLE "blob" ( `hash` TEXT NOT NULL PRIMARY KEY, `size` INTEGER NOT NULL, `refcount` INTEGER NOT NULL DEFAULT 0 ) WITHOUT ROWID)");
+    exec(R"(CREATE TABLE "blob_chunk" ( `hash` TEXT NOT NULL, `seq` INTEGER NOT NULL, `compressed` INTEGER NOT NULL DEFAULT 0, `data` BLOB NOT NULL, PRIMARY KEY(`hash`, `seq`), FOREIGN KEY(`hash`) REFERENCES `blob`(`hash`) ON DELETE CASCADE ON UPDATE CASCADE ) WITHOUT ROWID)");
+    exec(R"(ALTER TABLE "document" ADD COLUMN `content_hash` TEXT REFERENCES `blob`(`hash`))");
+
+    // Reference counting. A blob goes away with its last reference.
+    exec(R"(CREATE TRIGGER "document_blob_ai" AFTER INSERT ON "document" WHEN new.content_hash IS NOT NULL BEGIN
+            UPDATE blob SET refcount = refcount + 1 WHERE hash = new.content_hash;
+         END)");
+    exec(R"(CREATE TRIGGER "document_blob_ad" AFTER DELETE ON "document" WHEN old.content_hash IS NOT NULL BEGIN
+            UPDATE blob SET refcount = refcount - 1 WHERE hash = old.content_hash;
+         END)");
+    exec(R"(CREATE TRIGGER "document_blob_au" AFTER UPDATE OF content_hash ON "document" WHEN old.content_hash IS NOT new.content_hash BEGIN
+            UPDATE blob SET refcount = refcount + 1 WHERE hash = new.content_hash;
+            UPDATE blob SET refcount = refcount - 1 WHERE hash = old.content_hash;
+         END)");
+    exec(R"(CREATE TRIGGER "blob_gc" AFTER UPDATE OF refcount ON "blob" WHEN new.refcount <= 0 BEGIN
+            DELETE FROM blob WHERE hash = new.hash;
+         END)");
+
+    // Move any inline content to the blob store, one document at a time
+    QList<int> ids;
+    {
+        QSqlQuery query(db_);
+        query.setForwardOnly(true);
+        query.exec("SELECT id FROM document WHERE content IS NOT NULL");
+        while(query.next()) {
+            ids << query.value(0).toInt();
+        }
+    }
+
+    BlobStore blobs(db_);
+    for(const auto id : ids) {
+        QSqlQuery query(db_);
+        query.prepare("SELECT content FROM document WHERE id = ?");
+        query.addBindValue(id);
+        if (!query.exec() || !query.next()) {
+            throw Error(QStringLiteral("Failed to read content for document #%1").arg(id));
+        }
+        const auto content = query.value(0).toByteArray();
+        query.finish();
+
+        const auto hash = blobs.write(content);
+        if (hash.isEmpty()) {
+            throw Error(QStringLiteral("Failed to move content for document #%1").arg(id));
+        }
+
+        query.prepare("UPDATE document SET content_hash = ?, content = NULL WHERE id = ?");
+        query.addBindValue(hash);
+        query.addBindValue(id);
+        if (!query.exec()) {
+            throw Error(QStringLiteral("Failed to update document #%1: %2").arg(id).arg(query.lastError().text()));
+        }
+    }
+}
+
+void Database::upgradeToVersion4()
+{
+    // Action counters, kept up to date by the triggers below.
+    // open is WAITING to ON_HOLD, then DONE, CANCELLED and FAILED.
+    exec(R"(ALTER TABLE "intent" ADD COLUMN `open_actions` INTEGER NOT NULL DEFAULT 0)");
+    exec(R"(ALTER TABLE "intent" ADD COLUMN `done_actions` INTEGER NOT NULL DEFAULT 0)");
+    exec(R"(ALTER TABLE "intent" ADD COLUMN `cancelled_actions` INTEGER NOT NULL DEFAULT 0)");
+    exec(R"(ALTER TABLE "intent" ADD COLUMN `failed_actions` INTEGER NOT NULL DEFAULT 0)");
+    exec(R"(CREATE TABLE "action_counter" ( `contact` INTEGER NOT NULL PRIMARY KEY, `open_actions` INTEGER NOT NULL DEFAULT 0, `done_actions` INTEGER NOT NULL DEFAULT 0, `cancelled_actions` INTEGER NOT NULL DEFAULT 0, `failed_actions` INTEGER NOT NULL DEFAULT 0, FOREIGN KEY(`contact`) REFERENCES `contact`(`id`) ON DELETE CASCADE ) WITHOUT ROWID)");
+
+    exec(R"(INSERT INTO action_counter (contact, open_actions, done_actions, cancelled_actions, failed_actions)
+            SELECT contact, sum(state < 4), sum(state = 4), sum(state = 5), sum(state = 6) FROM action GROUP BY contact)");
+    exec(R"(UPDATE intent SET
+            open_actions = (SELECT count(*) FROM action WHERE action.intent = intent.id AND state < 4),
+            done_actions = (SELECT count(*) FROM action WHERE action.intent = intent.id AND state = 4),
+            cancelled_actions = (SELECT count(*) FROM action WHERE action.intent = intent.id AND state = 5),
+            failed_actions = (SELECT count(*) FROM action WHERE action.intent = intent.id AND state = 6))");
+
+    exec(R"(CREATE TRIGGER "action_counter_ai" AFTER INSERT ON "action" BEGIN
+            INSERT OR IGNORE INTO action_counter (contact) VALUES (new.contact);
+            UPDATE action_counter SET open_actions = open_actions + (new.state < 4), done_actions = done_actions + (new.state = 4),
+                cancelled_actions = cancelled_actions + (new.state = 5), failed_actions = failed_actions + (new.state = 6)
+                WHERE contact = new.contact;
+            UPDATE intent SET open_actions = open_actions + (new.state < 4), done_actions = done_actions + (new.state = 4),
+                cancelled_actions = cancelled_actions + (new.state = 5), failed_actions = failed_actions + (new.state = 6)
+                WHERE id = new.intent;
+         END)");
+    exec(R"(CREATE TRIGGER "action_counter_ad" AFTER DELETE ON "action" BEGIN
+            UPDATE action_counter SET open_actions = open_actions - (old.state < 4), done_actions = done_actions - (old.state = 4),
+                cancelled_actions = cancelled_actions - (old.state = 5), failed_actions = failed_actions - (old.state = 6)
+                WHERE contact = old.contact;
+            UPDATE intent SET open_actions = open_actions - (old.state < 4), done_actions = done_actions - (old.state = 4),
+                cancelled_actions = cancelled_actions - (old.state = 5), failed_actions = failed_actions - (old.state = 6)
+                WHERE id = old.intent;
+         END)");
+    exec(R"(CREATE TRIGGER "action_counter_au" AFTER UPDATE OF state, contact, intent ON "action" BEGIN
+            UPDATE action_counter SET open_actions = open_actions - (old.state < 4), done_actions = done_actions - (old.state = 4),
+                cancelled_actions = cancelled_actions - (old.state = 5), failed_actions = failed_actions - (old.state = 6)
+                WHERE contact = old.contact;
+            UPDATE intent SET open_actions = open_actions - (old.state < 4), done_actions = done_actions - (old.state = 4),
+                cancelled_actions = cancelled_actions - (old.state = 5), failed_actions = failed_actions - (old.state = 6)
+                WHERE id = old.intent;
+            INSERT OR IGNORE INTO action_counter (contact) VALUES (new.contact);
+            UPDATE action_counter SET open_actions = open_actions + (new.state < 4), done_actions = done_actions + (new.state = 4),
+                cancelled_actions = cancelled_actions + (new.state = 5), failed_actions = failed_actions + (new.state = 6)
+                WHERE contact = new.contact;
+            UPDATE intent SET open_actions = open_actions + (new.state < 4), done_actions = done_actions + (new.state = 4),
+                cancelled_actions = cancelled_actions + (new.state = 5), failed_actions = failed_actions + (new.state = 6)
+                WHERE id = new.intent;
+         END)");
+
+    // A DEFINED intent is in PROGRESS once one of its actions is started
+    // (anything but WAITING or CANCELLED).
+    exec(R"(CREATE TRIGGER "intent_promote_ai" AFTER INSERT ON "action" WHEN new.intent IS NOT NULL AND new.state IN (1, 2, 3, 4, 6) BEGIN
+            UPDATE intent SET state = 1 WHERE id = new.intent AND state = 0;
+         END)");
+    exec(R"(CREATE TRIGGER "intent_promote_au" AFTER UPDATE OF state, intent ON "action" WHEN new.intent IS NOT NULL AND new.state IN (1, 2, 3, 4, 6) BEGIN
+            UPDATE intent SET state = 1 WHERE id = new.intent AND state = 0;
+         END)");
+    exec(R"(UPDATE intent SET state = 1 WHERE state = 0 AND EXISTS
+            (SELECT 1 FROM action WHERE action.intent = intent.id AND action.state IN (1, 2, 3, 4, 6)))");
+}
+
+void Database::upgradeToVersion5()
+{
+    // Actions can depend on other actions in the same intent. A WAITING
+    // action is opened when all the actions it depends on are finished.
+    exec(R"(CREATE TABLE "action_dependency" ( `action` INTEGER NOT NULL, `depends_on` INTEGER NOT NULL, PRIMARY KEY(`action`, `depends_on`), FOREIGN KEY(`action`) REFERENCES `action`(`id`) ON DELETE CASCADE, FOREIGN KEY(`depends_on`) REFERENCES `action`(`id`) ON DELETE CASCADE ) WITHOUT ROWID)");
+    exec(R"(CREATE INDEX "action_dependency_depends_on" ON "action_dependency" (`depends_on`))");
+
+    // Until now, the actions in an intent were a chain, ordered by sequence
+    exec(R"(INSERT INTO action_dependency (action, depends_on)
+            SELECT id, prev FROM (
+                SELECT a.id AS id, (SELECT p.id FROM action AS p
+                                    WHERE p.intent = a.intent AND p.sequence < a.sequence
+                                    ORDER BY p.sequence DESC LIMIT 1) AS prev
+                FROM action AS a WHERE a.intent IS NOT NULL)
+            WHERE prev IS NOT NULL)");
+}
+
+void Database::upgradeToVersion6()
+{
+    // Leave room between the actions in an intent, so an action can be
+    // moved or inserted by changing only its own sequence.
+    // See ActionsModel::sequenceGap
+    exec(R"(UPDATE action SET sequence = sequence * 1024)");
+}
+
+void Database::upgradeToVersion7()
+{
+    // Find the owner of an email address or phone number (IpcServer).
+    // The existing index on (contact, value) can't be used without the contact.
+    exec(R"(CREATE INDEX "channel_value" ON "channel" (`value` COLLATE NOCASE))");
+}
+
+void Database::upgradeToVersion8()
+{
+    // A normalized lookup key for each channel. See NormalizeChannelValue().
+    // It is computed here, not in SQL, so it matches what the application
+    // writes for new and edited channels.
+    exec(R"(ALTER TABLE "channel" ADD COLUMN `norm` TEXT)");
+
+    QVariantList ids, norms;
+    {
+        QSqlQuery query(db_);
+        query.setForwardOnly(true);
+        if (!query.exec("SELECT id, type, value FROM channel")) {
+            throw Error(QStringLiteral("Failed to read channels: %1").arg(query.lastError().text()));
+        }
+        while(query.next()) {
+            const auto norm = NormalizeChannelValue(query.value(1).toInt(), query.value(2).toString());
+            ids << query.value(0);
+            norms << (norm.isEmpty() ? QVariant{QVariant::String} : QVariant{norm});
+        }
+    }
+
+    if (!ids.isEmpty()) {
+        QSqlQuery update(db_);
+        update.prepare("UPDATE channel SET norm = ? WHERE id = ?");
+        update.addBindValue(norms);
+        update.addBindValue(ids);
+        if (!update.execBatch()) {
+            throw Error(QStringLiteral("Failed to normalize channels: %1").arg(update.lastError().text()));
+        }
+    }
+
+    // Normalized values are only compared within a channel type (see
+    // GetMatchingChannelType()), so the type leads the lookup key.
+    exec(R"(CREATE INDEX "channel_type_norm" ON "channel" (`type`, `norm`))");
+
+    // Replaced by channel_type_norm
+    exec(R"(DROP INDEX IF EXISTS "channel_value")");
+}
+
+void Database::upgradeToVersion9()
+{
+    // What the MailIngester has read: every Message-ID, and every mail
+    // file with its size and modification time (msecs). For an mbox that
+    // was only partly read, size and mtime are NULL and offset is where
+    // the next message starts.
+    exec(R"(CREATE TABLE "ingested_mail" ( `message_id` TEXT NOT NULL PRIMARY KEY ) WITHOUT ROWID)");
+    exec(R"(CREATE TABLE "mail_source" ( `path` TEXT NOT NULL PRIMARY KEY, `size` INTEGER, `mtime` INTEGER, `offset` INTEGER NOT NULL DEFAULT 0 ) WITHOUT ROWID)");
+}
+
+void Database::upgradeToVersion10()
+{
+    // The size and SHA-256 (hex) of the file behind a FILE document, when
+    // it was added, so a moved file can be found again by its content.
+    exec(R"(ALTER TABLE "document" ADD COLUMN `file_size` INTEGER)");
+    exec(R"(ALTER TABLE "document" ADD COLUMN `file_hash` TEXT)");
+    exec(R"(CREATE INDEX "document_file_hash" ON "document" (`file_hash`))");
+}
+
+void Database::upgradeToVersion11()
+{
+    // What the FileMonitor saw: the modification time (secs) that goes
+    // with file_size, and a Document::FileState.
+    exec(R"(ALTER TABLE "document" ADD COLUMN `file_mtime` INTEGER)");
+    exec(R"(ALTER TABLE "document" ADD COLUMN `file_state` INTEGER NOT NULL DEFAULT 0)");
+}
+
 void Database::exec(const char *sql)
 {
     QSqlQuery query(db_);
@@ -94,3 +606,81 @@ void Database::exec(const char *sql)
     }
 }
 
+void Database::exec(const QString &sql)
+{
+    QSqlQuery query(db_);
+    query.exec(sql);
+    if (query.lastError().type() != QSqlError::NoError) {
+        throw Error(QStringLiteral("SQL query failed: %1").arg(query.lastError().text()));
+    }
+}
+
+bool Database::isFts5Available()
+{
+    QSqlQuery query(db_);
+    if (!query.exec("CREATE VIRTUAL TABLE temp.fts5_probe USING fts5(x)")) {
+        return false;
+    }
+    query.exec("DROP TABLE temp.fts5_probe");
+    return true;
+}
+
+void Database::prepareSearchIndex()
+{
+    // The index is not part of the versioned schema, as it depends on how
+    // the sqlite library we run with is built. We create it the first time
+    // we run with FTS5 support.
+    QSqlQuery query(db_);
+    query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'journal_fts'");
+    if (query.next()) {
+        has_search_index_ = true;
+        return;
+    }
+    query.finish();
+
+    if (!isFts5Available()) {
+        qWarning() << "sqlite is built without FTS5. Full-text search is disabled.";
+        return;
+    }
+
+    qInfo() << "Creating the full-text search index";
+
+    db_.transaction();
+
+    try {
+        for(const auto& src : searchSources()) {
+            const QString table = src.table;
+            const QString fts = table + "_fts";
+            const auto columns = src.columns.join(", ");
+
+            QStringList new_values, old_values;
+            for(const auto& col : src.columns) {
+                new_values << "new." + col;
+                old_values << "old." + col;
+            }
+
+            const auto insert = QStringLiteral("INSERT INTO %1(rowid, %2) VALUES (new.id, %3);")
+                    .arg(fts, columns, new_values.join(", "));
+            const auto remove = QStringLiteral("INSERT INTO %1(%1, rowid, %2) VALUES ('delete', old.id, %3);")
+                    .arg(fts, columns, old_values.join(", "));
+
+            exec(QStringLiteral("CREATE VIRTUAL TABLE \"%1\" USING fts5(%2, content='%3', content_rowid='id')")
+                 .arg(fts, columns, table));
+            exec(QStringLiteral("CREATE TRIGGER \"%1_ai\" AFTER INSERT ON \"%2\" BEGIN %3 END")
+                 .arg(fts, table, insert));
+            exec(QStringLiteral("CREATE TRIGGER \"%1_ad\" AFTER DELETE ON \"%2\" BEGIN %3 END")
+                 .arg(fts, table, remove));
+            // Only re-index when an indexed column changes, not for flags and dates
+            exec(QStringLiteral("CREATE TRIGGER \"%1_au\" AFTER UPDATE OF %2 ON \"%3\" BEGIN %4 %5 END")
+                 .arg(fts, columns, table, remove, insert));
+            exec(QStringLiteral("INSERT INTO \"%1\"(\"%1\") VALUES ('rebuild')").arg(fts));
+        }
+    } catch(const std::exception& ex) {
+        qWarning() << "Failed to create the full-text search index: " << ex.what();
+        db_.rollback();
+        return;
+    }
+
+    db_.commit();
+    has_search_index_ = true;
+}
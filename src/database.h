@@ -3,6 +3,7 @@
 
 #include <QObject>
 
+#include <memory>
 #include <stdexcept>
 
 #include <QObject>
@@ -12,6 +13,9 @@
 #include <QSqlError>
 #include <QSqlQuery>
 
+#include "statementcache.h"
+#include "contactnamecache.h"
+#include "detailcache.h"
 
 class Database : public QObject
 {
@@ -28,7 +32,8 @@ public:
         explicit Error(const QString& what) : std::runtime_error(what.toStdString()) {}
     };
 
-    Database(QObject *parent);
+    // Opens the database at path, or at the "dbpath" setting if path is empty
+    Database(QObject *parent, const QString& path = {});
     ~Database();
 
     enum DsTable {
@@ -37,16 +42,127 @@ public:
 
     QSqlDatabase& getDb() { return db_; }
 
+    // Path to the database file, or ":memory:"
+    const QString& path() const noexcept { return path_; }
+
+    // Open a new, named connection to the database at path.
+    // Call it from the thread that will use the connection, and
+    // close it with QSqlDatabase::removeDatabase() when done.
+    // It waits up to workerBusyTimeout ms for a lock held by another
+    // connection.
+    static QSqlDatabase openConnection(const QString& name, const QString& path);
+
+    // Milliseconds the connections wait for a lock before they fail with
+    // "database is locked". The GUI connection should not hang for long.
+    static constexpr int busyTimeout = 5000;
+    static constexpr int workerBusyTimeout = 60000;
+
+    static Database& instance() {
+        Q_ASSERT(instance_);
+        return *instance_;
+    }
+
+    // Prepared statements for the applications database connection
+    StatementCache& statements() { return *statements_; }
+
+    // Shared id -> name lookup for contacts and persons
+    ContactNameCache& contactNames() { return *contact_names_; }
+
+    // Recently viewed per-contact detail rows
+    DetailCache& detailCache() { return *detail_cache_; }
+
+    // Run a cached, prepared statement with positional arguments
+    QSqlQuery& query(const QString& sql, const QVariantList& args = {}) {
+        return statements_->exec(sql, args);
+    }
+
+    // Run a cached, prepared statement and return the first value
+    QVariant scalar(const QString& sql, const QVariantList& args = {}) {
+        return statements_->scalar(sql, args);
+    }
+
+    // True if the full-text search index (sqlite FTS5) is available
+    bool hasSearchIndex() const noexcept { return has_search_index_; }
+
+    // Housekeeping: remove unreferenced blobs, merge the full-text
+    // search indexes and update the query planner statistics.
+    // VACUUM too, if vacuum is true. Don't call it inside a transaction.
+    bool optimize(const bool vacuum = false);
+
+    // Use the Transaction scope instead of calling these directly
+    bool beginTransaction();
+    bool commitTransaction();
+    void rollbackTransaction();
+
 signals:
+    // The outermost transaction was rolled back. Models holding rows
+    // written in it may be out of sync.
+    void rolledBack();
 
 public slots:
 
 protected:
     void createDatabase();
+    void upgradeDatabase(const int fromVersion);
+    void setVersion(const int version);
     void exec(const char *sql);
+    void exec(const QString& sql);
+    void prepareSearchIndex();
+    bool isFts5Available();
+
+    // Schema migrations. Each one takes the database from version - 1 to version.
+    void upgradeToVersion2();
+    void upgradeToVersion3();
+    void upgradeToVersion4();
+    void upgradeToVersion5();
+    void upgradeToVersion6();
+    void upgradeToVersion7();
+    void upgradeToVersion8();
+    void upgradeToVersion9();
+    void upgradeToVersion10();
+    void upgradeToVersion11();
+
+    static constexpr int currentVersion = 11;
+    QSqlDatabase db_;
+    QString path_;
+    std::unique_ptr<StatementCache> statements_;
+    std::unique_ptr<ContactNameCache> contact_names_;
+    std::unique_ptr<DetailCache> detail_cache_;
+    static Database *instance_;
+    int transaction_depth_ = 0;
+    bool rollback_only_ = false;
+    bool has_search_index_ = false;
+};
+
+// The database connection of a worker object (an importer and the like).
+//
+// It is opened with Database::openConnection() by the first open(), in
+// the thread that calls it, and removed with the object. An in-memory
+// database can not be shared with another connection, so then it is the
+// applications connection, and the worker must run in the main thread
+// (see WorkerHost).
+//
+// Declare it before the worker's QSqlQuery members, so they go first.
+class WorkerConnection
+{
+public:
+    // name is the prefix for the connection name, and for log messages
+    WorkerConnection(const QString& name, const QString& path);
+    ~WorkerConnection();
+
+    WorkerConnection(const WorkerConnection&) = delete;
+    WorkerConnection& operator = (const WorkerConnection&) = delete;
+
+    // Returns an invalid QSqlDatabase if it fails
+    QSqlDatabase open();
+
+    const QString& path() const noexcept { return path_; }
 
-    static constexpr int currentVersion = 1;
+private:
+    const QString name_;
+    const QString path_;
     QSqlDatabase db_;
+    bool own_connection_ = false;
 };
 
 
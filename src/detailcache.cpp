@@ -0,0 +1,177 @@
+#include "src/detailcache.h"
+
+#include <algorithm>
+
+#include <QSqlQueryModel>
+
+#include "src/database.h"
+
+RowSetResult::RowSetResult(const QSqlDriver *driver, RowSet rows)
+    : QSqlResult(driver)
+    , rows_{std::move(rows)}
+{
+    setSelect(true);
+    setActive(true);
+    setAt(QSql::BeforeFirstRow);
+}
+
+QVariant RowSetResult::data(int i)
+{
+    const auto& row = rows_.rows.at(at());
+    return i >= 0 && i < row.size() ? row.at(i) : QVariant{};
+}
+
+bool RowSetResult::isNull(int i)
+{
+    return data(i).isNull();
+}
+
+bool RowSetResult::reset(const QString &)
+{
+    return false; // We only have the rows we were given
+}
+
+bool RowSetResult::fetch(int i)
+{
+    if (i < 0 || i >= rows_.rows.size()) {
+        return false;
+    }
+    setAt(i);
+    return true;
+}
+
+bool RowSetResult::fetchFirst()
+{
+    return fetch(0);
+}
+
+bool RowSetResult::fetchLast()
+{
+    return fetch(rows_.rows.size() - 1);
+}
+
+int RowSetResult::size()
+{
+    return rows_.rows.size();
+}
+
+int RowSetResult::numRowsAffected()
+{
+    return 0;
+}
+
+QSqlRecord RowSetResult::record() const
+{
+    return rows_.record;
+}
+
+
+QSqlQuery DetailCache::get(const int contact, const QString &statement, const QSqlDriver *driver)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(), [contact](const Entry& e) {
+        return e.contact == contact;
+    });
+
+    if (it == entries_.end()) {
+        return {};
+    }
+
+    const auto rows = it->rowsets.find(statement);
+    if (rows == it->rowsets.end()) {
+        return {};
+    }
+
+    entries_.splice(entries_.begin(), entries_, it);
+    return QSqlQuery(new RowSetResult(driver, rows.value()));
+}
+
+void DetailCache::put(const int contact, const QString &statement, RowSet rows)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(), [contact](const Entry& e) {
+        return e.contact == contact;
+    });
+
+    if (it == entries_.end()) {
+        entries_.emplace_front();
+        entries_.front().contact = contact;
+        if (entries_.size() > static_cast<size_t>(maxContacts)) {
+            entries_.pop_back();
+        }
+    } else {
+        entries_.splice(entries_.begin(), entries_, it);
+    }
+
+    entries_.front().rowsets.insert(statement, std::move(rows));
+}
+
+void DetailCache::invalidate(const int contact)
+{
+    entries_.remove_if([contact](const Entry& e) {
+        return e.contact == contact;
+    });
+}
+
+void DetailCache::clear()
+{
+    entries_.clear();
+}
+
+
+DetailCacheClient::DetailCacheClient(QSqlQueryModel &model)
+    : model_{model}
+{
+    auto changed = [this] {
+        patched_ = true;
+        if (contact_ > 0) {
+            Database::instance().detailCache().invalidate(contact_);
+        }
+    };
+
+    QObject::connect(&model_, &QAbstractItemModel::dataChanged, &model_, changed);
+    QObject::connect(&model_, &QAbstractItemModel::rowsInserted, &model_, changed);
+    QObject::connect(&model_, &QAbstractItemModel::rowsRemoved, &model_, changed);
+
+    // Rows removed with OnManualSubmit are just marked until submitAll()
+    QObject::connect(&model_, &QAbstractItemModel::headerDataChanged, &model_, changed);
+}
+
+bool DetailCacheClient::select(const QString &statement, const std::function<bool ()> &load)
+{
+    if (contact_ > 0 && !patched_) {
+        auto query = Database::instance().detailCache().get(
+                    contact_, statement, QSqlDatabase::database().driver());
+        if (query.isActive()) {
+            // QSqlTableModel hides setQuery(), as it is not meant to be used
+            // from outside. We give it the same kind of rows select() would.
+            model_.QSqlQueryModel::setQuery(query);
+            return true;
+        }
+    }
+
+    if (!load()) {
+        return false;
+    }
+
+    patched_ = false;
+
+    // Only complete row sets. Large ones are not worth holding on to.
+    if (contact_ <= 0 || !model_.query().isActive() || model_.canFetchMore()) {
+        return true;
+    }
+
+    RowSet rows;
+    rows.record = model_.query().record();
+    rows.rows.reserve(model_.rowCount());
+    for(int row = 0; row < model_.rowCount(); ++row) {
+        const auto rec = model_.QSqlQueryModel::record(row);
+        QVector<QVariant> values;
+        values.reserve(rec.count());
+        for(int col = 0; col < rec.count(); ++col) {
+            values << rec.value(col);
+        }
+        rows.rows << values;
+    }
+
+    Database::instance().detailCache().put(contact_, statement, std::move(rows));
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef DETAILCACHE_H
+#define DETAILCACHE_H
+
+#include <functional>
+#include <list>
+
+#include <QHash>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlResult>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+class QSqlQueryModel;
+
+// The rows from one select, copied out of the database
+struct RowSet
+{
+    QSqlRecord record;
+    QVector<QVector<QVariant>> rows;
+};
+
+// Read-only result over a RowSet, so a QSqlQueryModel can be given
+// cached rows with setQuery() as if they came from the database.
+class RowSetResult : public QSqlResult
+{
+public:
+    RowSetResult(const QSqlDriver *driver, RowSet rows);
+
+protected:
+    QVariant data(int i) override;
+    bool isNull(int i) override;
+    bool reset(const QString& query) override;
+    bool fetch(int i) override;
+    bool fetchFirst() override;
+    bool fetchLast() override;
+    int size() override;
+    int numRowsAffected() override;
+    QSqlRecord record() const override;
+
+private:
+    const RowSet rows_;
+};
+
+// Recently used detail row sets (intents, actions, documents, journal,
+// channels, upcoming actions), grouped by the contact they belong to.
+//
+// Only the last few contacts are kept. Switching back to one of them
+// gives the models their rows without querying the database.
+// Entries are keyed by the select statement (or some other string that
+// identifies the rows), so a different filter or sort order is just a miss. A contact's entries are dropped when
+// anything about it changes (see DetailCacheClient and JournalModel),
+// and everything is dropped when a transaction is rolled back.
+//
+// Only use this from the thread that owns the applications database connection.
+class DetailCache
+{
+public:
+    static constexpr int maxContacts = 8;
+
+    // Returns an inactive query on a miss
+    QSqlQuery get(const int contact, const QString& statement, const QSqlDriver *driver);
+    void put(const int contact, const QString& statement, RowSet rows);
+
+    void invalidate(const int contact);
+    void clear();
+
+private:
+    struct Entry {
+        int contact = 0;
+        QHash<QString, RowSet> rowsets;
+    };
+
+    // Most recently used first
+    std::list<Entry> entries_;
+};
+
+// Connects a model that shows the details for one contact to the DetailCache.
+//
+// The model routes its select() through select() here. Any change in the
+// model (an edit, insert or remove) invalidates the cached rows for its contact.
+class DetailCacheClient
+{
+public:
+    explicit DetailCacheClient(QSqlQueryModel& model);
+
+    void setContact(const int contact) {
+        contact_ = contact;
+    }
+
+    // Give the model the cached rows for statement, or call load() to
+    // select them from the database and remember them.
+    bool select(const QString& statement, const std::function<bool ()>& load);
+
+private:
+    QSqlQueryModel& model_;
+    int contact_ = -1;
+
+    // QSqlTableModel keeps rows it has re-read with selectRow() on the side
+    // until the next real select(), so they would shadow cached rows.
+    bool patched_ = false;
+};
+
+#endif // DETAILCACHE_H
@@ -1,6 +1,8 @@
 #include "src/document.h"
 
 #include <QDesktopServices>
+#include <QDir>
+#include <QFileInfo>
 #include <QProcess>
 #include <QSettings>
 #include <QUrl>
@@ -223,13 +225,54 @@ const Document::entity_enums_t &Document::entityEnums()
     return enums;
 }
 
+/////////// File state //////////
+
+const QIcon &Document::fileStateIcon(const int value)
+{
+    static const QIcon none;
+    static const array<QIcon, 3> icons {{
+        none,
+        QIcon(":/res/icons/state_failed.svg"),
+        QIcon(":/res/icons/edit_document.svg"),
+    }};
+
+    if (value < 0 || static_cast<size_t>(value) >= icons.size()) {
+        return none;
+    }
+    return icons.at(static_cast<size_t>(value));
+}
+
+QString Document::fileStateDescription(const int value)
+{
+    switch(static_cast<FileState>(value)) {
+    case FileState::MISSING:
+        return QStringLiteral("The file is missing. It may have been moved or deleted.");
+    case FileState::CHANGED:
+        return QStringLiteral("The file has changed since it was added.");
+    default:
+        return {};
+    }
+}
+
+QString Document::localPath(const QString &location)
+{
+    const QUrl url{location};
+    if (url.isLocalFile()) {
+        return url.toLocalFile();
+    }
+    if (url.scheme().isEmpty() && QDir::isAbsolutePath(location)) {
+        return location;
+    }
+    return {};
+}
+
 void Document::open(Document::Type type, QString value)
 {
     if (type == Document::Type::FILE || type == Document::Type::EMAIL) {
 
         QSettings settings;
         const auto mailapp = settings.value("mailapp", "").toString();
-        if (value.startsWith("imap:") && !mailapp.isEmpty()) {
+        if ((value.startsWith("imap:") || value.startsWith("mid:")) && !mailapp.isEmpty()) {
             QProcess::startDetached(mailapp, {value});
         } else {
             Document::openFile(value);
@@ -245,6 +288,12 @@ void Document::openFile(QString path)
         return;
     }
 
+    const auto local = localPath(path);
+    if (!local.isEmpty() && !QFileInfo::exists(local)) {
+        qWarning() << "The file " << local << " does not exist. It may have been moved or deleted.";
+        return;
+    }
+
     if (!path.startsWith("file://")) {
         path = QStringLiteral("file://%1").arg(path);
     }
@@ -270,7 +319,7 @@ Document::Type Document::deduceType(const QUrl &url)
     const auto scheme = url.scheme();
     if (scheme.isEmpty())
         return Type::NOTE;
-    if (scheme == "imap" || scheme == "mailto")
+    if (scheme == "imap" || scheme == "mailto" || scheme == "mid")
         return Type::EMAIL;
     if (scheme == "file")
         return Type::FILE;
@@ -80,6 +80,21 @@ struct Document
     static const QString& entityName(const int value);
     static const entity_enums_t& entityEnums();
 
+    // What the FileMonitor found the last time it checked a FILE document
+    enum class FileState
+    {
+        OK,
+        MISSING,
+        CHANGED // The content is not what it was when the document was added
+    };
+
+    static const QIcon& fileStateIcon(const int value);
+    static QString fileStateDescription(const int value);
+
+    // The local path for a FILE documents location ("file://..." or a
+    // path), or an empty string if it is not a local file.
+    static QString localPath(const QString& location);
+
     static void open(Type type, QString value);
     static void openFile(QString path);
     static void openUrl(QString url);
@@ -130,12 +130,9 @@ void DocumentDialog::fetchContacts(int contactId, QComboBox *combo)
 {
     combo->clear();
 
-    QSqlQuery query(
-                QStringLiteral("select id, name from contact where id = %1 order by name")
-                .arg(contactId));
-
-    while(query.next()) {
-        combo->addItem(query.value(1).toString(), query.value(0).toInt());
+    const auto name = Database::instance().contactNames().name(contactId);
+    if (!name.isNull()) {
+        combo->addItem(name, contactId);
     }
 }
 
@@ -143,9 +140,9 @@ void DocumentDialog::fetchPersons(int contactId, QComboBox *combo)
 {
     combo->clear();
 
-    QSqlQuery query(
-                QStringLiteral("select id, name from contact where contact = %1 order by name")
-                .arg(contactId));
+    auto& query = Database::instance().query(
+                QStringLiteral("select id, name from contact where contact = ? order by name"),
+                {contactId});
 
     while(query.next()) {
         combo->addItem(query.value(1).toString(), query.value(0).toInt());
@@ -156,9 +153,9 @@ void DocumentDialog::fetchIntents(int contactId, QComboBox *combo)
 {
     combo->clear();
 
-    QSqlQuery query(
-                QStringLiteral("select id, abstract from intent where contact = %1 order by abstract")
-                .arg(contactId));
+    auto& query = Database::instance().query(
+                QStringLiteral("select id, abstract from intent where contact = ? order by abstract"),
+                {contactId});
 
     while(query.next()) {
         combo->addItem(query.value(1).toString(), query.value(0).toInt());
@@ -169,9 +166,9 @@ void DocumentDialog::fetchActions(int contactId, QComboBox *combo)
 {
     combo->clear();
 
-    QSqlQuery query(
-                QStringLiteral("select id, name from action where contact = %1 order by name")
-                .arg(contactId));
+    auto& query = Database::instance().query(
+                QStringLiteral("select id, name from action where contact = ? order by name"),
+                {contactId});
 
     while(query.next()) {
         combo->addItem(query.value(1).toString(), query.value(0).toInt());
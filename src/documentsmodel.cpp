@@ -13,6 +13,8 @@
 #include "src/intent.h"
 #include "document.h"
 #include "journalmodel.h"
+#include "transaction.h"
+#include "blobstore.h"
 
 using namespace std;
 
@@ -39,6 +41,11 @@ DocumentsModel::DocumentsModel(QSettings &settings, QObject *parent, QSqlDatabas
     h_file_date_ = fieldIndex("file_date");
     h_location_ = fieldIndex("location");
     h_content_ = fieldIndex("content");
+    h_content_hash_ = fieldIndex("content_hash");
+    h_file_size_ = fieldIndex("file_size");
+    h_file_hash_ = fieldIndex("file_hash");
+    h_file_mtime_ = fieldIndex("file_mtime");
+    h_file_state_ = fieldIndex("file_state");
 
     Q_ASSERT(h_id_ >= 0
              && h_contact_ > 0
@@ -55,6 +62,11 @@ DocumentsModel::DocumentsModel(QSettings &settings, QObject *parent, QSqlDatabas
              && h_file_date_ > 0
              && h_location_ > 0
              && h_content_ > 0
+             && h_content_hash_ > 0
+             && h_file_size_ > 0
+             && h_file_hash_ > 0
+             && h_file_mtime_ > 0
+             && h_file_state_ > 0
              );
 
 
@@ -64,8 +76,13 @@ DocumentsModel::DocumentsModel(QSettings &settings, QObject *parent, QSqlDatabas
 
 void DocumentsModel::setContact(int id)
 {
+    cache_.setContact(id);
+
+    // setFilter() selects by itself once the model has rows
     setFilter(QStringLiteral("contact = %1").arg(id));
-    select();
+    if (!query().isActive()) {
+        select();
+    }
 }
 
 QSqlRecord DocumentsModel::getRecord(int contact,
@@ -100,6 +117,7 @@ QSqlRecord DocumentsModel::getRecord(int contact,
 void DocumentsModel::removeDocuments(const QModelIndexList &indexes)
 {
     Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
 
     set<int> rows;
     for(const auto& ix : indexes) {
@@ -113,75 +131,86 @@ void DocumentsModel::removeDocuments(const QModelIndexList &indexes)
                        << lastError().text();
         }
 
-        JournalModel::instance().addEntry(JournalModel::Type::DELETED_DOCUMENT,
+        if (!JournalModel::instance().addEntry(JournalModel::Type::DELETED_DOCUMENT,
                                     QStringLiteral("Deleted document: %1")
                                     .arg(rec.value("name").toString()),
                                     rec.value("contact").toInt(),
                                     rec.value("person").toInt(),
                                     rec.value("intent").toInt(),
                                     rec.value("action").toInt(),
-                                    rec.value("id").toInt());
+                                    rec.value("id").toInt())) {
+            return; // Rolled back
+        }
     }
 
     if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
+        qWarning() << "Failed to remove documents (submitAll): "
                    << lastError().text();
+        transaction.rollback();
+        select();
+        return;
     }
+
+    transaction.commit();
 }
 
 void DocumentsModel::addDocument(const QSqlRecord &origRec)
 {
     QSqlRecord rec = origRec;
     fix(rec);
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
-    if (!insertRecord(-1, rec)) {
-        qWarning() << "Failed to add new document (insertRecord): "
-                   << lastError().text();
-        return;
-    }
+    Transaction transaction;
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new document (submitAll): "
+    // Sorted by the date added, so the new document belongs at the end
+    rec.setGenerated(h_id_, false);
+    const auto row = rowCount();
+    if (!insertRecord(row, rec)) {
+        qWarning() << "Failed to add new document (insertRecord): "
                    << lastError().text();
         return;
     }
 
     qDebug() << "Created new document";
 
-    JournalModel::instance().addEntry(JournalModel::Type::ADD_DOCUMENT,
+    if (!JournalModel::instance().addEntry(JournalModel::Type::ADD_DOCUMENT,
                                 QStringLiteral("Added document: %1").arg(origRec.value("name").toString()),
                                 origRec.value("contact").toInt(),
                                 origRec.value("person").toInt(),
                                 origRec.value("intent").toInt(),
                                 origRec.value("action").toInt(),
-                                query().lastInsertId().toInt());
+                                data(index(row, h_id_, {}), Qt::DisplayRole).toInt())
+            || !transaction.commit()) {
+        transaction.rollback();
+        select(); // Drop the row we inserted
+    }
 }
 
 void DocumentsModel::updateDocument(const int row, const QSqlRecord &rec)
 {
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
+
+    Transaction transaction;
 
+    // Updates the row and re-reads just this row
     if (!setRecord(row, rec)) {
         qWarning() << "Failed to update document (setRecord): "
                    << lastError().text();
         return;
     }
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new document (submitAll): "
-                   << lastError().text();
-        return;
-    }
-
-    JournalModel::instance().addEntry(JournalModel::Type::UPDATED_DOCUMENT,
+    if (!JournalModel::instance().addEntry(JournalModel::Type::UPDATED_DOCUMENT,
                                 QStringLiteral("Updated document: %1")
                                 .arg(rec.value("name").toString()),
                                 rec.value("contact").toInt(),
                                 rec.value("person").toInt(),
                                 rec.value("intent").toInt(),
                                 rec.value("action").toInt(),
-                                rec.value("id").toInt());
+                                rec.value("id").toInt())
+            || !transaction.commit()) {
+        transaction.rollback();
+        selectRow(row);
+    }
 }
 
 
@@ -236,6 +265,22 @@ QVariant DocumentsModel::data(const QModelIndex &ix, int role) const
             if (ix.column() == h_entity_) {
                 return Document::entityIcon(std::max(0, QSqlTableModel::data(ix, Qt::DisplayRole).toInt()));
             }
+
+            // Set by the FileMonitor
+            if (ix.column() == h_name_ || ix.column() == h_file_state_) {
+                return Document::fileStateIcon(QSqlTableModel::data(
+                                                   index(ix.row(), h_file_state_, {}),
+                                                   Qt::DisplayRole).toInt());
+            }
+        } else if (role == Qt::ToolTipRole) {
+            if (ix.column() == h_name_ || ix.column() == h_file_state_) {
+                const auto text = Document::fileStateDescription(QSqlTableModel::data(
+                                                                     index(ix.row(), h_file_state_, {}),
+                                                                     Qt::DisplayRole).toInt());
+                if (!text.isEmpty()) {
+                    return text;
+                }
+            }
         }
     }
 
@@ -263,9 +308,94 @@ bool DocumentsModel::updateRowInTable(int row, const QSqlRecord &values)
     QSqlRecord rec{values};
     fix(rec);
 
+    // We never have the real content in the model. Don't overwrite it with NULL.
+    // The content hash is owned by setContent().
+    rec.setGenerated(h_content_, false);
+    rec.setGenerated(h_content_hash_, false);
+
+    // A new location is another file. Forget what the file monitor knew
+    // about the old one, so that it hashes the new one at its next sweep.
+    if (rec.isGenerated(h_location_)) {
+        const auto old_location = Database::instance().scalar(
+                    QStringLiteral("select location from document where id = ?"),
+                    {rec.value(h_id_)});
+        if (old_location.toString() != rec.value(h_location_).toString()) {
+            for(const auto col : {h_file_size_, h_file_hash_, h_file_mtime_}) {
+                rec.setNull(col);
+                rec.setGenerated(col, true);
+            }
+            rec.setValue(h_file_state_, static_cast<int>(Document::FileState::OK));
+            rec.setGenerated(h_file_state_, true);
+        }
+    }
+
     return QSqlTableModel::updateRowInTable(row, rec);
 }
 
+QString DocumentsModel::selectStatement() const
+{
+    // Project NULL instead of the content BLOB, so listing a contacts
+    // documents don't load all the attachments into memory.
+    // This is also used by selectRow().
+    auto sql = QSqlTableModel::selectStatement();
+
+    const auto field = database().driver()->escapeIdentifier(
+                QStringLiteral("content"), QSqlDriver::FieldName);
+    const auto from = sql.indexOf(QStringLiteral(" FROM "), 0, Qt::CaseInsensitive);
+    const auto col = sql.lastIndexOf(field, from);
+    if (from > 0 && col > 0) {
+        sql.replace(col, field.size(), QStringLiteral("NULL AS %1").arg(field));
+    } else {
+        qWarning() << "DocumentsModel: Unexpected select statement: " << sql;
+    }
+
+    return sql;
+}
+
+bool DocumentsModel::hasContent(const int id)
+{
+    return Database::instance().scalar(
+                QStringLiteral("select content_hash is not null or content is not null "
+                               "from document where id = ?"), {id}).toBool();
+}
+
+bool DocumentsModel::getContent(const int id, QIODevice &out)
+{
+    auto& db = Database::instance();
+    const auto hash = db.scalar(
+                QStringLiteral("select content_hash from document where id = ?"),
+                {id}).toString();
+
+    if (hash.isEmpty()) {
+        // Not moved to the blob store (yet)
+        const auto content = db.scalar(
+                    QStringLiteral("select content from document where id = ?"),
+                    {id}).toByteArray();
+        return out.write(content) == content.size();
+    }
+
+    return BlobStore(db.getDb()).read(hash, out);
+}
+
+bool DocumentsModel::setContent(const int id, QIODevice &content)
+{
+    Transaction transaction;
+
+    const auto hash = BlobStore(Database::instance().getDb()).write(content);
+    if (hash.isEmpty()) {
+        return false;
+    }
+
+    // The triggers on document adjust the reference counts
+    if (!Database::instance().query(
+                QStringLiteral("update document set content_hash = ?, content = NULL where id = ?"),
+                {hash, id}).isActive()) {
+        return false;
+    }
+
+    return transaction.commit();
+}
+
 void DocumentsModel::fix(QSqlRecord &rec)
 {
     if (rec.value("person").toInt() <= 0) {
@@ -289,3 +419,9 @@ void DocumentsModel::fix(QSqlRecord &rec)
     }
 }
 
+bool DocumentsModel::select()
+{
+    return cache_.select(selectStatement(), [this] {
+        return QSqlTableModel::select();
+    });
+}
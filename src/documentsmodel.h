@@ -36,9 +36,20 @@ public:
     DEF_COLUMN(file_date)
     DEF_COLUMN(location)
     DEF_COLUMN(content)
+    DEF_COLUMN(file_size)
+    DEF_COLUMN(file_hash)
+    DEF_COLUMN(file_mtime)
+    DEF_COLUMN(file_state)
 
     void setContact(int id);
 
+    // The content is not loaded with the rows. Use these to access it.
+    // It is a copy of the document kept in the database (the blob store),
+    // for when the file is gone.
+    static bool hasContent(const int id);
+    static bool getContent(const int id, QIODevice& out);
+    static bool setContent(const int id, QIODevice& content);
+
     // Get a record with default values
     QSqlRecord getRecord(int contact, Document::Type type,
                          Document::Class cls, Document::Direction direction,
@@ -55,6 +66,7 @@ private:
 
 
     QSettings& settings_;
+    DetailCacheClient cache_{*this};
 
     int h_id_ = {};
     int h_contact_ = {};
@@ -71,6 +83,11 @@ private:
     int h_file_date_ = {};
     int h_location_ = {};
     int h_content_ = {};
+    int h_content_hash_ = {};
+    int h_file_size_ = {};
+    int h_file_hash_ = {};
+    int h_file_mtime_ = {};
+    int h_file_state_ = {};
 
     // QAbstractItemModel interface
 public:
@@ -78,8 +95,11 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
     // QSqlTableModel interface
+public slots:
+    bool select() override;
 protected:
     bool updateRowInTable(int row, const QSqlRecord &values) override;
+    QString selectStatement() const override;
 };
 
 
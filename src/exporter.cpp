@@ -0,0 +1,569 @@
+#include "src/exporter.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QTextStream>
+
+#include "src/database.h"
+#include "src/blobstore.h"
+#include "src/channel.h"
+#include "src/contact.h"
+
+using namespace std;
+
+namespace {
+
+const QStringList tables{"contact", "channel", "intent", "action", "document", "journal"};
+const QString watermark_file = QStringLiteral("export-watermark.json");
+
+// Check for cancel this often, in rows
+constexpr int check_every = 1000;
+
+// The journal columns that refer to rows in table
+QStringList journalColumns(const QString& table)
+{
+    if (table == "contact") return {"contact", "person"};
+    if (table == "channel") return {"channel"};
+    if (table == "intent") return {"intent"};
+    if (table == "action") return {"activity"};
+    if (table == "document") return {"document"};
+    return {};
+}
+
+QString toText(const QVariant& value)
+{
+    if (value.type() == QVariant::ByteArray) {
+        return QString::fromLatin1(value.toByteArray().toBase64());
+    }
+    return value.toString();
+}
+
+QString csvField(const QVariant& value)
+{
+    if (value.isNull()) {
+        return {};
+    }
+
+    auto text = toText(value);
+    if (text.contains(',') || text.contains('"') || text.contains('\n') || text.contains('\r')) {
+        text.replace('"', QStringLiteral("\"\""));
+        return QStringLiteral("\"%1\"").arg(text);
+    }
+    return text;
+}
+
+QJsonValue jsonValue(const QVariant& value)
+{
+    if (value.isNull()) {
+        return QJsonValue::Null;
+    }
+
+    switch(value.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+        return value.toDouble();
+    default:
+        return toText(value);
+    }
+}
+
+QString vcardEscape(QString text)
+{
+    text.replace('\\', QStringLiteral("\\\\"));
+    text.replace(',', QStringLiteral("\\,"));
+    text.replace(';', QStringLiteral("\\;"));
+    text.replace(QStringLiteral("\r\n"), QStringLiteral("\\n"));
+    text.replace('\n', QStringLiteral("\\n"));
+    return text;
+}
+
+// Lines longer than 75 characters are folded (RFC 6350, 3.2)
+void vcardLine(QTextStream& out, const QString& line)
+{
+    constexpr int max_len = 75;
+    out << line.left(max_len) << "\r\n";
+    for(int pos = max_len; pos < line.size(); pos += max_len - 1) {
+        out << ' ' << line.mid(pos, max_len - 1) << "\r\n";
+    }
+}
+
+} // anonymous namespace
+
+Exporter::Exporter(QSqlDatabase db, Exporter::Options options)
+    : db_{std::move(db)}, options_{std::move(options)}
+{
+}
+
+bool Exporter::toFormat(const QString &name, Exporter::Format &format)
+{
+    const auto lower = name.toLower();
+    if (lower == "csv") {
+        format = Format::CSV;
+    } else if (lower == "jsonl" || lower == "json") {
+        format = Format::JSONL;
+    } else if (lower == "vcard" || lower == "vcf") {
+        format = Format::VCARD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::run(const std::atomic_bool *cancelled)
+{
+    cancelled_ = cancelled;
+    files_.clear();
+    rows_ = 0;
+
+    dir_ = QDir(options_.directory);
+    if (!dir_.exists() && !dir_.mkpath(".")) {
+        error_ = QStringLiteral("Failed to create %1").arg(options_.directory);
+        return false;
+    }
+
+    watermarks_.clear();
+    if (options_.incremental && !loadWatermarks()) {
+        return false;
+    }
+
+    stamp_ = QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss");
+
+    // Read everything from one snapshot of the database
+    if (!db_.transaction()) {
+        error_ = QStringLiteral("Failed to start transaction: %1").arg(db_.lastError().text());
+        return false;
+    }
+
+    QHash<QString, qint64> marks;
+    for(const auto& table : tables) {
+        QSqlQuery query(db_);
+        if (!query.exec(QStringLiteral("SELECT max(id) FROM %1").arg(table)) || !query.next()) {
+            error_ = QStringLiteral("Failed to query %1: %2").arg(table, query.lastError().text());
+            db_.rollback();
+            return false;
+        }
+        marks[table] = query.value(0).toLongLong();
+    }
+
+    bool ok = true;
+    if (options_.format == Format::VCARD) {
+        ok = exportVCards();
+    } else {
+        for(const auto& table : tables) {
+            if (!(ok = exportTable(table))) {
+                break;
+            }
+        }
+    }
+
+    if (ok && options_.content) {
+        ok = exportContent();
+    }
+
+    // We only read
+    db_.rollback();
+
+    if (ok) {
+        ok = saveWatermarks(marks);
+    }
+
+    qDebug() << "Export: Wrote " << rows_ << " rows to " << files_.size() << " files in " << options_.directory;
+    return ok;
+}
+
+QString Exporter::where(const QString& table, const QString& alias, QVariantList &args) const
+{
+    if (!watermarks_.contains(table)) {
+        return {};
+    }
+
+    const auto prefix = alias.isEmpty() ? QString{} : alias + '.';
+
+    // New rows, and the rows that have been journaled since the last export
+    QStringList conditions{QStringLiteral("%1id > ?").arg(prefix)};
+    args << watermarks_.value(table);
+
+    for(const auto& column : journalColumns(table)) {
+        conditions << QStringLiteral("%1id IN (SELECT %2 FROM journal WHERE id > ? AND %2 IS NOT NULL)")
+                      .arg(prefix, column);
+        args << watermarks_.value("journal");
+    }
+
+    return QStringLiteral("(%1)").arg(conditions.join(" OR "));
+}
+
+bool Exporter::exportTable(const QString &table)
+{
+    // The document content is not in the document table any more, but in the blob store.
+    // channel.norm is derived from the value, for our own lookups.
+    QStringList columns;
+    const auto rec = db_.record(table);
+    for(int i = 0; i < rec.count(); ++i) {
+        if ((table == "document" && rec.fieldName(i) == "content")
+                || (table == "channel" && rec.fieldName(i) == "norm")) {
+            continue;
+        }
+        columns << rec.fieldName(i);
+    }
+
+    QVariantList args;
+    const auto condition = where(table, {}, args);
+    const auto sql = QStringLiteral("SELECT %1 FROM %2%3 ORDER BY id")
+            .arg(columns.join(", "), table, condition.isEmpty() ? QString{} : " WHERE " + condition);
+
+    QSqlQuery query(db_);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    for(const auto& arg : args) {
+        query.addBindValue(arg);
+    }
+
+    if (!query.exec()) {
+        error_ = QStringLiteral("Failed to query %1: %2").arg(table, query.lastError().text());
+        return false;
+    }
+
+    const bool csv = options_.format == Format::CSV;
+    const auto path = fileName(QStringLiteral("%1-%2.%3").arg(table, stamp_, csv ? "csv" : "jsonl"));
+
+    // Written to a temporary file and renamed in place by commit()
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error_ = QStringLiteral("Failed to create %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+
+    if (csv) {
+        out << columns.join(',') << '\n';
+    }
+
+    qint64 count = 0;
+    while(query.next()) {
+        if (cancelled(++count)) {
+            return false;
+        }
+
+        if (csv) {
+            for(int i = 0; i < columns.size(); ++i) {
+                if (i) {
+                    out << ',';
+                }
+                out << csvField(query.value(i));
+            }
+            out << '\n';
+        } else {
+            QJsonObject obj;
+            for(int i = 0; i < columns.size(); ++i) {
+                obj.insert(columns.at(i), jsonValue(query.value(i)));
+            }
+            out << QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)) << '\n';
+        }
+    }
+
+    out.flush();
+    if (!file.commit()) {
+        error_ = QStringLiteral("Failed to write %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    files_ << path;
+    rows_ += count;
+    return true;
+}
+
+bool Exporter::exportVCards()
+{
+    // Contacts and their channels are both ordered by the contact's id,
+    // and merged as we go.
+    QVariantList args;
+    auto condition = where("contact", "c", args);
+    if (!condition.isEmpty()) {
+        condition.prepend(" WHERE ");
+    }
+
+    QSqlQuery contacts(db_);
+    contacts.setForwardOnly(true);
+    contacts.prepare(QStringLiteral(
+                         "SELECT c.id, c.type, c.name, c.notes, c.address1, c.address2, c.postcode, "
+                         "c.city, c.region, c.state, c.country, p.name "
+                         "FROM contact AS c LEFT JOIN contact AS p ON p.id = c.contact%1 "
+                         "ORDER BY c.id").arg(condition));
+    for(const auto& arg : args) {
+        contacts.addBindValue(arg);
+    }
+
+    QSqlQuery channels(db_);
+    channels.setForwardOnly(true);
+    channels.prepare(QStringLiteral(
+                         "SELECT contact, type, value FROM channel "
+                         "WHERE contact IN (SELECT c.id FROM contact AS c%1) "
+                         "ORDER BY contact").arg(condition));
+    for(const auto& arg : args) {
+        channels.addBindValue(arg);
+    }
+
+    if (!contacts.exec() || !channels.exec()) {
+        error_ = QStringLiteral("Failed to query contacts: %1 %2")
+                .arg(contacts.lastError().text(), channels.lastError().text());
+        return false;
+    }
+
+    const auto path = fileName(QStringLiteral("contacts-%1.vcf").arg(stamp_));
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error_ = QStringLiteral("Failed to create %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+
+    bool have_channel = channels.next();
+    qint64 count = 0;
+    while(contacts.next()) {
+        if (cancelled(++count)) {
+            return false;
+        }
+
+        const auto id = contacts.value(0).toLongLong();
+        const bool company = contacts.value(1).toInt() == static_cast<int>(ContactType::CORPORATION);
+        const auto name = contacts.value(2).toString();
+
+        vcardLine(out, "BEGIN:VCARD");
+        vcardLine(out, "VERSION:4.0");
+        vcardLine(out, QStringLiteral("UID:urn:f-crm:contact:%1").arg(id));
+        vcardLine(out, company ? "KIND:org" : "KIND:individual");
+        vcardLine(out, "FN:" + vcardEscape(name));
+
+        const auto org = company ? name : contacts.value(11).toString();
+        if (!org.isEmpty()) {
+            vcardLine(out, "ORG:" + vcardEscape(org));
+        }
+
+        if (!contacts.value(3).toString().isEmpty()) {
+            vcardLine(out, "NOTE:" + vcardEscape(contacts.value(3).toString()));
+        }
+
+        // PO box; extended address; street; locality; region; postal code; country
+        const auto region = contacts.value(8).toString().isEmpty()
+                ? contacts.value(9).toString() : contacts.value(8).toString();
+        const QStringList adr{{}, vcardEscape(contacts.value(5).toString()),
+                    vcardEscape(contacts.value(4).toString()),
+                    vcardEscape(contacts.value(7).toString()),
+                    vcardEscape(region),
+                    vcardEscape(contacts.value(6).toString()),
+                    vcardEscape(contacts.value(10).toString())};
+        if (!adr.join(QString{}).isEmpty()) {
+            vcardLine(out, "ADR:" + adr.join(';'));
+        }
+
+        // Skip channels for contacts we don't export
+        while(have_channel && channels.value(0).toLongLong() < id) {
+            have_channel = channels.next();
+        }
+
+        while(have_channel && channels.value(0).toLongLong() == id) {
+            const auto value = vcardEscape(channels.value(2).toString());
+            switch(static_cast<ChannelType>(channels.value(1).toInt())) {
+            case ChannelType::EMAIL:
+                vcardLine(out, "EMAIL:" + value);
+                break;
+            case ChannelType::PHONE:
+                vcardLine(out, "TEL;TYPE=voice:" + value);
+                break;
+            case ChannelType::MOBILE:
+                vcardLine(out, "TEL;TYPE=cell:" + value);
+                break;
+            case ChannelType::SKYPE:
+                vcardLine(out, "IMPP:skype:" + value);
+                break;
+            case ChannelType::WEB:
+            case ChannelType::LINKEDIN:
+            case ChannelType::REDDIT:
+            case ChannelType::FACEBOOK:
+            case ChannelType::GITHUB:
+                vcardLine(out, "URL:" + value);
+                break;
+            default:
+                vcardLine(out, "X-F-CRM-CHANNEL:" + value);
+            }
+            have_channel = channels.next();
+        }
+
+        vcardLine(out, "END:VCARD");
+    }
+
+    out.flush();
+    if (!file.commit()) {
+        error_ = QStringLiteral("Failed to write %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    files_ << path;
+    rows_ += count;
+    return true;
+}
+
+bool Exporter::exportContent()
+{
+    QVariantList args;
+    const auto condition = where("document", {}, args);
+
+    QSqlQuery query(db_);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT DISTINCT content_hash FROM document WHERE content_hash IS NOT NULL%1")
+                  .arg(condition.isEmpty() ? QString{} : " AND " + condition));
+    for(const auto& arg : args) {
+        query.addBindValue(arg);
+    }
+
+    if (!query.exec()) {
+        error_ = QStringLiteral("Failed to query document content: %1").arg(query.lastError().text());
+        return false;
+    }
+
+    if (!dir_.mkpath("content")) {
+        error_ = QStringLiteral("Failed to create the content directory");
+        return false;
+    }
+
+    BlobStore blobs(db_);
+    qint64 count = 0;
+    while(query.next()) {
+        if (cancelled(++count)) {
+            return false;
+        }
+
+        // The name is the hash of the content, so if it's there, it's right
+        const auto hash = query.value(0).toString();
+        const auto path = dir_.filePath(QStringLiteral("content/%1").arg(hash));
+        if (QFile::exists(path)) {
+            continue;
+        }
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || !blobs.read(hash, file) || !file.commit()) {
+            error_ = QStringLiteral("Failed to write %1: %2").arg(path, file.errorString());
+            return false;
+        }
+        files_ << path;
+    }
+
+    return true;
+}
+
+bool Exporter::loadWatermarks()
+{
+    QFile file(dir_.filePath(watermark_file));
+    if (!file.exists()) {
+        return true; // First export to this directory. Export everything.
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        error_ = QStringLiteral("Failed to read %1: %2").arg(file.fileName(), file.errorString());
+        return false;
+    }
+
+    const auto obj = QJsonDocument::fromJson(file.readAll()).object();
+    for(const auto& table : tables) {
+        if (obj.contains(table)) {
+            watermarks_[table] = static_cast<qint64>(obj.value(table).toDouble());
+        }
+    }
+
+    // Without the journal mark we can't tell what changed
+    if (!watermarks_.contains("journal")) {
+        watermarks_.clear();
+    }
+
+    return true;
+}
+
+bool Exporter::saveWatermarks(const QHash<QString, qint64> &marks)
+{
+    QJsonObject obj;
+    for(auto it = marks.cbegin(); it != marks.cend(); ++it) {
+        obj.insert(it.key(), static_cast<double>(it.value()));
+    }
+    obj.insert("exported", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+
+    QSaveFile file(dir_.filePath(watermark_file));
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(QJsonDocument(obj).toJson()) < 0
+            || !file.commit()) {
+        error_ = QStringLiteral("Failed to write %1: %2").arg(file.fileName(), file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::cancelled(const qint64 row)
+{
+    if (cancelled_ && (row % check_every) == 0 && *cancelled_) {
+        error_ = QStringLiteral("Cancelled");
+        return true;
+    }
+    return false;
+}
+
+QString Exporter::fileName(const QString &name) const
+{
+    return dir_.filePath(name);
+}
+
+ExportWorker::ExportWorker(const QString &dbpath, Exporter::Options options,
+                           const std::atomic_bool &cancelled)
+    : connection_{QStringLiteral("export"), dbpath}
+    , options_{std::move(options)}
+    , cancelled_{cancelled}
+{
+}
+
+void ExportWorker::run()
+{
+    auto db = connection_.open();
+    if (!db.isValid()) {
+        emit finished(false, QStringLiteral("Failed to open the database"));
+        return;
+    }
+
+    Exporter exporter(db, options_);
+    const bool ok = exporter.run(&cancelled_);
+    emit finished(ok, ok ? QStringLiteral("Exported %1 rows to %2 files.")
+                           .arg(exporter.rows()).arg(exporter.files().size())
+                         : exporter.error());
+}
+
+ExportJob::ExportJob(Exporter::Options options, QObject *parent)
+    : QObject(parent)
+    , host_{new ExportWorker(Database::instance().path(), std::move(options), cancelled_)}
+{
+    connect(host_.worker(), &ExportWorker::finished, this, &ExportJob::finished);
+}
+
+ExportJob::~ExportJob()
+{
+    cancelled_ = true;
+}
+
+void ExportJob::start()
+{
+    cancelled_ = false;
+    const auto worker = host_.worker();
+    host_.post([worker] {
+        worker->run();
+    });
+}
@@ -0,0 +1,123 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <atomic>
+
+#include <QDir>
+#include <QHash>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+#include "database.h"
+#include "workerhost.h"
+
+// Writes the CRM data to files, for other systems to pick up.
+//
+// Each table (contact, channel, intent, action, document and journal) is
+// read with one forward-only query and written row by row, so memory use
+// does not depend on the size of the database. CSV and JSON Lines give one
+// file per table. vCard gives one file with the contacts and persons, and
+// their channels. All the tables are read in one transaction, so the files
+// are consistent with each other.
+//
+// An incremental export writes only the rows added since the last export
+// to the same directory, and the rows that have journal entries since then.
+// The high-water marks (the largest id in each table) are kept in
+// export-watermark.json in the directory. Deleted rows are not reported.
+class Exporter
+{
+public:
+    enum class Format {
+        CSV,
+        JSONL,
+        VCARD
+    };
+
+    struct Options {
+        Format format = Format::CSV;
+        QString directory;
+        bool incremental = false;
+
+        // Also write the document content, to content/<content_hash>
+        bool content = false;
+    };
+
+    Exporter(QSqlDatabase db, Options options);
+
+    // Returns false on failure or if cancelled. See error()
+    bool run(const std::atomic_bool *cancelled = nullptr);
+
+    const QString& error() const noexcept { return error_; }
+
+    // The files written, and the total number of rows in them
+    const QStringList& files() const noexcept { return files_; }
+    qint64 rows() const noexcept { return rows_; }
+
+    // "csv", "jsonl" or "vcard"
+    static bool toFormat(const QString& name, Format& format);
+
+private:
+    // The condition for an incremental export of table, or an empty string
+    QString where(const QString& table, const QString& alias, QVariantList& args) const;
+    bool exportTable(const QString& table);
+    bool exportVCards();
+    bool exportContent();
+    bool loadWatermarks();
+    bool saveWatermarks(const QHash<QString, qint64>& marks);
+    bool cancelled(const qint64 row);
+    QString fileName(const QString& name) const;
+
+    QSqlDatabase db_;
+    const Options options_;
+    const std::atomic_bool *cancelled_ = {};
+    QDir dir_;
+    QString stamp_;
+    QHash<QString, qint64> watermarks_;
+    QString error_;
+    QStringList files_;
+    qint64 rows_ = 0;
+};
+
+// Runs an Exporter on its own database connection.
+class ExportWorker : public QObject
+{
+    Q_OBJECT
+public:
+    ExportWorker(const QString& dbpath, Exporter::Options options,
+                 const std::atomic_bool& cancelled);
+
+public slots:
+    void run();
+
+signals:
+    void finished(bool ok, const QString& message);
+
+private:
+    WorkerConnection connection_;
+    const Exporter::Options options_;
+    const std::atomic_bool& cancelled_;
+};
+
+// Runs an Exporter on a worker thread
+class ExportJob : public QObject
+{
+    Q_OBJECT
+public:
+    ExportJob(Exporter::Options options, QObject *parent);
+    ~ExportJob();
+
+    void start();
+    void cancel() { cancelled_ = true; }
+
+signals:
+    void finished(bool ok, const QString& message);
+
+private:
+    std::atomic_bool cancelled_{false};
+    WorkerHost<ExportWorker> host_;
+};
+
+#endif // EXPORTER_H
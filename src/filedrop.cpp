@@ -0,0 +1,223 @@
+#include "src/filedrop.h"
+
+#include <ctime>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QUrl>
+#include <QVariantList>
+
+#include "src/database.h"
+#include "src/journalmodel.h"
+#include "src/utility.h"
+
+QString FileDropSummary::text() const
+{
+    auto text = QStringLiteral("Added %1 files (%2 MB).")
+            .arg(added).arg(static_cast<double>(bytes) / (1024 * 1024), 0, 'f', 1);
+    if (duplicates) {
+        text += QStringLiteral("\nSkipped %1 files that were already there.").arg(duplicates);
+    }
+    if (failed) {
+        text += QStringLiteral("\nFailed to read %1 files.").arg(failed);
+    }
+    return text;
+}
+
+FileDropWorker::FileDropWorker(const QString &dbpath, const FileDropTarget &target,
+                               const std::atomic_bool &cancelled)
+    : connection_{QStringLiteral("file-drop"), dbpath}, target_{target}, cancelled_{cancelled}
+{
+}
+
+void FileDropWorker::run(const QStringList &paths)
+{
+    FileDropSummary summary;
+
+    // Folders are added with everything in them
+    QStringList queue;
+    for(const auto& path : paths) {
+        const QFileInfo fi{path};
+        if (fi.isDir()) {
+            QDirIterator it(fi.absoluteFilePath(), QDir::Files | QDir::NoDotAndDotDot,
+                            QDirIterator::Subdirectories);
+            while(it.hasNext()) {
+                queue << it.next();
+            }
+        } else {
+            queue << fi.absoluteFilePath();
+        }
+    }
+
+    QList<File> files;
+    for(const auto& path : queue) {
+        if (cancelled_) {
+            summary.cancelled = true;
+            emit finished(summary);
+            return;
+        }
+
+        const QFileInfo fi{path};
+        File file;
+        file.path = path;
+        file.size = fi.size();
+        file.mtime = fi.lastModified().toTime_t();
+        file.hash = HashFile(path, &cancelled_);
+        if (file.hash.isEmpty()) {
+            if (!cancelled_) {
+                qWarning() << "Failed to read " << path;
+                ++summary.failed;
+            }
+        } else {
+            files << file;
+        }
+
+        emit progress(files.size() + summary.failed, queue.size());
+    }
+
+    if (cancelled_) {
+        summary.cancelled = true;
+    } else if (!open() || !add(files, summary)) {
+        summary.added = 0;
+        summary.bytes = 0;
+        summary.error = QStringLiteral("Failed to add the files");
+    }
+
+    emit finished(summary);
+}
+
+bool FileDropWorker::open()
+{
+    db_ = connection_.open();
+    return db_.isValid();
+}
+
+bool FileDropWorker::add(const QList<File> &files, FileDropSummary &summary)
+{
+    QSqlQuery known(db_);
+    QSqlQuery insert(db_);
+    if (!known.prepare(QStringLiteral("select 1 from document where contact = ? and file_hash = ? limit 1"))
+            || !insert.prepare(QStringLiteral(
+                "insert into document (contact, person, intent, activity, type, cls, direction, "
+                "entity, name, added_date, file_date, location, file_size, file_hash, file_mtime) "
+                "values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"))) {
+        qWarning() << "File drop: Failed to prepare statements: " << known.lastError().text()
+                   << insert.lastError().text();
+        return false;
+    }
+
+    const auto now = static_cast<uint>(time(nullptr));
+    QSet<QString> hashes;
+    QVariantList journal_contact, journal_person, journal_intent, journal_activity,
+            journal_document, journal_text;
+
+    db_.transaction();
+    for(const auto& file : files) {
+        if (hashes.contains(file.hash)) {
+            ++summary.duplicates;
+            continue;
+        }
+        hashes.insert(file.hash);
+
+        known.addBindValue(target_.contact);
+        known.addBindValue(file.hash);
+        if (!known.exec()) {
+            qWarning() << "File drop: Failed to look up " << file.path << ": " << known.lastError().text();
+            db_.rollback();
+            return false;
+        }
+        const bool duplicate = known.next();
+        known.finish();
+        if (duplicate) {
+            ++summary.duplicates;
+            continue;
+        }
+
+        const auto name = QFileInfo{file.path}.fileName();
+        insert.addBindValue(target_.contact);
+        insert.addBindValue(NullIfZero(target_.person));
+        insert.addBindValue(NullIfZero(target_.intent));
+        insert.addBindValue(NullIfZero(target_.action));
+        insert.addBindValue(static_cast<int>(Document::Type::FILE));
+        insert.addBindValue(static_cast<int>(Document::Class::NOTE));
+        insert.addBindValue(static_cast<int>(Document::Direction::INTERNAL));
+        insert.addBindValue(static_cast<int>(target_.entity));
+        insert.addBindValue(name);
+        insert.addBindValue(now);
+        insert.addBindValue(file.mtime);
+        insert.addBindValue(QUrl::fromLocalFile(file.path).toString());
+        insert.addBindValue(file.size);
+        insert.addBindValue(file.hash);
+        insert.addBindValue(file.mtime);
+        if (!insert.exec()) {
+            qWarning() << "File drop: Failed to add " << file.path << ": " << insert.lastError().text();
+            db_.rollback();
+            return false;
+        }
+
+        journal_contact << target_.contact;
+        journal_person << NullIfZero(target_.person);
+        journal_intent << NullIfZero(target_.intent);
+        journal_activity << NullIfZero(target_.action);
+        journal_document << insert.lastInsertId();
+        journal_text << QStringLiteral("Added document: %1").arg(name);
+
+        ++summary.added;
+        summary.bytes += file.size;
+    }
+
+    if (!journal_contact.isEmpty()) {
+        QSqlQuery journal(db_);
+        journal.prepare(QStringLiteral("insert into journal (type, date, contact, person, intent, activity, document, text) "
+                                       "values (%1, %2, ?, ?, ?, ?, ?, ?)")
+                        .arg(static_cast<int>(JournalModel::Type::ADD_DOCUMENT)).arg(now));
+        journal.addBindValue(journal_contact);
+        journal.addBindValue(journal_person);
+        journal.addBindValue(journal_intent);
+        journal.addBindValue(journal_activity);
+        journal.addBindValue(journal_document);
+        journal.addBindValue(journal_text);
+        if (!journal.execBatch()) {
+            qWarning() << "File drop: Failed to add journal entries: " << journal.lastError().text();
+            db_.rollback();
+            return false;
+        }
+    }
+
+    if (!db_.commit()) {
+        qWarning() << "File drop: Failed to commit: " << db_.lastError().text();
+        db_.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+FileDrop::FileDrop(const FileDropTarget &target, QObject *parent)
+    : QObject(parent)
+    , host_{new FileDropWorker(Database::instance().path(), target, cancelled_)}
+{
+    qRegisterMetaType<FileDropSummary>();
+
+    connect(host_.worker(), &FileDropWorker::progress, this, &FileDrop::progress);
+    connect(host_.worker(), &FileDropWorker::finished, this, &FileDrop::finished);
+}
+
+FileDrop::~FileDrop()
+{
+    cancelled_ = true;
+}
+
+void FileDrop::start(const QStringList &paths)
+{
+    cancelled_ = false;
+    const auto worker = host_.worker();
+    host_.post([worker, paths] {
+        worker->run(paths);
+    });
+}
@@ -0,0 +1,99 @@
+#ifndef FILEDROP_H
+#define FILEDROP_H
+
+#include <atomic>
+
+#include <QMetaType>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+#include "database.h"
+#include "document.h"
+#include "workerhost.h"
+
+// Where dropped files go
+struct FileDropTarget
+{
+    int contact = 0;
+    int person = 0;
+    int intent = 0;
+    int action = 0;
+    Document::Entity entity = Document::Entity::CONTACT;
+};
+
+// What a drop added to the database
+struct FileDropSummary
+{
+    int added = 0;
+    int duplicates = 0; // Files with the same content as a document the contact has
+    int failed = 0;     // Files that could not be read
+    qint64 bytes = 0;   // Size of the added files
+    bool cancelled = false;
+    QString error;
+
+    // For the user
+    QString text() const;
+};
+
+Q_DECLARE_METATYPE(FileDropSummary)
+
+// Stats and hashes the files on its own database connection, and adds them.
+class FileDropWorker : public QObject
+{
+    Q_OBJECT
+public:
+    FileDropWorker(const QString& dbpath, const FileDropTarget& target,
+                   const std::atomic_bool& cancelled);
+
+public slots:
+    void run(const QStringList& paths);
+
+signals:
+    void progress(int done, int total);
+    void finished(const FileDropSummary& summary);
+
+private:
+    struct File {
+        QString path;
+        qint64 size = 0;
+        uint mtime = 0;
+        QString hash;
+    };
+
+    bool open();
+    bool add(const QList<File>& files, FileDropSummary& summary);
+
+    WorkerConnection connection_;
+    const FileDropTarget target_;
+    const std::atomic_bool& cancelled_;
+    QSqlDatabase db_;
+};
+
+// Adds many dropped files (or folders of them) as FILE documents at once.
+//
+// The files are listed, stat'ed and hashed on a worker thread, and then
+// added with one transaction, with their file_date, file_size and
+// file_hash. Files with the same content as one of the contacts documents
+// are skipped. Nothing is added if it is cancelled.
+class FileDrop : public QObject
+{
+    Q_OBJECT
+public:
+    FileDrop(const FileDropTarget& target, QObject *parent);
+    ~FileDrop();
+
+    void start(const QStringList& paths);
+    void cancel() { cancelled_ = true; }
+
+signals:
+    void progress(int done, int total);
+    void finished(const FileDropSummary& summary);
+
+private:
+    std::atomic_bool cancelled_{false};
+    WorkerHost<FileDropWorker> host_;
+};
+
+#endif // FILEDROP_H
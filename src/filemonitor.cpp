@@ -0,0 +1,558 @@
+#include "src/filemonitor.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QUrl>
+#include <QVariantList>
+
+#include "src/database.h"
+#include "src/document.h"
+#include "src/journalmodel.h"
+#include "src/utility.h"
+
+namespace {
+
+QVariant nullIfNegative(const qint64 value)
+{
+    return value >= 0 ? QVariant{value} : QVariant{QVariant::LongLong};
+}
+
+// The nearest directory above path that still exists
+QString existingParent(const QString& path)
+{
+    auto dir = QFileInfo{path}.absolutePath();
+    while(!QFileInfo{dir}.isDir()) {
+        const auto parent = QFileInfo{dir}.absolutePath();
+        if (parent == dir) {
+            return {};
+        }
+        dir = parent;
+    }
+    return dir;
+}
+
+} // anonymous namespace
+
+FileMonitorWorker::FileMonitorWorker(const QString &dbpath, const int interval,
+                                     const std::atomic_bool &cancelled)
+    : connection_{QStringLiteral("file-monitor"), dbpath}, interval_{interval}, cancelled_{cancelled}
+{
+}
+
+void FileMonitorWorker::start()
+{
+    // Created here, so that they live in the worker thread
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    connect(timer_, &QTimer::timeout, this, &FileMonitorWorker::sweep);
+
+    changed_timer_ = new QTimer(this);
+    changed_timer_->setSingleShot(true);
+    changed_timer_->setInterval(changedDirDelay * 1000);
+    connect(changed_timer_, &QTimer::timeout, this, &FileMonitorWorker::checkChangedDirs);
+
+    watcher_ = new QFileSystemWatcher(this);
+    connect(watcher_, &QFileSystemWatcher::directoryChanged,
+            this, &FileMonitorWorker::onDirectoryChanged);
+
+    // Don't compete with the application while it starts up
+    timer_->start(firstSweepDelay * 1000);
+}
+
+void FileMonitorWorker::sweep()
+{
+    if (timer_) {
+        timer_->stop();
+    }
+
+    if (!open()) {
+        return;
+    }
+
+    QSqlQuery page(db_);
+    if (!page.prepare(QStringLiteral(
+                          "select id, contact, location, file_size, file_mtime, file_hash, file_state "
+                          "from document where type = ? and id > ? order by id limit ?"))) {
+        qWarning() << "File monitor: Failed to prepare statement: " << page.lastError().text();
+        return;
+    }
+
+    const auto started = QDateTime::currentMSecsSinceEpoch();
+    QSet<int> contacts;
+    QHash<QString, QList<int>> dirs;
+    int last = 0, checked = 0;
+    bool ok = true;
+
+    // Keyset paging, so that no query or transaction is held open while
+    // the files are read
+    while(!cancelled()) {
+        page.addBindValue(static_cast<int>(Document::Type::FILE));
+        page.addBindValue(last);
+        page.addBindValue(pageSize);
+        if (!page.exec()) {
+            qWarning() << "File monitor: Failed to query documents: " << page.lastError().text();
+            ok = false;
+            break;
+        }
+
+        QList<File> files;
+        while(page.next()) {
+            files << read(page);
+        }
+        page.finish();
+
+        for(auto& file : files) {
+            if (cancelled()) {
+                break;
+            }
+            last = file.id;
+            if (file.path.isEmpty()) {
+                continue;
+            }
+            dirs[QFileInfo{file.path}.absolutePath()] << file.id;
+            check(file);
+        }
+
+        if (!save(files, contacts)) {
+            ok = false;
+            break;
+        }
+
+        checked += files.size();
+        if (files.size() < pageSize) {
+            break;
+        }
+    }
+
+    if (ok && !cancelled()) {
+        relink({}, true, contacts);
+        watch(dirs);
+    }
+
+    qDebug() << "File monitor: Checked " << checked << " documents in "
+             << (QDateTime::currentMSecsSinceEpoch() - started) << " ms";
+
+    if (!contacts.isEmpty()) {
+        emit updated(contacts.values());
+    }
+
+    if (timer_ && !cancelled()) {
+        timer_->start(interval_ * 1000);
+    }
+}
+
+void FileMonitorWorker::onDirectoryChanged(const QString &path)
+{
+    // A copy or unpack fires this many times. Wait for it to settle.
+    changed_dirs_.insert(path);
+    changed_timer_->start();
+}
+
+void FileMonitorWorker::checkChangedDirs()
+{
+    if (cancelled() || !open()) {
+        return;
+    }
+
+    QSqlQuery query(db_);
+    if (!query.prepare(QStringLiteral(
+                           "select id, contact, location, file_size, file_mtime, file_hash, file_state "
+                           "from document where id = ?"))) {
+        qWarning() << "File monitor: Failed to prepare statement: " << query.lastError().text();
+        return;
+    }
+
+    QList<File> files;
+    QStringList roots;
+    for(const auto& dir : changed_dirs_) {
+        if (QFileInfo{dir}.isDir()) {
+            roots << dir;
+        }
+        for(const auto id : dirs_.value(dir)) {
+            query.addBindValue(id);
+            if (query.exec() && query.next()) {
+                files << read(query);
+            }
+            query.finish();
+        }
+    }
+    changed_dirs_.clear();
+
+    for(auto& file : files) {
+        if (cancelled()) {
+            return;
+        }
+        if (!file.path.isEmpty()) {
+            check(file);
+        }
+    }
+
+    QSet<int> contacts;
+    if (save(files, contacts) && !roots.isEmpty()) {
+        // A file moved between two watched directories turns up in one of them
+        relink(roots, false, contacts);
+    }
+
+    if (!contacts.isEmpty()) {
+        emit updated(contacts.values());
+    }
+}
+
+bool FileMonitorWorker::open()
+{
+    db_ = connection_.open();
+    return db_.isValid();
+}
+
+FileMonitorWorker::File FileMonitorWorker::read(const QSqlQuery &query) const
+{
+    File file;
+    file.id = query.value(0).toInt();
+    file.contact = query.value(1).toInt();
+    file.path = Document::localPath(query.value(2).toString());
+    file.size = query.value(3).isNull() ? -1 : query.value(3).toLongLong();
+    file.mtime = query.value(4).isNull() ? -1 : query.value(4).toLongLong();
+    file.hash = query.value(5).toString();
+    file.state = file.old_state = query.value(6).toInt();
+    return file;
+}
+
+void FileMonitorWorker::check(File &file)
+{
+    const QFileInfo fi{file.path};
+    if (!fi.isFile()) {
+        if (file.state != static_cast<int>(Document::FileState::MISSING)) {
+            file.state = static_cast<int>(Document::FileState::MISSING);
+            file.dirty = true;
+        }
+        return;
+    }
+
+    const qint64 size = fi.size();
+    const qint64 mtime = fi.lastModified().toTime_t();
+
+    // Changed and missing files are read every time, so that a file
+    // that is put back is found to be OK again.
+    if (file.state == static_cast<int>(Document::FileState::OK)
+            && size == file.size && mtime == file.mtime) {
+        return;
+    }
+
+    const auto hash = HashFile(file.path, &cancelled_);
+    if (hash.isEmpty()) {
+        if (!cancelled()) {
+            qWarning() << "File monitor: Failed to read " << file.path;
+        }
+        return;
+    }
+
+    // file_size and file_hash are what the file was when it was added
+    if (file.hash.isEmpty()) {
+        file.hash = hash;
+        file.size = size;
+    }
+
+    file.mtime = mtime;
+    file.state = static_cast<int>(hash == file.hash
+                                  ? Document::FileState::OK
+                                  : Document::FileState::CHANGED);
+    file.dirty = true;
+}
+
+bool FileMonitorWorker::save(const QList<File> &files, QSet<int> &contacts)
+{
+    const auto dirty = std::any_of(files.begin(), files.end(), [](const File& file) {
+        return file.dirty;
+    });
+    if (!dirty) {
+        return true;
+    }
+
+    QSqlQuery update(db_);
+    if (!update.prepare(QStringLiteral(
+                            "update document set file_size = ?, file_mtime = ?, file_hash = ?, file_state = ? "
+                            "where id = ?"))) {
+        qWarning() << "File monitor: Failed to prepare statement: " << update.lastError().text();
+        return false;
+    }
+
+    db_.transaction();
+    for(const auto& file : files) {
+        if (!file.dirty) {
+            continue;
+        }
+
+        update.addBindValue(nullIfNegative(file.size));
+        update.addBindValue(nullIfNegative(file.mtime));
+        update.addBindValue(file.hash.isEmpty() ? QVariant{QVariant::String} : QVariant{file.hash});
+        update.addBindValue(file.state);
+        update.addBindValue(file.id);
+        if (!update.exec()) {
+            qWarning() << "File monitor: Failed to update document " << file.id << ": "
+                       << update.lastError().text();
+            db_.rollback();
+            return false;
+        }
+
+        if (file.state != file.old_state) {
+            contacts.insert(file.contact);
+        }
+    }
+
+    if (!db_.commit()) {
+        qWarning() << "File monitor: Failed to commit: " << db_.lastError().text();
+        db_.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+bool FileMonitorWorker::relink(QStringList roots, const bool recursive, QSet<int> &contacts)
+{
+    struct Missing {
+        int id = 0;
+        int contact = 0;
+        int person = 0;
+        int intent = 0;
+        int activity = 0;
+        QString name;
+        QString hash;
+        QString path;   // Where it was found
+        qint64 mtime = 0;
+    };
+
+    QSqlQuery query(db_);
+    if (!query.exec(QStringLiteral(
+                        "select id, contact, person, intent, activity, name, location, file_size, file_hash "
+                        "from document where type = %1 and file_state = %2 and file_hash is not null")
+                    .arg(static_cast<int>(Document::Type::FILE))
+                    .arg(static_cast<int>(Document::FileState::MISSING)))) {
+        qWarning() << "File monitor: Failed to query missing documents: " << query.lastError().text();
+        return false;
+    }
+
+    const bool find_roots = roots.isEmpty();
+    QHash<qint64, QList<Missing>> by_size;
+    int left = 0;
+    while(query.next()) {
+        Missing doc;
+        doc.id = query.value(0).toInt();
+        doc.contact = query.value(1).toInt();
+        doc.person = query.value(2).toInt();
+        doc.intent = query.value(3).toInt();
+        doc.activity = query.value(4).toInt();
+        doc.name = query.value(5).toString();
+        doc.hash = query.value(8).toString();
+        by_size[query.value(7).toLongLong()] << doc;
+        ++left;
+
+        if (find_roots) {
+            const auto path = Document::localPath(query.value(6).toString());
+            if (!path.isEmpty()) {
+                roots << existingParent(path);
+            }
+        }
+    }
+    query.finish();
+
+    if (!left) {
+        return true;
+    }
+
+    // Scan each tree once. Never the whole file system.
+    roots.removeDuplicates();
+    std::sort(roots.begin(), roots.end(), [](const QString& a, const QString& b) {
+        return a.size() < b.size();
+    });
+    QStringList top;
+    for(const auto& root : roots) {
+        if (root.isEmpty() || QDir{root}.isRoot()) {
+            continue;
+        }
+        const auto inside = std::any_of(top.begin(), top.end(), [&root](const QString& parent) {
+            return root.startsWith(parent.endsWith('/') ? parent : parent + '/');
+        });
+        if (!inside) {
+            top << root;
+        }
+    }
+
+    int scanned = 0;
+    for(const auto& root : top) {
+        QDirIterator it(root, QDir::Files | QDir::NoDotAndDotDot,
+                        recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+        while(left > 0 && scanned < maxScannedFiles && it.hasNext()) {
+            if (cancelled()) {
+                return false;
+            }
+
+            const auto path = it.next();
+            ++scanned;
+
+            const auto candidates = by_size.find(it.fileInfo().size());
+            if (candidates == by_size.end()) {
+                continue;
+            }
+
+            const auto hash = HashFile(path, &cancelled_);
+            if (hash.isEmpty()) {
+                continue;
+            }
+
+            for(auto& doc : *candidates) {
+                if (doc.path.isEmpty() && doc.hash == hash) {
+                    doc.path = path;
+                    doc.mtime = it.fileInfo().lastModified().toTime_t();
+                    --left;
+                }
+            }
+        }
+    }
+
+    if (scanned >= maxScannedFiles) {
+        qDebug() << "File monitor: Gave up the search for moved files after " << scanned << " files";
+    }
+
+    QVariantList ids, locations, mtimes;
+    QVariantList journal_contact, journal_person, journal_intent, journal_activity,
+            journal_document, journal_text;
+    for(const auto& docs : by_size) {
+        for(const auto& doc : docs) {
+            if (doc.path.isEmpty()) {
+                continue;
+            }
+
+            qDebug() << "File monitor: Document " << doc.id << " was moved to " << doc.path;
+
+            ids << doc.id;
+            locations << QUrl::fromLocalFile(doc.path).toString();
+            mtimes << doc.mtime;
+
+            journal_contact << doc.contact;
+            journal_person << NullIfZero(doc.person);
+            journal_intent << NullIfZero(doc.intent);
+            journal_activity << NullIfZero(doc.activity);
+            journal_document << doc.id;
+            journal_text << QStringLiteral("Found moved document: %1").arg(doc.name);
+        }
+    }
+
+    if (ids.isEmpty()) {
+        return true;
+    }
+
+    QSqlQuery update(db_);
+    QSqlQuery journal(db_);
+    if (!update.prepare(QStringLiteral("update document set location = ?, file_mtime = ?, file_state = %1 where id = ?")
+                        .arg(static_cast<int>(Document::FileState::OK)))
+            || !journal.prepare(QStringLiteral("insert into journal (type, date, contact, person, intent, activity, document, text) "
+                                               "values (%1, %2, ?, ?, ?, ?, ?, ?)")
+                                .arg(static_cast<int>(JournalModel::Type::UPDATED_DOCUMENT))
+                                .arg(static_cast<uint>(time(nullptr))))) {
+        qWarning() << "File monitor: Failed to prepare statements: " << update.lastError().text()
+                   << journal.lastError().text();
+        return false;
+    }
+
+    update.addBindValue(locations);
+    update.addBindValue(mtimes);
+    update.addBindValue(ids);
+    journal.addBindValue(journal_contact);
+    journal.addBindValue(journal_person);
+    journal.addBindValue(journal_intent);
+    journal.addBindValue(journal_activity);
+    journal.addBindValue(journal_document);
+    journal.addBindValue(journal_text);
+
+    db_.transaction();
+    if (!update.execBatch() || !journal.execBatch()) {
+        qWarning() << "File monitor: Failed to relink moved documents: " << update.lastError().text()
+                   << journal.lastError().text();
+        db_.rollback();
+        return false;
+    }
+
+    if (!db_.commit()) {
+        qWarning() << "File monitor: Failed to commit: " << db_.lastError().text();
+        db_.rollback();
+        return false;
+    }
+
+    for(const auto& contact : journal_contact) {
+        contacts.insert(contact.toInt());
+    }
+
+    return true;
+}
+
+void FileMonitorWorker::watch(const QHash<QString, QList<int>> &dirs)
+{
+    auto paths = dirs.keys();
+    std::sort(paths.begin(), paths.end(), [&dirs](const QString& a, const QString& b) {
+        return dirs.value(a).size() > dirs.value(b).size();
+    });
+
+    dirs_.clear();
+    QStringList watch;
+    for(const auto& path : paths) {
+        if (watch.size() >= maxWatchedDirs) {
+            break;
+        }
+        if (QFileInfo{path}.isDir()) {
+            watch << path;
+            dirs_.insert(path, dirs.value(path));
+        }
+    }
+
+    const auto watched = watcher_->directories();
+    if (!watched.isEmpty()) {
+        watcher_->removePaths(watched);
+    }
+    if (!watch.isEmpty()) {
+        watcher_->addPaths(watch);
+    }
+}
+
+FileMonitor::FileMonitor(const int interval, QObject *parent)
+    : QObject(parent)
+{
+    // A worker connection can not see an in-memory database, and the
+    // files are never checked in the GUI thread.
+    if (Database::instance().path() == ":memory:") {
+        qDebug() << "File monitor: Not started for an in-memory database";
+        return;
+    }
+
+    host_ = std::make_unique<WorkerHost<FileMonitorWorker>>(
+                new FileMonitorWorker(Database::instance().path(), std::max(60, interval), cancelled_),
+                QThread::LowPriority);
+    const auto worker = host_->worker();
+    connect(worker, &FileMonitorWorker::updated, this, &FileMonitor::updated);
+    host_->post([worker] {
+        worker->start();
+    });
+}
+
+FileMonitor::~FileMonitor()
+{
+    cancelled_ = true;
+}
+
+void FileMonitor::checkNow()
+{
+    if (host_) {
+        const auto worker = host_->worker();
+        host_->post([worker] {
+            worker->sweep();
+        });
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef FILEMONITOR_H
+#define FILEMONITOR_H
+
+#include <atomic>
+#include <memory>
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "database.h"
+#include "workerhost.h"
+
+// Checks the files behind the FILE documents on its own database connection.
+class FileMonitorWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Documents per query and transaction
+    static constexpr int pageSize = 1000;
+
+    // Directories watched with QFileSystemWatcher, the ones with most documents first
+    static constexpr int maxWatchedDirs = 1000;
+
+    // Files looked at when searching for moved files
+    static constexpr int maxScannedFiles = 200000;
+
+    // Seconds from start() to the first sweep
+    static constexpr int firstSweepDelay = 30;
+
+    // Seconds to wait for a changed directory to settle before it is checked
+    static constexpr int changedDirDelay = 2;
+
+    FileMonitorWorker(const QString& dbpath, int interval, const std::atomic_bool& cancelled);
+
+public slots:
+    void start();
+    void sweep();
+
+signals:
+    // The contacts with documents that changed state or location
+    void updated(const QList<int>& contacts);
+
+private slots:
+    void onDirectoryChanged(const QString& path);
+    void checkChangedDirs();
+
+private:
+    struct File {
+        int id = 0;
+        int contact = 0;
+        QString path;
+        qint64 size = -1;   // file_size
+        qint64 mtime = -1;  // file_mtime
+        QString hash;       // file_hash
+        int state = 0;      // file_state
+        int old_state = 0;  // file_state as it was read
+        bool dirty = false; // Must be saved
+    };
+
+    bool open();
+    File read(const QSqlQuery& query) const;
+    void check(File& file);
+    bool save(const QList<File>& files, QSet<int>& contacts);
+    bool relink(QStringList roots, bool recursive, QSet<int>& contacts);
+    void watch(const QHash<QString, QList<int>>& dirs);
+    bool cancelled() const { return cancelled_; }
+
+    WorkerConnection connection_;
+    const int interval_; // Seconds between sweeps
+    const std::atomic_bool& cancelled_;
+    QSqlDatabase db_;
+
+    QTimer *timer_ = {};
+    QTimer *changed_timer_ = {};
+    QFileSystemWatcher *watcher_ = {};
+    QHash<QString, QList<int>> dirs_; // Watched directory -> documents in it
+    QSet<QString> changed_dirs_;
+};
+
+// Keeps an eye on the files behind the FILE documents.
+//
+// A worker thread sweeps all the FILE documents now and then, a page at a
+// time. A file with the size and modification time it had at the last
+// sweep is taken to be unchanged, without being read. Other files are
+// hashed and compared with file_hash, so a touched file is not flagged.
+// Documents added before file_hash existed get it at their first sweep.
+// The result goes in file_state (Document::FileState), and the
+// DocumentsModel shows it.
+//
+// Missing files with a known hash are searched for in the nearest
+// existing parent directories of where they were. A file with the same
+// size and hash is taken to be the moved file, and the document (and the
+// journal) is updated with the new location.
+//
+// Between the sweeps, the directories with most documents are watched with
+// a QFileSystemWatcher, and the documents in a directory that changes are
+// checked at once.
+//
+// Nothing is done with an in-memory database, as it can't be shared with
+// the worker thread.
+class FileMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    // interval is in seconds
+    FileMonitor(int interval, QObject *parent);
+    ~FileMonitor();
+
+    // Check all the documents now
+    void checkNow();
+
+signals:
+    void updated(const QList<int>& contacts);
+
+private:
+    std::atomic_bool cancelled_{false};
+    std::unique_ptr<WorkerHost<FileMonitorWorker>> host_;
+};
+
+#endif // FILEMONITOR_H
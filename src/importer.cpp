@@ -0,0 +1,874 @@
+#include "src/importer.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <QDebug>
+#include <QFile>
+#include <QSqlError>
+#include <QTextStream>
+
+#include "src/database.h"
+#include "src/contact.h"
+#include "src/channel.h"
+#include "src/journalmodel.h"
+
+using namespace std;
+
+namespace {
+
+// Report progress this often, in records
+constexpr int progress_every = 1000;
+
+class RecordReader
+{
+public:
+    virtual ~RecordReader() = default;
+
+    // Returns false at the end of the file
+    virtual bool next(ImportRecord& rec) = 0;
+};
+
+// RFC 4180 style CSV with a header row. Quoted fields can contain
+// the delimiter, quotes ("") and line breaks. The delimiter is
+// guessed from the header (',', ';' or tab).
+class CsvReader : public RecordReader
+{
+public:
+    explicit CsvReader(QTextStream& in)
+        : in_{in}
+    {
+        QString line;
+        while(line.isEmpty() && !in_.atEnd()) {
+            line = in_.readLine();
+        }
+
+        const auto commas = line.count(',');
+        const auto semicolons = line.count(';');
+        const auto tabs = line.count('\t');
+        if (tabs > commas && tabs > semicolons) {
+            delimiter_ = '\t';
+        } else if (semicolons > commas) {
+            delimiter_ = ';';
+        }
+
+        QStringList header;
+        parse(line, header);
+        for(const auto& name : header) {
+            columns_.push_back(map(name));
+        }
+    }
+
+    bool next(ImportRecord& rec) override {
+        QStringList fields;
+        QString given, family;
+
+        for(;;) {
+            rec.clear();
+            if (!readRow(fields)) {
+                return false;
+            }
+
+            const auto count = min(fields.size(), static_cast<int>(columns_.size()));
+            for(int i = 0; i < count; ++i) {
+                const auto value = fields.at(i).trimmed();
+                if (value.isEmpty()) {
+                    continue;
+                }
+
+                const auto& col = columns_[static_cast<size_t>(i)];
+                switch(col.kind) {
+                case Column::IGNORE:
+                    break;
+                case Column::COMPANY:
+                    rec.company = value;
+                    break;
+                case Column::NAME:
+                    rec.name = value;
+                    break;
+                case Column::GIVEN_NAME:
+                    given = value;
+                    break;
+                case Column::FAMILY_NAME:
+                    family = value;
+                    break;
+                case Column::FIELD:
+                    rec.fields[col.field] = value;
+                    break;
+                case Column::CHANNEL:
+                    rec.channels.append({col.channel, value});
+                    break;
+                }
+            }
+
+            if (rec.name.isEmpty()) {
+                rec.name = QStringLiteral("%1 %2").arg(given, family).trimmed();
+            }
+            given.clear();
+            family.clear();
+
+            if (!rec.name.isEmpty() || !rec.company.isEmpty()
+                    || !rec.fields.isEmpty() || !rec.channels.isEmpty()) {
+                return true;
+            }
+            // Blank row
+        }
+    }
+
+private:
+    struct Column {
+        enum Kind { IGNORE, COMPANY, NAME, GIVEN_NAME, FAMILY_NAME, FIELD, CHANNEL };
+        Kind kind = IGNORE;
+        QString field;
+        int channel = 0;
+    };
+
+    static Column map(const QString& header) {
+        static const QHash<QString, Column::Kind> names {
+            {"company", Column::COMPANY},
+            {"company name", Column::COMPANY},
+            {"organization", Column::COMPANY},
+            {"organisation", Column::COMPANY},
+            {"org", Column::COMPANY},
+            {"name", Column::NAME},
+            {"full name", Column::NAME},
+            {"person", Column::NAME},
+            {"contact", Column::NAME},
+            {"contact name", Column::NAME},
+            {"first name", Column::GIVEN_NAME},
+            {"given name", Column::GIVEN_NAME},
+            {"last name", Column::FAMILY_NAME},
+            {"family name", Column::FAMILY_NAME},
+            {"surname", Column::FAMILY_NAME},
+        };
+
+        static const QHash<QString, QString> fields {
+            {"notes", "notes"},
+            {"note", "notes"},
+            {"address", "address1"},
+            {"address1", "address1"},
+            {"address 1", "address1"},
+            {"street", "address1"},
+            {"address2", "address2"},
+            {"address 2", "address2"},
+            {"postcode", "postcode"},
+            {"postal code", "postcode"},
+            {"zip", "postcode"},
+            {"zip code", "postcode"},
+            {"city", "city"},
+            {"town", "city"},
+            {"region", "region"},
+            {"state", "state"},
+            {"country", "country"},
+        };
+
+        static const QHash<QString, ChannelType> channels {
+            {"e-mail", ChannelType::EMAIL},
+            {"email address", ChannelType::EMAIL},
+            {"mail", ChannelType::EMAIL},
+            {"telephone", ChannelType::PHONE},
+            {"tel", ChannelType::PHONE},
+            {"phone number", ChannelType::PHONE},
+            {"cell", ChannelType::MOBILE},
+            {"mobile phone", ChannelType::MOBILE},
+            {"website", ChannelType::WEB},
+            {"url", ChannelType::WEB},
+            {"homepage", ChannelType::WEB},
+        };
+
+        Column col;
+        auto key = header.trimmed().toLower();
+        key.replace('_', ' ');
+
+        if (names.contains(key)) {
+            col.kind = names.value(key);
+        } else if (fields.contains(key)) {
+            col.kind = Column::FIELD;
+            col.field = fields.value(key);
+        } else if (channels.contains(key)) {
+            col.kind = Column::CHANNEL;
+            col.channel = static_cast<int>(channels.value(key));
+        } else {
+            for(const auto type : GetChannelTypeEnums()) {
+                if (GetChannelTypeName(type).compare(key, Qt::CaseInsensitive) == 0) {
+                    col.kind = Column::CHANNEL;
+                    col.channel = static_cast<int>(type);
+                    break;
+                }
+            }
+        }
+
+        if (col.kind == Column::IGNORE) {
+            qDebug() << "Import: Ignoring column " << header;
+        }
+
+        return col;
+    }
+
+    bool readRow(QStringList& fields) {
+        QString line;
+        while(line.isEmpty()) {
+            if (in_.atEnd()) {
+                return false;
+            }
+            line = in_.readLine();
+        }
+
+        parse(line, fields);
+        return true;
+    }
+
+    // Continues on the next lines while inside a quoted field
+    void parse(QString line, QStringList& fields) {
+        fields.clear();
+        QString field;
+        bool quoted = false;
+
+        for(int i = 0;; ++i) {
+            if (i == line.size()) {
+                if (quoted && !in_.atEnd()) {
+                    field += '\n';
+                    line = in_.readLine();
+                    i = -1;
+                    continue;
+                }
+                fields << field;
+                return;
+            }
+
+            const auto ch = line.at(i);
+            if (quoted) {
+                if (ch == '"') {
+                    if ((i + 1) < line.size() && line.at(i + 1) == '"') {
+                        field += ch;
+                        ++i;
+                    } else {
+                        quoted = false;
+                    }
+                } else {
+                    field += ch;
+                }
+            } else if (ch == '"') {
+                quoted = true;
+            } else if (ch == delimiter_) {
+                fields << field;
+                field.clear();
+            } else {
+                field += ch;
+            }
+        }
+    }
+
+    QTextStream& in_;
+    QChar delimiter_ = ',';
+    vector<Column> columns_;
+};
+
+// vCard 3.0 and 4.0 (RFC 2426, RFC 6350). Only the properties we
+// have a place for are used.
+class VCardReader : public RecordReader
+{
+public:
+    explicit VCardReader(QTextStream& in)
+        : in_{in}
+    {
+    }
+
+    bool next(ImportRecord& rec) override {
+        rec.clear();
+        bool in_card = false;
+        QString line;
+        QStringList family_given;
+
+        while(readLine(line)) {
+            const auto colon = findColon(line);
+            if (colon < 0) {
+                continue;
+            }
+
+            auto params = line.left(colon).split(';');
+            auto prop = params.takeFirst().toUpper();
+            const auto value = line.mid(colon + 1);
+
+            // Drop the group, as in "item1.EMAIL"
+            const auto dot = prop.indexOf('.');
+            if (dot >= 0) {
+                prop = prop.mid(dot + 1);
+            }
+
+            if (prop == "BEGIN") {
+                in_card = value.trimmed().compare("VCARD", Qt::CaseInsensitive) == 0;
+                continue;
+            }
+
+            if (!in_card) {
+                continue;
+            }
+
+            if (prop == "END") {
+                if (rec.name.isEmpty() && !family_given.isEmpty()) {
+                    rec.name = QStringLiteral("%1 %2")
+                            .arg(family_given.value(1), family_given.value(0))
+                            .trimmed();
+                }
+                return true;
+            }
+
+            if (prop == "FN") {
+                rec.name = unescape(value).trimmed();
+            } else if (prop == "N") {
+                family_given = components(value);
+            } else if (prop == "ORG") {
+                rec.company = components(value).value(0).trimmed();
+            } else if (prop == "NOTE") {
+                rec.fields["notes"] = unescape(value);
+            } else if (prop == "ADR") {
+                // PO box; extended address; street; locality; region; postal code; country
+                const auto adr = components(value);
+                setField(rec, "address1", adr.value(2));
+                setField(rec, "address2", adr.value(1));
+                setField(rec, "city", adr.value(3));
+                setField(rec, "region", adr.value(4));
+                setField(rec, "postcode", adr.value(5));
+                setField(rec, "country", adr.value(6));
+            } else if (prop == "EMAIL") {
+                addChannel(rec, ChannelType::EMAIL, value);
+            } else if (prop == "TEL") {
+                const bool mobile = params.join(';').contains("cell", Qt::CaseInsensitive);
+                auto number = unescape(value).trimmed();
+                if (number.startsWith("tel:", Qt::CaseInsensitive)) {
+                    number = number.mid(4);
+                }
+                addChannel(rec, mobile ? ChannelType::MOBILE : ChannelType::PHONE, number);
+            } else if (prop == "URL") {
+                const auto url = unescape(value).trimmed();
+                auto type = ChannelType::WEB;
+                if (url.contains("linkedin.com", Qt::CaseInsensitive)) {
+                    type = ChannelType::LINKEDIN;
+                } else if (url.contains("github.com", Qt::CaseInsensitive)) {
+                    type = ChannelType::GITHUB;
+                } else if (url.contains("facebook.com", Qt::CaseInsensitive)) {
+                    type = ChannelType::FACEBOOK;
+                } else if (url.contains("reddit.com", Qt::CaseInsensitive)) {
+                    type = ChannelType::REDDIT;
+                }
+                addChannel(rec, type, url);
+            } else if (prop == "X-SKYPE" || prop == "X-SKYPE-USERNAME") {
+                addChannel(rec, ChannelType::SKYPE, value);
+            } else if (prop == "IMPP" && value.startsWith("skype:", Qt::CaseInsensitive)) {
+                addChannel(rec, ChannelType::SKYPE, value.mid(6));
+            }
+        }
+
+        return false;
+    }
+
+private:
+    // One logical line. Folded lines (continued lines start with
+    // a space or tab) are joined.
+    bool readLine(QString& line) {
+        if (!has_pending_) {
+            if (in_.atEnd()) {
+                return false;
+            }
+            pending_ = in_.readLine();
+        }
+
+        line = pending_;
+        has_pending_ = false;
+
+        while(!in_.atEnd()) {
+            pending_ = in_.readLine();
+            if (!pending_.isEmpty() && (pending_.at(0) == ' ' || pending_.at(0) == '\t')) {
+                line += pending_.midRef(1);
+            } else {
+                has_pending_ = true;
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    // The colon between the name/parameters and the value.
+    // Parameter values can be quoted, and then contain colons.
+    static int findColon(const QString& line) {
+        bool quoted = false;
+        for(int i = 0; i < line.size(); ++i) {
+            const auto ch = line.at(i);
+            if (ch == '"') {
+                quoted = !quoted;
+            } else if (ch == ':' && !quoted) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static QString unescape(const QString& value) {
+        QString text;
+        text.reserve(value.size());
+        for(int i = 0; i < value.size(); ++i) {
+            auto ch = value.at(i);
+            if (ch == '\\' && (i + 1) < value.size()) {
+                ch = value.at(++i);
+                if (ch == 'n' || ch == 'N') {
+                    ch = '\n';
+                }
+            }
+            text += ch;
+        }
+        return text;
+    }
+
+    // Split a structured value on the unescaped ';'
+    static QStringList components(const QString& value) {
+        QStringList list;
+        int start = 0;
+        for(int i = 0; i <= value.size(); ++i) {
+            if (i == value.size() || value.at(i) == ';') {
+                list << unescape(value.mid(start, i - start));
+                start = i + 1;
+            } else if (value.at(i) == '\\') {
+                ++i;
+            }
+        }
+        return list;
+    }
+
+    static void setField(ImportRecord& rec, const QString& name, const QString& value) {
+        const auto trimmed = value.trimmed();
+        if (!trimmed.isEmpty()) {
+            rec.fields[name] = trimmed;
+        }
+    }
+
+    static void addChannel(ImportRecord& rec, const ChannelType type, const QString& value) {
+        const auto trimmed = unescape(value).trimmed();
+        if (!trimmed.isEmpty()) {
+            rec.channels.append({static_cast<int>(type), trimmed});
+        }
+    }
+
+    QTextStream& in_;
+    QString pending_;
+    bool has_pending_ = false;
+};
+
+// The contact a records channels go to: the person, or the company
+const QString& ownerName(const ImportRecord& rec)
+{
+    return rec.name.isEmpty() ? rec.company : rec.name;
+}
+
+// The key for a channel and its owner in pending_norms_. Matching types
+// share a key.
+QString pendingKey(const ChannelType type, const QString& norm, const QString& name)
+{
+    const auto key_type = std::min(static_cast<int>(type),
+                                   static_cast<int>(GetMatchingChannelType(type)));
+    return QStringLiteral("%1:%2:%3").arg(key_type).arg(norm, name.toLower());
+}
+
+// The key for a channel of a contact in pending_channels_
+QString channelKey(const int contact, const ChannelType type, const QString& norm)
+{
+    return QStringLiteral("%1:%2").arg(contact).arg(pendingKey(type, norm, {}));
+}
+
+} // anonymous namespace
+
+ImportWorker::ImportWorker(const QString &dbpath, const std::atomic_bool &cancelled)
+    : connection_{QStringLiteral("import"), dbpath}, cancelled_{cancelled}
+{
+}
+
+void ImportWorker::run(const QString &path)
+{
+    ImportSummary summary;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        summary.error = QStringLiteral("Failed to open %1: %2").arg(path, file.errorString());
+        emit finished(summary);
+        return;
+    }
+
+    if (!open() || !prepare()) {
+        summary.error = QStringLiteral("Failed to prepare the database for the import");
+        emit finished(summary);
+        return;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+
+    unique_ptr<RecordReader> reader;
+    if (path.endsWith(".vcf", Qt::CaseInsensitive)
+            || path.endsWith(".vcard", Qt::CaseInsensitive)) {
+        reader = make_unique<VCardReader>(in);
+    } else {
+        reader = make_unique<CsvReader>(in);
+    }
+
+    companies_.clear();
+    ImportSummary batch;
+    int records = 0, in_batch = 0;
+    ImportRecord rec;
+
+    const auto commit = [&]() -> bool {
+        if (!flush() || !db_.commit()) {
+            qWarning() << "Import: Failed to commit: " << db_.lastError().text();
+            db_.rollback();
+            return false;
+        }
+
+        summary.companies += batch.companies;
+        summary.persons += batch.persons;
+        summary.channels += batch.channels;
+        summary.skipped += batch.skipped;
+        summary.duplicates += batch.duplicates;
+        batch = {};
+        in_batch = 0;
+        return true;
+    };
+
+    db_.transaction();
+    while(reader->next(rec)) {
+        if (cancelled_) {
+            db_.rollback();
+            summary.cancelled = true;
+            emit finished(summary);
+            return;
+        }
+
+        if (!add(rec, batch)) {
+            db_.rollback();
+            summary.error = QStringLiteral("Failed to add record #%1").arg(records + 1);
+            emit finished(summary);
+            return;
+        }
+
+        ++records;
+        if (++in_batch >= batchSize) {
+            if (!commit()) {
+                summary.error = QStringLiteral("Failed to commit the import");
+                emit finished(summary);
+                return;
+            }
+            db_.transaction();
+        }
+
+        if ((records % progress_every) == 0) {
+            emit progress(file.pos(), file.size(), records);
+        }
+    }
+
+    if (!commit()) {
+        summary.error = QStringLiteral("Failed to commit the import");
+    }
+
+    qDebug() << "Import: " << records << " records from " << path;
+    emit progress(file.size(), file.size(), records);
+    emit finished(summary);
+}
+
+bool ImportWorker::open()
+{
+    db_ = connection_.open();
+    return db_.isValid();
+}
+
+bool ImportWorker::prepare()
+{
+    if (prepared_) {
+        return true;
+    }
+
+    insert_contact_ = QSqlQuery(db_);
+    find_company_ = QSqlQuery(db_);
+    find_channel_ = QSqlQuery(db_);
+    has_channel_ = QSqlQuery(db_);
+
+    if (!insert_contact_.prepare(
+                QStringLiteral("insert into contact (contact, created_date, last_activity_date, name, type, "
+                               "notes, address1, address2, postcode, city, region, state, country) "
+                               "values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"))
+            || !find_company_.prepare(
+                QStringLiteral("select id from contact where contact is NULL and name = ? and type = ? limit 1"))
+            || !find_channel_.prepare(
+                QStringLiteral("select 1 from channel as ch join contact as c on c.id = ch.contact "
+                               "where ch.type in (?, ?) and ch.norm = ? and c.name = ? collate nocase limit 1"))
+            || !has_channel_.prepare(
+                QStringLiteral("select 1 from channel where type in (?, ?) and norm = ? and contact = ? limit 1"))) {
+        qWarning() << "Import: Failed to prepare statements: " << insert_contact_.lastError().text()
+                   << find_company_.lastError().text() << find_channel_.lastError().text()
+                   << has_channel_.lastError().text();
+        return false;
+    }
+
+    prepared_ = true;
+    return true;
+}
+
+bool ImportWorker::add(const ImportRecord &rec, ImportSummary &batch)
+{
+    if (rec.name.isEmpty() && rec.company.isEmpty()) {
+        ++batch.skipped;
+        return true;
+    }
+
+    if (isDuplicate(rec)) {
+        ++batch.duplicates;
+        return true;
+    }
+
+    // The contact that gets the details and channels
+    int id = 0;
+    bool existing = false; // id was there before this record
+
+    if (!rec.company.isEmpty()) {
+        auto company = companies_.value(rec.company);
+        if (!company) {
+            company = findCompany(rec.company);
+        }
+
+        bool added_company = false;
+        if (!company) {
+            company = addContact(rec.name.isEmpty() ? &rec : nullptr, rec.company,
+                                 static_cast<int>(ContactType::CORPORATION), 0);
+            if (!company) {
+                return false;
+            }
+            added_company = true;
+            ++batch.companies;
+        }
+        companies_.insert(rec.company, company);
+
+        if (rec.name.isEmpty()) {
+            existing = !added_company;
+            id = company;
+        } else {
+            id = addContact(&rec, rec.name, static_cast<int>(ContactType::INDIVID), company);
+            if (!id) {
+                return false;
+            }
+            ++batch.persons;
+        }
+    } else {
+        id = addContact(&rec, rec.name, static_cast<int>(ContactType::INDIVID), 0);
+        if (!id) {
+            return false;
+        }
+        ++batch.persons;
+    }
+
+    for(const auto& channel : rec.channels) {
+        const auto norm = NormalizeChannelValue(channel.first, channel.second);
+        const auto type = ToChannelType(channel.first);
+        if (rec.name.isEmpty() && !norm.isEmpty()) {
+            // A company can come again, in this file or in another one
+            bool ok = true;
+            if (existing && hasChannel(id, type, norm, ok)) {
+                continue;
+            }
+            if (!ok) {
+                return false;
+            }
+            pending_channels_.insert(channelKey(id, type, norm));
+        }
+
+        channel_contact_ << id;
+        channel_type_ << channel.first;
+        channel_value_ << channel.second;
+        channel_norm_ << (norm.isEmpty() ? QVariant{QVariant::String} : QVariant{norm});
+        if (IsPersonalChannel(type) && !norm.isEmpty()) {
+            pending_norms_.insert(pendingKey(type, norm, ownerName(rec)));
+        }
+        ++batch.channels;
+    }
+
+    return true;
+}
+
+int ImportWorker::addContact(const ImportRecord *details, const QString &name,
+                             const int type, const int parent)
+{
+    static const QStringList fields{"notes", "address1", "address2", "postcode",
+                                    "city", "region", "state", "country"};
+
+    const auto now = static_cast<uint>(time(nullptr));
+
+    insert_contact_.addBindValue(parent ? QVariant{parent} : QVariant{QVariant::Int});
+    insert_contact_.addBindValue(now);
+    insert_contact_.addBindValue(now);
+    insert_contact_.addBindValue(name);
+    insert_contact_.addBindValue(type);
+    for(const auto& field : fields) {
+        insert_contact_.addBindValue(details && details->fields.contains(field)
+                                     ? QVariant{details->fields.value(field)}
+                                     : QVariant{QVariant::String});
+    }
+
+    if (!insert_contact_.exec()) {
+        qWarning() << "Import: Failed to add " << name << ": "
+                   << insert_contact_.lastError().text();
+        return 0;
+    }
+
+    const auto id = insert_contact_.lastInsertId().toInt();
+
+    const bool is_company = type == static_cast<int>(ContactType::CORPORATION);
+    journal_type_ << static_cast<int>(is_company ? JournalModel::Type::ADD_COMPANY
+                                                 : JournalModel::Type::ADD_PERSON);
+    journal_date_ << now;
+    journal_contact_ << (parent ? parent : id);
+    journal_person_ << (parent ? QVariant{id} : QVariant{QVariant::Int});
+    journal_text_ << QStringLiteral("Imported %1: %2").arg(parent ? "Person" : "Contact", name);
+
+    return id;
+}
+
+bool ImportWorker::isDuplicate(const ImportRecord &rec)
+{
+    for(const auto& channel : rec.channels) {
+        const auto type = ToChannelType(channel.first);
+        if (!IsPersonalChannel(type)) {
+            continue;
+        }
+
+        const auto norm = NormalizeChannelValue(type, channel.second);
+        if (norm.isEmpty()) {
+            continue;
+        }
+
+        if (pending_norms_.contains(pendingKey(type, norm, ownerName(rec)))) {
+            return true;
+        }
+
+        find_channel_.addBindValue(static_cast<int>(type));
+        find_channel_.addBindValue(static_cast<int>(GetMatchingChannelType(type)));
+        find_channel_.addBindValue(norm);
+        find_channel_.addBindValue(ownerName(rec));
+        if (!find_channel_.exec()) {
+            qWarning() << "Import: Failed to look up " << channel.second << ": "
+                       << find_channel_.lastError().text();
+            return false;
+        }
+
+        const bool found = find_channel_.next();
+        find_channel_.finish();
+        if (found) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ImportWorker::hasChannel(const int contact, const ChannelType type, const QString &norm, bool &ok)
+{
+    if (pending_channels_.contains(channelKey(contact, type, norm))) {
+        return true;
+    }
+
+    has_channel_.addBindValue(static_cast<int>(type));
+    has_channel_.addBindValue(static_cast<int>(GetMatchingChannelType(type)));
+    has_channel_.addBindValue(norm);
+    has_channel_.addBindValue(contact);
+    if (!has_channel_.exec()) {
+        qWarning() << "Import: Failed to look up " << norm << ": "
+                   << has_channel_.lastError().text();
+        ok = false;
+        return false;
+    }
+
+    const bool found = has_channel_.next();
+    has_channel_.finish();
+    return found;
+}
+
+int ImportWorker::findCompany(const QString &name)
+{
+    find_company_.addBindValue(name);
+    find_company_.addBindValue(static_cast<int>(ContactType::CORPORATION));
+    if (!find_company_.exec()) {
+        qWarning() << "Import: Failed to look up " << name << ": "
+                   << find_company_.lastError().text();
+        return 0;
+    }
+
+    const auto id = find_company_.next() ? find_company_.value(0).toInt() : 0;
+    find_company_.finish();
+    return id;
+}
+
+bool ImportWorker::flush()
+{
+    if (!channel_contact_.isEmpty()) {
+        QSqlQuery query(db_);
+        query.prepare(QStringLiteral("insert into channel (contact, type, value, norm) values (?, ?, ?, ?)"));
+        query.addBindValue(channel_contact_);
+        query.addBindValue(channel_type_);
+        query.addBindValue(channel_value_);
+        query.addBindValue(channel_norm_);
+        channel_contact_.clear();
+        channel_type_.clear();
+        channel_value_.clear();
+        channel_norm_.clear();
+        pending_norms_.clear();
+        pending_channels_.clear();
+
+        if (!query.execBatch()) {
+            qWarning() << "Import: Failed to add channels: " << query.lastError().text();
+            return false;
+        }
+    }
+
+    if (!journal_type_.isEmpty()) {
+        QSqlQuery query(db_);
+        query.prepare(QStringLiteral("insert into journal (type, date, contact, person, text) values (?, ?, ?, ?, ?)"));
+        query.addBindValue(journal_type_);
+        query.addBindValue(journal_date_);
+        query.addBindValue(journal_contact_);
+        query.addBindValue(journal_person_);
+        query.addBindValue(journal_text_);
+        journal_type_.clear();
+        journal_date_.clear();
+        journal_contact_.clear();
+        journal_person_.clear();
+        journal_text_.clear();
+
+        if (!query.execBatch()) {
+            qWarning() << "Import: Failed to add journal entries: " << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Importer::Importer(QObject *parent)
+    : QObject(parent)
+    , host_{new ImportWorker(Database::instance().path(), cancelled_)}
+{
+    qRegisterMetaType<ImportSummary>();
+
+    connect(host_.worker(), &ImportWorker::progress, this, &Importer::progress);
+    connect(host_.worker(), &ImportWorker::finished, this, &Importer::finished);
+}
+
+Importer::~Importer()
+{
+    cancelled_ = true;
+}
+
+void Importer::start(const QString &path)
+{
+    cancelled_ = false;
+    const auto worker = host_.worker();
+    host_.post([worker, path] {
+        worker->run(path);
+    });
+}
@@ -0,0 +1,149 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include <atomic>
+
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSet>
+#include <QSqlQuery>
+#include <QString>
+#include <QVariantList>
+
+#include "channel.h"
+#include "database.h"
+#include "workerhost.h"
+
+// What an import added to the database
+struct ImportSummary
+{
+    int companies = 0;
+    int persons = 0;
+    int channels = 0;
+    int skipped = 0; // Records without any name
+    int duplicates = 0; // Contacts we already have, by name and email, mobile or handle
+    bool cancelled = false;
+    QString error;
+};
+
+Q_DECLARE_METATYPE(ImportSummary)
+
+// One contact, as read from a CSV or vCard file
+struct ImportRecord
+{
+    // Company name and/or person name. A person with a company is added
+    // as a person under that company.
+    QString company;
+    QString name;
+
+    // Other values, by their column name in the contact table
+    QHash<QString, QString> fields;
+
+    // (ChannelType, value)
+    QList<QPair<int, QString>> channels;
+
+    void clear() {
+        company.clear();
+        name.clear();
+        fields.clear();
+        channels.clear();
+    }
+};
+
+// Reads contacts from a file and inserts them on its own database connection.
+class ImportWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Records per transaction
+    static constexpr int batchSize = 5000;
+
+    ImportWorker(const QString& dbpath, const std::atomic_bool& cancelled);
+
+public slots:
+    void run(const QString& path);
+
+signals:
+    void progress(qint64 done, qint64 total, int records);
+    void finished(const ImportSummary& summary);
+
+private:
+    bool open();
+    bool prepare();
+    bool add(const ImportRecord& rec, ImportSummary& batch);
+    // details may be nullptr. Returns the new id, or 0
+    int addContact(const ImportRecord *details, const QString& name, int type, int parent);
+    int findCompany(const QString& name);
+    bool isDuplicate(const ImportRecord& rec);
+    // True if contact already has the channel, or gets it in this batch
+    bool hasChannel(int contact, ChannelType type, const QString& norm, bool& ok);
+    bool flush();
+
+    WorkerConnection connection_;
+    const std::atomic_bool& cancelled_;
+    QSqlDatabase db_;
+    bool prepared_ = false;
+
+    QSqlQuery insert_contact_;
+    QSqlQuery find_company_;
+    QSqlQuery find_channel_;
+    QSqlQuery has_channel_;
+    QHash<QString, int> companies_;
+
+    // Personal channels (type, normalized value and owner name) added in
+    // this batch, not yet in the database
+    QSet<QString> pending_norms_;
+
+    // Company channels (contact, type and normalized value) added in
+    // this batch, not yet in the database
+    QSet<QString> pending_channels_;
+
+    // Channels and journal entries are written with one execBatch()
+    // per transaction.
+    QVariantList channel_contact_, channel_type_, channel_value_, channel_norm_;
+    QVariantList journal_type_, journal_date_, journal_contact_, journal_person_, journal_text_;
+};
+
+// Imports contacts, persons and channels from CSV or vCard (3.0 / 4.0) files.
+//
+// The file is parsed as a stream, so it is never in memory all at once.
+// The records are inserted with prepared statements in large transactions
+// on a worker thread, and each transaction's journal entries are written
+// in one batch. If the import is cancelled, the transaction in progress
+// is rolled back; the batches that are committed stay.
+//
+// Records for a contact that is already in the database, with the same
+// name and an email address, mobile number or handle (see
+// NormalizeChannelValue()), are counted as duplicates and not imported.
+// Two people who share an address, like info@company.com, are both
+// imported. A company-only record for a company we have only adds the
+// channels that company does not have yet. Persons without any email
+// address, mobile number or handle can not be told apart from namesakes,
+// so importing the same file twice adds them again.
+//
+// CSV files must have a header row. The columns are matched by their
+// header against the contact fields and the channel types (see
+// GetChannelTypeName()), and some common alternatives like "Company",
+// "E-mail" or "Zip". Unknown columns are ignored.
+class Importer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Importer(QObject *parent);
+    ~Importer();
+
+    void start(const QString& path);
+    void cancel() { cancelled_ = true; }
+
+signals:
+    void progress(qint64 done, qint64 total, int records);
+    void finished(const ImportSummary& summary);
+
+private:
+    std::atomic_bool cancelled_{false};
+    WorkerHost<ImportWorker> host_;
+};
+
+#endif // IMPORTER_H
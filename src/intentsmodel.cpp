@@ -1,4 +1,5 @@
 #include <set>
+#include <ctime>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QRunnable>
@@ -11,6 +12,7 @@
 #include "src/strategy.h"
 #include "src/intent.h"
 #include "src/journalmodel.h"
+#include "src/transaction.h"
 
 using namespace std;
 
@@ -28,6 +30,10 @@ IntentsModel::IntentsModel(QSettings &settings, QObject *parent, QSqlDatabase db
     h_abstract_ = fieldIndex("abstract");
     h_notes_ = fieldIndex("notes");
     h_created_date_ = fieldIndex("created_date");
+    h_open_actions_ = fieldIndex("open_actions");
+    h_done_actions_ = fieldIndex("done_actions");
+    h_cancelled_actions_ = fieldIndex("cancelled_actions");
+    h_failed_actions_ = fieldIndex("failed_actions");
 
     Q_ASSERT(h_id_ >= 0
             && h_contact_ > 0
@@ -36,6 +42,10 @@ IntentsModel::IntentsModel(QSettings &settings, QObject *parent, QSqlDatabase db
             && h_abstract_ > 0
             && h_notes_ > 0
             && h_created_date_ > 0
+            && h_open_actions_ > 0
+            && h_done_actions_ > 0
+            && h_cancelled_actions_ > 0
+            && h_failed_actions_ > 0
     );
 
     setSort(h_created_date_, Qt::AscendingOrder);
@@ -44,8 +54,14 @@ IntentsModel::IntentsModel(QSettings &settings, QObject *parent, QSqlDatabase db
 
 void IntentsModel::setContact(int id)
 {
+    contact_ = id;
+    cache_.setContact(id);
+
+    // setFilter() selects by itself once the model has rows
     setFilter(QStringLiteral("contact = %1").arg(id));
-    select();
+    if (!query().isActive()) {
+        select();
+    }
 }
 
 int IntentsModel::getIntentId(const QModelIndex &ix)
@@ -60,6 +76,7 @@ int IntentsModel::getIntentId(const QModelIndex &ix)
 void IntentsModel::removeIntents(const QModelIndexList &indexes)
 {
     Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Transaction transaction;
 
     set<int> rows;
     for(const auto& ix : indexes) {
@@ -75,22 +92,29 @@ void IntentsModel::removeIntents(const QModelIndexList &indexes)
                        << lastError().text();
         }
 
-        JournalModel::instance().addEntry(JournalModel::Type::DELETE_INTENT,
+        if (!JournalModel::instance().addEntry(JournalModel::Type::DELETE_INTENT,
                                     QStringLiteral("Deleted intent: %1")
                                     .arg(rec.value("abstract").toString()),
                                     rec.value("contact").toInt(), 0,
-                                    rec.value("id").toInt());
+                                    rec.value("id").toInt())) {
+            return; // Rolled back
+        }
     }
 
     if (!submitAll()) {
-        qWarning() << "Failed to add new contact (submitAll): "
+        qWarning() << "Failed to remove intents (submitAll): "
                    << lastError().text();
+        transaction.rollback();
+        select();
+        return;
     }
+
+    transaction.commit();
 }
 
 void IntentsModel::addIntent(QSqlRecord rec)
 {
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    Q_ASSERT(editStrategy() == QSqlTableModel::OnFieldChange);
 
     if (rec.isNull(h_created_date_) || !rec.value(h_created_date_).toDateTime().isValid()) {
         rec.setValue(h_created_date_, QDateTime::currentDateTime());
@@ -102,41 +126,75 @@ void IntentsModel::addIntent(QSqlRecord rec)
 //                 << " : " << (rec.isNull(i) ? QStringLiteral("NULL") : rec.value(i).toString());
 //    }
 
-    if (!insertRecord(-1, rec)) {
-        qWarning() << "Failed to add new intent (insertRecord): "
-                   << lastError().text();
-        return;
-    }
+    Transaction transaction;
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new intent (submitAll): "
+    // Sorted by creation date, so the new intent belongs at the end
+    rec.setGenerated(h_id_, false);
+    const auto row = rowCount();
+    if (!insertRecord(row, rec)) {
+        qWarning() << "Failed to add new intent (insertRecord): "
                    << lastError().text();
         return;
     }
 
-    JournalModel::instance().addEntry(JournalModel::Type::ADD_INTENT,
+    if (!JournalModel::instance().addEntry(JournalModel::Type::ADD_INTENT,
                                 QStringLiteral("Added intent: %1")
                                 .arg(rec.value("abstract").toString()),
                                 rec.value("contact").toInt(), 0,
-                                query().lastInsertId().toInt());
+                                data(index(row, h_id_, {}), Qt::DisplayRole).toInt())
+            || !transaction.commit()) {
+        transaction.rollback();
+        select(); // Drop the row we inserted
+        return;
+    }
 
     qDebug() << "Created new intent";
 }
 
-void IntentsModel::updateState()
+void IntentsModel::updateState(const int intent)
 {
     for(int i = 0; i < rowCount(); ++i) {
-        const auto state = ToIntentState(data(index(i, h_state_, {}), Qt::DisplayRole).toInt());
-        if (state == IntentState::DEFINED) {
-            QSqlQuery query(QStringLiteral("select count(*) from action where contact=%1 and intent=%2 and state in (1,2,3,4,6)")
-                      .arg(data(index(i, h_contact_), Qt::DisplayRole).toInt())
-                      .arg(data(index(i, h_id_), Qt::DisplayRole).toInt()));
-            if (query.next() && query.value(0).toInt() > 0) {
-                setData(index(i, h_state_), static_cast<int>(IntentState::PROGRESS));
-                submit();
-            }
+        if (data(index(i, h_id_, {}), Qt::DisplayRole).toInt() == intent) {
+            selectRow(i);
+            break;
         }
     }
+
+    loadOverdue();
+}
+
+int IntentsModel::overdueActions(const int intent) const
+{
+    return overdue_.value(intent);
+}
+
+void IntentsModel::skipCounters(QSqlRecord &rec) const
+{
+    rec.setGenerated(h_open_actions_, false);
+    rec.setGenerated(h_done_actions_, false);
+    rec.setGenerated(h_cancelled_actions_, false);
+    rec.setGenerated(h_failed_actions_, false);
+}
+
+void IntentsModel::loadOverdue()
+{
+    overdue_.clear();
+
+    if (contact_ <= 0) {
+        return;
+    }
+
+    // One grouped query for all the intents. Overdue depends on the
+    // time, so it can't be kept by the triggers.
+    auto& query = Database::instance().query(
+                QStringLiteral("select intent, count(*) from action "
+                               "where contact = ? and state < 4 and due_date < ? "
+                               "group by intent"),
+                {contact_, static_cast<uint>(time(nullptr))});
+    while(query.next()) {
+        overdue_.insert(query.value(0).toInt(), query.value(1).toInt());
+    }
+    query.finish();
 }
 
 QVariant IntentsModel::data(const QModelIndex &ix, int role) const
@@ -145,6 +203,17 @@ QVariant IntentsModel::data(const QModelIndex &ix, int role) const
         if (ix.column() == h_created_date_) {
             return QSqlTableModel::data(ix, role).toDateTime();
         }
+    } else if (role == Qt::ToolTipRole && ix.isValid()) {
+        const auto value = [&](const int col) {
+            return QSqlTableModel::data(index(ix.row(), col, {}), Qt::DisplayRole).toInt();
+        };
+
+        return QStringLiteral("%1 open (%2 overdue), %3 done, %4 cancelled, %5 failed")
+                .arg(value(h_open_actions_))
+                .arg(overdueActions(value(h_id_)))
+                .arg(value(h_done_actions_))
+                .arg(value(h_cancelled_actions_))
+                .arg(value(h_failed_actions_));
     }
     return QSqlTableModel::data(ix, role);
 }
@@ -161,3 +230,27 @@ QVariant IntentsModel::headerData(int section, Qt::Orientation orientation, int
     }
     return QSqlTableModel::headerData(section, orientation, role);
 }
+
+bool IntentsModel::select()
+{
+    const auto ok = cache_.select(selectStatement(), [this] {
+        return QSqlTableModel::select();
+    });
+
+    loadOverdue();
+    return ok;
+}
+
+bool IntentsModel::updateRowInTable(int row, const QSqlRecord &values)
+{
+    QSqlRecord rec{values};
+    skipCounters(rec);
+    return QSqlTableModel::updateRowInTable(row, rec);
+}
+
+bool IntentsModel::insertRowIntoTable(const QSqlRecord &values)
+{
+    QSqlRecord rec{values};
+    skipCounters(rec);
+    return QSqlTableModel::insertRowIntoTable(rec);
+}
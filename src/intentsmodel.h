@@ -7,6 +7,7 @@
 #include <QImage>
 #include <QMetaType>
 #include <QSqlDatabase>
+#include <QHash>
 
 #include "database.h"
 
@@ -27,17 +28,32 @@ public:
     DEF_COLUMN(abstract)
     DEF_COLUMN(notes)
     DEF_COLUMN(created_date)
+    DEF_COLUMN(open_actions)
+    DEF_COLUMN(done_actions)
+    DEF_COLUMN(cancelled_actions)
+    DEF_COLUMN(failed_actions)
 
     void setContact(int id);
     int getIntentId(const QModelIndex& ix);
 
+    // Open actions for the intent that are past their due date
+    int overdueActions(const int intent) const;
+
 public slots:
     void removeIntents(const QModelIndexList& indexes);
     void addIntent(QSqlRecord rec);
-    void updateState();
+
+    // Re-read the state and action counters for intent, after its actions changed.
+    // The promotion from DEFINED to PROGRESS is done by the database.
+    void updateState(const int intent);
 
 private:
+    // The action counters are maintained by triggers. Never write them.
+    void skipCounters(QSqlRecord& rec) const;
+    void loadOverdue();
+
     QSettings& settings_;
+    DetailCacheClient cache_{*this};
 
     int h_id_ = {};
     int h_contact_ = {};
@@ -46,11 +62,25 @@ private:
     int h_abstract_ = {};
     int h_notes_ = {};
     int h_created_date_ = {};
+    int h_open_actions_ = {};
+    int h_done_actions_ = {};
+    int h_cancelled_actions_ = {};
+    int h_failed_actions_ = {};
+
+    int contact_ = -1;
+    QHash<int, int> overdue_; // intent -> count
 
     // QAbstractItemModel interface
 public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    // QSqlTableModel interface
+public slots:
+    bool select() override;
+protected:
+    bool updateRowInTable(int row, const QSqlRecord &values) override;
+    bool insertRowIntoTable(const QSqlRecord &values) override;
 };
 
 
@@ -0,0 +1,330 @@
+#include "src/ipcserver.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QLocalSocket>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+
+#include "src/action.h"
+#include "src/channel.h"
+#include "src/database.h"
+#include "src/journalmodel.h"
+
+namespace {
+
+// JSON-RPC 2.0 error codes
+constexpr int parse_error = -32700;
+constexpr int invalid_request = -32600;
+constexpr int method_not_found = -32601;
+constexpr int invalid_params = -32602;
+constexpr int server_error = -32000;
+
+// Max rows in a reply
+constexpr int max_channels = 50;
+constexpr int max_actions = 200;
+
+QByteArray toLine(QJsonObject reply, const QJsonValue& id)
+{
+    reply.insert("jsonrpc", "2.0");
+    reply.insert("id", id);
+    auto line = QJsonDocument(reply).toJson(QJsonDocument::Compact);
+    line += '\n';
+    return line;
+}
+
+QByteArray errorReply(const QJsonValue& id, const int code, const QString& message)
+{
+    return toLine({{"error", QJsonObject{{"code", code}, {"message", message}}}}, id);
+}
+
+// Null for NULL or 0, so clients can test the fields directly
+QJsonValue toId(const QVariant& value)
+{
+    const auto id = value.toInt();
+    return id ? QJsonValue(id) : QJsonValue();
+}
+
+} // anonymous namespace
+
+IpcServer::IpcServer(QObject *parent)
+    : QObject(parent)
+{
+    server_.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&server_, &QLocalServer::newConnection, this, &IpcServer::onNewConnection);
+}
+
+QString IpcServer::defaultName()
+{
+#ifdef Q_OS_WIN
+    return QStringLiteral("f-crm");
+#else
+    // A plain name would go to /tmp, shared by all the users
+    auto dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) {
+        dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+    }
+    return dir + QStringLiteral("/f-crm.sock");
+#endif
+}
+
+bool IpcServer::listen(const QString &name)
+{
+    if (server_.listen(name)) {
+        qDebug() << "Listening for local requests on " << server_.fullServerName();
+        return true;
+    }
+
+    if (server_.serverError() == QAbstractSocket::AddressInUseError) {
+        // Left behind by an instance that did not exit cleanly, or in use
+        // by one that is still running. Only take it over if nobody answers.
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(100)) {
+            qWarning() << "Another instance is serving " << name;
+            return false;
+        }
+
+        QLocalServer::removeServer(name);
+        if (server_.listen(name)) {
+            qDebug() << "Listening for local requests on " << server_.fullServerName();
+            return true;
+        }
+    }
+
+    qWarning() << "Failed to listen on " << name << ": " << server_.errorString();
+    return false;
+}
+
+void IpcServer::close()
+{
+    server_.close();
+}
+
+void IpcServer::onNewConnection()
+{
+    while(auto socket = server_.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, &IpcServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    }
+}
+
+void IpcServer::onReadyRead()
+{
+    auto socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket) {
+        return;
+    }
+
+    // Serve all the complete requests we have, and send the replies
+    // with one write.
+    QByteArray replies;
+    while(socket->canReadLine()) {
+        const auto line = socket->readLine(maxRequestSize + 1);
+        if (!line.endsWith('\n')) {
+            qWarning() << "IPC request too large. Closing the connection.";
+            socket->abort();
+            return;
+        }
+
+        if (!line.trimmed().isEmpty()) {
+            replies += handle(line);
+        }
+    }
+
+    if (socket->bytesAvailable() > maxRequestSize) {
+        qWarning() << "IPC request too large. Closing the connection.";
+        socket->abort();
+        return;
+    }
+
+    if (!replies.isEmpty()) {
+        socket->write(replies);
+    }
+}
+
+QByteArray IpcServer::handle(const QByteArray &line)
+{
+    QJsonParseError err;
+    const auto doc = QJsonDocument::fromJson(line, &err);
+    if (err.error != QJsonParseError::NoError) {
+        return errorReply({}, parse_error, err.errorString());
+    }
+
+    if (!doc.isObject()) {
+        return errorReply({}, invalid_request, QStringLiteral("Expected a JSON object"));
+    }
+
+    const auto req = doc.object();
+    const auto id = req.value("id");
+    const auto method = req.value("method").toString();
+    const auto params = req.value("params").toObject();
+
+    // Notifications (requests without an id) get no reply, not even an error
+    const bool notification = !req.contains("id");
+    const auto reply_error = [&](const int code, const QString& message) {
+        if (notification) {
+            qDebug() << "IPC notification " << method << " failed: " << message;
+            return QByteArray{};
+        }
+        return errorReply(id, code, message);
+    };
+
+    QJsonValue result;
+    QString error;
+    try {
+        if (method == QStringLiteral("lookup")) {
+            result = lookup(params, error);
+        } else if (method == QStringLiteral("journal.add")) {
+            result = addJournal(params, error);
+        } else if (method == QStringLiteral("actions")) {
+            result = actions(params, error);
+        } else {
+            return reply_error(method_not_found, QStringLiteral("Unknown method: %1").arg(method));
+        }
+    } catch(const std::exception& ex) {
+        qWarning() << "IPC request " << method << " failed: " << ex.what();
+        return reply_error(server_error, ex.what());
+    }
+
+    if (!error.isEmpty()) {
+        return reply_error(invalid_params, error);
+    }
+
+    if (notification) {
+        return {};
+    }
+
+    return toLine({{"result", result}}, id);
+}
+
+QJsonValue IpcServer::lookup(const QJsonObject &params, QString &error)
+{
+    const auto value = params.value("value").toString();
+    const auto type_value = params.value("type").toInt(-1);
+    if (params.contains("type")
+            && (type_value < 0 || static_cast<size_t>(type_value) >= GetChannelTypeEnums().size())) {
+        error = QStringLiteral("Invalid 'type'");
+        return {};
+    }
+    const auto type = params.contains("type") ? ToChannelType(type_value) : GuessChannelType(value);
+    const auto norm = NormalizeChannelValue(type, value);
+    if (norm.isEmpty()) {
+        error = QStringLiteral("Missing 'value'");
+        return {};
+    }
+
+    auto& db = Database::instance();
+    auto& query = db.query(QStringLiteral(
+        "SELECT ch.id, ch.type, ch.contact, c.contact FROM channel AS ch "
+        "JOIN contact AS c ON c.id = ch.contact "
+        "WHERE ch.type IN (?, ?) AND ch.norm = ? LIMIT ?"),
+        {static_cast<int>(type), static_cast<int>(GetMatchingChannelType(type)), norm, max_channels});
+    if (!query.isActive()) {
+        throw Database::Error(query.lastError().text());
+    }
+
+    // A channel belongs either to a company (or a private contact), or
+    // to a person in a company.
+    QJsonArray matches;
+    while(query.next()) {
+        const auto owner = query.value(2).toInt();
+        const auto parent = query.value(3).toInt();
+        const auto company = parent ? parent : owner;
+        const auto person = parent ? owner : 0;
+
+        matches.append(QJsonObject{
+            {"channel", query.value(0).toInt()},
+            {"type", query.value(1).toInt()},
+            {"contact", owner},
+            {"person", toId(person)},
+            {"company", company},
+            {"name", db.contactNames().name(owner)},
+            {"company_name", db.contactNames().name(company)}
+        });
+    }
+    query.finish();
+
+    return matches;
+}
+
+QJsonValue IpcServer::addJournal(const QJsonObject &params, QString &error)
+{
+    const auto contact = params.value("contact").toInt();
+    const auto person = params.value("person").toInt();
+    const auto text = params.value("text").toString();
+
+    if (!contact || text.isEmpty()) {
+        error = QStringLiteral("Expected 'contact' and 'text'");
+        return {};
+    }
+
+    auto& db = Database::instance();
+    if (!db.scalar(QStringLiteral("SELECT 1 FROM contact WHERE id = ?"), {contact}).toBool()) {
+        error = QStringLiteral("No such contact: %1").arg(contact);
+        return {};
+    }
+
+    if (person && db.scalar(QStringLiteral("SELECT contact FROM contact WHERE id = ?"),
+                            {person}).toInt() != contact) {
+        error = QStringLiteral("%1 is not a person in %2").arg(person).arg(contact);
+        return {};
+    }
+
+    auto& journal = JournalModel::instance();
+    auto rec = journal.record();
+    rec.setValue(journal.fieldIndex("type"), static_cast<int>(JournalModel::Type::GENERAL));
+    rec.setValue(journal.fieldIndex("text"), text);
+    rec.setValue(journal.fieldIndex("contact"), contact);
+    if (person) {
+        rec.setValue(journal.fieldIndex("person"), person);
+    }
+
+    if (!journal.addEntry(rec)) {
+        throw Database::Error("Failed to add the journal entry");
+    }
+
+    return QJsonObject{{"id", rec.value(journal.fieldIndex("id")).toInt()}};
+}
+
+QJsonValue IpcServer::actions(const QJsonObject &params, QString &error)
+{
+    const auto contact = params.value("contact").toInt();
+    if (!contact) {
+        error = QStringLiteral("Missing 'contact'");
+        return {};
+    }
+
+    // Open actions (not done, cancelled or failed) unless all is set
+    const bool all = params.value("all").toBool();
+    auto& query = Database::instance().query(all
+        ? QStringLiteral("SELECT id, name, state, intent, person, due_date FROM action "
+                         "WHERE contact = ? ORDER BY intent, sequence LIMIT ?")
+        : QStringLiteral("SELECT id, name, state, intent, person, due_date FROM action "
+                         "WHERE contact = ? AND state < ? ORDER BY intent, sequence LIMIT ?"),
+        all ? QVariantList{contact, max_actions}
+            : QVariantList{contact, static_cast<int>(ActionState::DONE), max_actions});
+    if (!query.isActive()) {
+        throw Database::Error(query.lastError().text());
+    }
+
+    QJsonArray list;
+    while(query.next()) {
+        list.append(QJsonObject{
+            {"id", query.value(0).toInt()},
+            {"name", query.value(1).toString()},
+            {"state", query.value(2).toInt()},
+            {"intent", toId(query.value(3))},
+            {"person", toId(query.value(4))},
+            {"due_date", query.value(5).isNull() ? QJsonValue() : QJsonValue(query.value(5).toLongLong())}
+        });
+    }
+    query.finish();
+
+    return list;
+}
@@ -0,0 +1,68 @@
+#ifndef IPCSERVER_H
+#define IPCSERVER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+
+class QLocalSocket;
+
+// Lets other local programs (mail filters, softphones) use the running
+// application's data, without opening the database file themselves.
+//
+// Clients connect to a local socket (a Unix domain socket, or a named pipe
+// on Windows) and send JSON-RPC 2.0 requests, one JSON object per line.
+// Each response is one line, and the responses come in the order of the
+// requests, so a client can send many requests without waiting for the
+// replies. Notifications (requests without an id) get no response, not
+// even when they fail. The requests are served on the main thread, with
+// the applications connection and its prepared statements and caches.
+//
+// Methods:
+//   lookup      {"value": "+47 22 33 44 55", "type": 3}
+//               Matches channels of the type (ChannelType) with the same
+//               normalized value (see NormalizeChannelValue()). The type is
+//               guessed from the value if not given; a handle needs its type.
+//               -> [{"channel", "type", "contact", "person", "company",
+//                    "name", "company_name"}]
+//   journal.add {"contact": 1, "person": 2, "text": "Called"} -> {"id"}
+//   actions     {"contact": 1, "all": false}
+//               -> [{"id", "name", "state", "intent", "person", "due_date"}]
+//
+// The socket is only accessible by the current user.
+class IpcServer : public QObject
+{
+    Q_OBJECT
+public:
+    // Requests longer than this close the connection
+    static constexpr int maxRequestSize = 64 * 1024;
+
+    explicit IpcServer(QObject *parent);
+
+    // Start listening on name. Removes a stale socket left by a crash.
+    bool listen(const QString& name);
+
+    // The socket path (or pipe name on Windows) to use if nothing is configured
+    static QString defaultName();
+
+    void close();
+
+    QString errorString() const { return server_.errorString(); }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    QByteArray handle(const QByteArray& line);
+    QJsonValue lookup(const QJsonObject& params, QString& error);
+    QJsonValue addJournal(const QJsonObject& params, QString& error);
+    QJsonValue actions(const QJsonObject& params, QString& error);
+
+    QLocalServer server_;
+};
+
+#endif // IPCSERVER_H
@@ -8,8 +8,9 @@
 #include <QSqlRecord>
 #include <QSqlField>
 #include <QDateTime>
+#include <QSqlDriver>
+#include <QStringList>
 
-#include "src/strategy.h"
 #include "src/intent.h"
 
 using namespace std;
@@ -17,15 +18,15 @@ using namespace std;
 JournalModel *JournalModel::instance_;
 
 JournalModel::JournalModel(QSettings &settings, QObject *parent, QSqlDatabase db)
-    : QSqlTableModel{parent, std::move(db)}
+    : QAbstractTableModel{parent}
     , settings_{settings}
+    , db_{db.isValid() ? std::move(db) : QSqlDatabase::database()}
 {
     Q_ASSERT(!instance_);
 
     instance_ = this;
 
-    setTable("journal");
-    setEditStrategy(QSqlTableModel::OnFieldChange);
+    rec_ = db_.record("journal");
 
     h_id_ = fieldIndex("id");
     h_type_ = fieldIndex("type");
@@ -50,21 +51,98 @@ JournalModel::JournalModel(QSettings &settings, QObject *parent, QSqlDatabase db
             && h_text_ > 0
          );
 
-    setSort(h_date_, Qt::AscendingOrder);
-    setFilter("id = -1"); // Filter everything away
+    QStringList columns;
+    for(int i = 0; i < rec_.count(); ++i) {
+        columns << db_.driver()->escapeIdentifier(rec_.fieldName(i), QSqlDriver::FieldName);
+    }
+    columns_ = columns.join(", ");
+
+    // Entries we added in a failed transaction are gone from the database
+    connect(&Database::instance(), &Database::rolledBack, this, &JournalModel::select);
 }
 
 void JournalModel::setContact(int id)
 {
-    setFilter(QStringLiteral("contact = %1").arg(id));
+    contact_ = id;
     select();
 }
 
+bool JournalModel::select()
+{
+    beginResetModel();
+    rows_.clear();
+    has_more_ = false;
+
+    bool ok = true;
+    if (contact_ > 0) {
+        // The first page is what the Log tab shows when switching contacts
+        auto& details = Database::instance().detailCache();
+        const auto key = QStringLiteral("journal %1").arg(pageSize);
+        auto cached = details.get(contact_, key, db_.driver());
+        if (cached.isActive()) {
+            while(cached.next()) {
+                const auto rec = cached.record();
+                QVector<QVariant> values;
+                values.reserve(rec.count());
+                for(int i = 0; i < rec.count(); ++i) {
+                    values << rec.value(i);
+                }
+                rows_ << values;
+            }
+        } else if ((ok = fetchPage(rows_))) {
+            RowSet page;
+            page.record = rec_;
+            page.rows = rows_;
+            details.put(contact_, key, std::move(page));
+        }
+
+        has_more_ = rows_.size() == pageSize;
+    }
 
-void JournalModel::addEntry(QSqlRecord& rec)
+    endResetModel();
+    return ok;
+}
+
+bool JournalModel::fetchPage(rows_t &rows) const
 {
-    Strategy strategy(*this, QSqlTableModel::OnManualSubmit);
+    // Keyset pagination on (date, id), newest first. Served by the
+    // (contact, date) index, which has the id (rowid) as its last key.
+    QString sql;
+    QVariantList args{contact_};
+
+    if (rows_.isEmpty()) {
+        sql = QStringLiteral("SELECT %1 FROM journal WHERE contact = ? "
+                             "ORDER BY date DESC, id DESC LIMIT ?").arg(columns_);
+    } else {
+        const auto& last = rows_.last();
+        const auto date = last.at(h_date_);
+        sql = QStringLiteral("SELECT %1 FROM journal WHERE contact = ? "
+                             "AND date <= ? AND (date < ? OR id < ?) "
+                             "ORDER BY date DESC, id DESC LIMIT ?").arg(columns_);
+        args << date << date << last.at(h_id_);
+    }
+    args << pageSize;
+
+    auto& query = Database::instance().query(sql, args);
+    if (!query.isActive()) {
+        return false;
+    }
+
+    while(query.next()) {
+        QVector<QVariant> values;
+        values.reserve(rec_.count());
+        for(int i = 0; i < rec_.count(); ++i) {
+            values << query.value(i);
+        }
+        rows << values;
+    }
+    query.finish();
 
+    return true;
+}
+
+bool JournalModel::addEntry(QSqlRecord& rec)
+{
     const auto now = static_cast<uint>(time(nullptr));
     rec.setValue(h_date_, now);
 
@@ -78,22 +156,52 @@ void JournalModel::addEntry(QSqlRecord& rec)
         << " : " << (rec.isNull(i) ? QStringLiteral("NULL") : rec.value(i).toString());
     }
 
-    if (!insertRecord(-1, rec)) {
-        qWarning() << "Failed to add new journal (insertRecord): "
-                   << lastError().text();
-        return;
+    rec.setGenerated(h_id_, false);
+
+    QVariantList args;
+    for(int i = 0; i < rec.count(); ++i) {
+        if (rec.isGenerated(i)) {
+            args << rec.value(i);
+        }
     }
 
-    if (!submitAll()) {
-        qWarning() << "Failed to add new journal (submitAll): "
-                   << lastError().text();
-        return;
+    const auto sql = db_.driver()->sqlStatement(
+                QSqlDriver::InsertStatement, "journal", rec, true);
+    auto& query = Database::instance().query(sql, args);
+    if (!query.isActive()) {
+        qWarning() << "Failed to add new journal entry";
+        return false;
+    }
+
+    rec.setValue(h_id_, query.lastInsertId());
+
+    if (!rec.isNull(h_contact_) && (rec.value(h_contact_).toInt() == contact_)) {
+        // One of our rows. It's the newest, so it goes on top.
+        QVector<QVariant> values;
+        values.reserve(rec.count());
+        for(int i = 0; i < rec.count(); ++i) {
+            values << rec.value(i);
+        }
+
+        beginInsertRows({}, 0, 0);
+        rows_.prepend(values);
+        endInsertRows();
+    }
+
+    // Every change is journaled, so this is where cached details go stale
+    auto& details = Database::instance().detailCache();
+    if (!rec.isNull(h_contact_)) {
+        details.invalidate(rec.value(h_contact_).toInt());
+    }
+    if (!rec.isNull(h_person_)) {
+        details.invalidate(rec.value(h_person_).toInt());
     }
 
     qDebug() << "Created new log entry";
+    return true;
 }
 
-void JournalModel::addEntry(const JournalModel::Type type, const QString &text,
+bool JournalModel::addEntry(const JournalModel::Type type, const QString &text,
                       const int contact, const int person,
                       const int intent, const int activity,
                       const int document)
@@ -117,7 +225,7 @@ void JournalModel::addEntry(const JournalModel::Type type, const QString &text,
     if (document > 0)
         rec.setValue(h_document_, document);
 
-    addEntry(rec);
+    return addEntry(rec);
 }
 
 const QIcon &JournalModel::getLogIcon(int type) const
@@ -143,34 +251,75 @@ const QIcon &JournalModel::getLogIcon(int type) const
     return icons.at(static_cast<size_t>(type));
 }
 
+int JournalModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows_.size();
+}
+
+int JournalModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rec_.count();
+}
+
 QVariant JournalModel::data(const QModelIndex &ix, int role) const
 {
-    if (ix.isValid()) {
-        if (role == Qt::DisplayRole) {
-            if (ix.column() == h_date_) {
-                const auto when = QDateTime::fromTime_t(QSqlTableModel::data(ix, Qt::DisplayRole).toLongLong());
-                return when.toString("yyyy-MM-dd hh:mm");
-            }
-        } else if (role == Qt::DecorationRole) {
-            if (ix.column() == h_type_) {
-                return getLogIcon(std::max(0, QSqlTableModel::data(ix, Qt::DisplayRole).toInt()));
-            }
+    if (!ix.isValid() || ix.row() >= rows_.size() || ix.column() >= rec_.count()) {
+        return {};
+    }
 
-            if (ix.column() == h_date_) {
-                return getLogIcon(std::max(0, QSqlTableModel::data(index(ix.row(), h_type_, {}), Qt::DisplayRole).toInt()));
-            }
+    const auto& row = rows_.at(ix.row());
+
+    if (role == Qt::DisplayRole) {
+        if (ix.column() == h_date_) {
+            const auto when = QDateTime::fromTime_t(row.at(h_date_).toLongLong());
+            return when.toString("yyyy-MM-dd hh:mm");
+        }
+        return row.at(ix.column());
+    } else if (role == Qt::EditRole) {
+        return row.at(ix.column());
+    } else if (role == Qt::DecorationRole) {
+        if (ix.column() == h_type_ || ix.column() == h_date_) {
+            return getLogIcon(std::max(0, row.at(h_type_).toInt()));
         }
     }
 
-    return QSqlTableModel::data(ix, role);
+    return {};
 }
 
 QVariant JournalModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
-        auto name = QSqlTableModel::headerData(section, orientation, role).toString();
+    if (role == Qt::DisplayRole && orientation == Qt::Horizontal
+            && section >= 0 && section < rec_.count()) {
+        auto name = rec_.fieldName(section);
         name[0] = name[0].toUpper();
         return name;
     }
-    return QSqlTableModel::headerData(section, orientation, role);
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool JournalModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && has_more_;
+}
+
+void JournalModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+
+    rows_t page;
+    if (!fetchPage(page)) {
+        has_more_ = false;
+        return;
+    }
+
+    has_more_ = page.size() == pageSize;
+    if (page.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows({}, rows_.size(), rows_.size() + page.size() - 1);
+    rows_ += page;
+    endInsertRows();
 }
@@ -2,7 +2,9 @@
 #define LOGMODEL_H
 
 #include <QSettings>
-#include <QSqlTableModel>
+#include <QAbstractTableModel>
+#include <QSqlRecord>
+#include <QVector>
 #include <QImage>
 #include <QMetaType>
 #include <QSqlDatabase>
@@ -13,7 +15,13 @@
 #define DEF_COLUMN(name) Q_PROPERTY(int name ## _col MEMBER h_ ## name ## _)
 
 
-class JournalModel : public QSqlTableModel
+// The journal for one contact, newest first.
+//
+// The journal can be long, so it is loaded in pages, keyed on the
+// (date, id) of the last row we have, as the view scrolls down
+// (canFetchMore() / fetchMore()). The first page is kept in the
+// DetailCache. The model is read-only; entries are added with addEntry().
+class JournalModel : public QAbstractTableModel
 {
     Q_OBJECT
 public:
@@ -35,6 +43,8 @@ public:
         DELETED_SOMETHING,
     };
 
+    static constexpr int pageSize = 200;
+
     JournalModel(QSettings& settings, QObject *parent, QSqlDatabase db);
 
     DEF_COLUMN(id)
@@ -50,22 +60,37 @@ public:
 
     void setContact(int id);
 
+    // An empty record for the journal table
+    QSqlRecord record() const { return rec_; }
+    int fieldIndex(const QString& name) const { return rec_.indexOf(name); }
+
     static JournalModel& instance() {
         Q_ASSERT(instance_);
         return *instance_;
     }
 
 public slots:
-    void addEntry(QSqlRecord& rec); // Will modify rec
+    // Reload, starting with the newest page
+    bool select();
+
+    bool addEntry(QSqlRecord& rec); // Will modify rec
     //void addContactLog(const int contact, const Type type, const QString& text);
-    void addEntry(const Type type, const QString& text,
+    bool addEntry(const Type type, const QString& text,
                 const int contact, const int person = 0, const int intent = 0,
                 const int activity = 0, const int document = 0);
 
 private:
+    using rows_t = QVector<QVector<QVariant>>;
+
     const QIcon& getLogIcon(int type) const;
 
+    // Read the page after the last row we have
+    bool fetchPage(rows_t& rows) const;
+
     QSettings& settings_;
+    QSqlDatabase db_;
+    QSqlRecord rec_;
+    QString columns_;
     static JournalModel *instance_;
 
     int h_id_ = {};
@@ -79,10 +104,18 @@ private:
     int h_document_ = {};
     int h_text_ = {};
 
+    int contact_ = -1;
+    rows_t rows_;
+    bool has_more_ = false;
+
     // QAbstractItemModel interface
 public:
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 };
 
 
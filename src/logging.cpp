@@ -2,10 +2,9 @@
 #include <iostream>
 #include <assert.h>
 #include <array>
-#include <QTextStream>
+#include <chrono>
 #include <QDateTime>
 #include <QDebug>
-#include <QMessageBox>
 
 using namespace std;
 
@@ -14,6 +13,8 @@ Logging *Logging::instance_ = {};
 Logging::Logging()
 {
     assert(!instance_);
+    changed();
+    writer_ = thread([this] { writer(); });
     instance_ = this;
 }
 
@@ -21,6 +22,11 @@ Logging::~Logging()
 {
     assert(instance_);
     instance_ = {};
+
+    // The writer drains the queue before it exits
+    done_ = true;
+    wake_.notify_one();
+    writer_.join();
 }
 
 void Logging::logMessageHandler(QtMsgType type,
@@ -36,68 +42,142 @@ void Logging::onLogMessageHandler(QtMsgType type,
                                   const QMessageLogContext &context,
                                   const QString &msg)
 {
-    array<QString, 6> message_types = {{
+    static const array<QString, 6> message_types = {{
         "debug", "warn", "error", "fatal", "info", "system"
     }};
 
-    const auto now = QDateTime::currentDateTime().toString("yyyy-HH-mm HH:mm.zzz");
-
-    if (settings_.value("log-enabled", false).toBool()) {
-
-        if (!logFile_) {
-            open();
-        }
+    const bool to_file = log_enabled_;
+
+    Entry entry;
+    entry.to_file = to_file;
+    entry.text = QDateTime::currentDateTime().toString(QStringLiteral("yyyy-MM-dd HH:mm:ss.zzz"))
+            + ' '
+            + message_types.at(type)
+            + ' '
+            + (context.function ? QString::fromUtf8(context.function) : QStringLiteral("[no context]"))
+            + ' '
+            + msg;
+
+    if (queue_.push(move(entry))) {
+        ++queued_;
+        wake_.notify_one();
+    } else {
+        ++dropped_;
+    }
 
-        QTextStream stream(logFile_.get());
-
-        stream
-            << now
-            << ' '
-            << message_types.at(type)
-            << ' '
-            << (context.function ? context.function : "[no context]")
-            << ' '
-            << msg
-            << '\n';
-
-        if (type >= QtWarningMsg && context.function != nullptr) {
-//            QMessageBox::warning(nullptr, message_types.at(type),
-//                                 msg);
-            emit message(message_types.at(type), msg);
-        }
+    if (to_file && type >= QtWarningMsg && context.function != nullptr) {
+        emit message(message_types.at(type), msg);
     }
 
-    if (cout.good()) {
+    if (type == QtFatalMsg) {
+        // Qt aborts when we return
+        flush();
+    }
+}
 
-        cout << now.toStdString()
-             << ' '
-             << message_types.at(type).toStdString()
-             << ' '
-             << (context.function ? context.function : "[no context]")
-             << ' '
-             << msg.toStdString()
-             << endl;
+void Logging::flush()
+{
+    const auto target = queued_.load();
+    wake_.notify_one();
+    while(written_ < target && writer_.joinable()
+          && this_thread::get_id() != writer_.get_id()) {
+        this_thread::sleep_for(chrono::milliseconds(1));
     }
 }
 
 void Logging::changed()
 {
-    if (settings_.value("log-enabled", false).toBool()) {
-        open();
-    } else if (logFile_){
+    {
+        lock_guard<mutex> lock(config_mutex_);
+        log_path_ = settings_.value("log-path", "f-crm.log").toString();
+        log_append_ = settings_.value("log-append", false).toBool();
+    }
+
+    log_enabled_ = settings_.value("log-enabled", false).toBool();
+
+    // The writer thread owns the file
+    reopen_ = true;
+    wake_.notify_one();
+}
+
+void Logging::writer()
+{
+    Entry entry;
+    QByteArray console, file;
+
+    for(;;) {
+        if (reopen_.exchange(false)) {
+            if (log_enabled_) {
+                open();
+            } else if (logFile_) {
+                qDebug() << "Closing the log-file";
+                logFile_.reset();
+            }
+        }
+
+        console.clear();
+        file.clear();
+        int count = 0;
+        for(; count < maxBatch && queue_.pop(entry); ++count) {
+            auto line = entry.text.toUtf8();
+            line += '\n';
+            if (entry.to_file) {
+                file += line;
+            }
+            console += line;
+        }
+
+        if (const auto dropped = dropped_.exchange(0)) {
+            const auto line = QStringLiteral("Logging: Dropped %1 messages (queue full)\n")
+                    .arg(dropped).toUtf8();
+            file += line;
+            console += line;
+        }
+
+        if (!file.isEmpty() && logFile_ && logFile_->isOpen()) {
+            logFile_->write(file);
+            logFile_->flush();
+        }
+
+        if (!console.isEmpty() && cout.good()) {
+            cout.write(console.constData(), console.size());
+            cout.flush();
+        }
+
+        written_ += count;
+
+        if (count) {
+            continue;
+        }
 
-        qDebug() << "Closing the log-file";
-        logFile_->reset();
+        if (done_) {
+            break;
+        }
+
+        // Producers don't take the mutex when they notify, so a wake-up can
+        // be missed. The timeout bounds how long a message can wait.
+        unique_lock<mutex> lock(wake_mutex_);
+        wake_.wait_for(lock, chrono::milliseconds(100), [this] {
+            return done_ || reopen_ || !queue_.empty();
+        });
     }
 
+    logFile_.reset();
 }
 
 void Logging::open()
 {
-    const auto path = settings_.value("log-path", "f-crm.log").toString();
+    QString path;
+    bool append = false;
+    {
+        lock_guard<mutex> lock(config_mutex_);
+        path = log_path_;
+        append = log_append_;
+    }
+
     QIODevice::OpenMode options = QIODevice::WriteOnly;
     QString mode = "truncate";
-    if (settings_.value("log-append", false).toBool()) {
+    if (append) {
         options |= QIODevice::Append;
         mode = "append";
     } else {
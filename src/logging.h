@@ -1,11 +1,24 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <QFile>
 #include <QSettings>
 
+#include "ringbuffer.h"
+
+// Log backend.
+//
+// The message handler only formats the line and pushes it to a
+// lock-free queue. A writer thread takes the lines off the queue in
+// batches and writes them to the console and the log-file. If the
+// queue is full, messages are dropped (and counted) instead of blocking
+// the caller. The queue is drained when the logger goes away.
 class Logging : public QObject
 {
     Q_OBJECT
@@ -25,6 +38,9 @@ public:
         return instance_;
     }
 
+    // Wait until everything logged so far is written
+    void flush();
+
 public slots:
     // Re-open the log-file, applying the current settings
     void changed();
@@ -33,11 +49,38 @@ signals:
     void message(const QString& label, const QString& text);
 
 private:
+    struct Entry {
+        QString text;
+        bool to_file = false;
+    };
+
+    static constexpr size_t queueSize = 4096;
+    static constexpr int maxBatch = 256;
+
+    void writer();
     void open();
 
+    // Owned by the writer thread
     std::unique_ptr<QFile> logFile_;
+
     static Logging *instance_;
     QSettings settings_;
+
+    // Cached settings, updated by changed()
+    std::atomic<bool> log_enabled_{false};
+    std::mutex config_mutex_;
+    QString log_path_;
+    bool log_append_ = false;
+
+    RingBuffer<Entry, queueSize> queue_;
+    std::atomic<quint64> queued_{0};
+    std::atomic<quint64> written_{0};
+    std::atomic<quint64> dropped_{0};
+    std::atomic<bool> reopen_{false};
+    std::atomic<bool> done_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::thread writer_;
 };
 
 #endif // LOGGING_H
@@ -0,0 +1,724 @@
+#include "src/mailingester.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QTextCodec>
+#include <QUrl>
+
+#include "src/channel.h"
+#include "src/database.h"
+#include "src/document.h"
+#include "src/journalmodel.h"
+#include "src/utility.h"
+
+namespace {
+
+// Emit progress this often (messages)
+constexpr int progress_every = 1000;
+
+// Don't look further than this for the end of the headers
+constexpr qint64 max_header_size = 256 * 1024;
+
+// The headers we use. The values are raw (folded lines joined).
+struct MailHeaders
+{
+    QByteArray message_id;
+    QByteArray from;
+    QByteArray to;
+    QByteArray cc;
+    QByteArray subject;
+    QByteArray date;
+};
+
+bool isFromLine(const char *data, const qint64 pos, const qint64 size)
+{
+    return size - pos >= 5 && memcmp(data + pos, "From ", 5) == 0;
+}
+
+// The start of the line after pos
+qint64 nextLine(const char *data, const qint64 pos, const qint64 size)
+{
+    const auto eol = static_cast<const char *>(memchr(data + pos, '\n', static_cast<size_t>(size - pos)));
+    return eol ? (eol - data) + 1 : size;
+}
+
+// The start of the next "From " line after pos, or size
+qint64 findFromLine(const char *data, qint64 pos, const qint64 size)
+{
+    while(pos < size) {
+        pos = nextLine(data, pos, size);
+        if (isFromLine(data, pos, size)) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+bool isHeader(const char *name, const qint64 len, const char *wanted)
+{
+    return static_cast<size_t>(len) == strlen(wanted) && qstrnicmp(name, wanted, static_cast<uint>(len)) == 0;
+}
+
+// Parse the header block at the start of a message.
+// Returns the size of the header block.
+qint64 parseHeaders(const char *begin, const char *end, MailHeaders& headers)
+{
+    const char *limit = (end - begin > max_header_size) ? begin + max_header_size : end;
+    QByteArray *current = nullptr;
+    const char *p = begin;
+
+    while(p < limit) {
+        auto eol = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(limit - p)));
+        if (!eol) {
+            eol = limit;
+        }
+        const char *line_end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+
+        if (line_end == p) {
+            // The empty line between the headers and the body
+            p = std::min(eol + 1, limit);
+            break;
+        }
+
+        if (*p == ' ' || *p == '\t') {
+            // Folded; continues the previous header
+            if (current) {
+                current->append(' ').append(p, static_cast<int>(line_end - p));
+            }
+        } else {
+            current = nullptr;
+            const auto colon = static_cast<const char *>(memchr(p, ':', static_cast<size_t>(line_end - p)));
+            if (colon) {
+                const auto len = colon - p;
+                if (isHeader(p, len, "from")) {
+                    current = &headers.from;
+                } else if (isHeader(p, len, "to")) {
+                    current = &headers.to;
+                } else if (isHeader(p, len, "cc")) {
+                    current = &headers.cc;
+                } else if (isHeader(p, len, "subject")) {
+                    current = &headers.subject;
+                } else if (isHeader(p, len, "date")) {
+                    current = &headers.date;
+                } else if (isHeader(p, len, "message-id")) {
+                    current = &headers.message_id;
+                }
+
+                if (current) {
+                    if (!current->isEmpty()) {
+                        current->append(", ");
+                    }
+                    current->append(colon + 1, static_cast<int>(line_end - colon - 1));
+                }
+            }
+        }
+
+        p = eol + 1;
+    }
+
+    return std::min(p, limit) - begin;
+}
+
+// Decode RFC 2047 encoded words, like "=?UTF-8?B?...?="
+QString decodeHeader(const QByteArray& raw)
+{
+    QString out;
+    int pos = 0;
+    bool after_word = false;
+
+    while(pos < raw.size()) {
+        const auto start = raw.indexOf("=?", pos);
+        const auto q1 = start < 0 ? -1 : raw.indexOf('?', start + 2);
+        const auto q2 = q1 < 0 ? -1 : raw.indexOf('?', q1 + 1);
+        const auto stop = q2 < 0 ? -1 : raw.indexOf("?=", q2 + 1);
+        if (stop < 0 || q2 != q1 + 2) {
+            out += QString::fromUtf8(raw.mid(pos));
+            break;
+        }
+
+        // Whitespace between two encoded words is not part of the text
+        const auto between = raw.mid(pos, start - pos);
+        if (!after_word || !between.trimmed().isEmpty()) {
+            out += QString::fromUtf8(between);
+        }
+
+        auto charset = raw.mid(start + 2, q1 - start - 2);
+        const auto language = charset.indexOf('*');
+        if (language >= 0) {
+            charset.truncate(language);
+        }
+
+        auto text = raw.mid(q2 + 1, stop - q2 - 1);
+        QByteArray bytes;
+        if (raw.at(q1 + 1) == 'B' || raw.at(q1 + 1) == 'b') {
+            bytes = QByteArray::fromBase64(text);
+        } else {
+            text.replace('_', ' ');
+            bytes = QByteArray::fromPercentEncoding(text, '=');
+        }
+
+        const auto codec = QTextCodec::codecForName(charset);
+        out += codec ? codec->toUnicode(bytes) : QString::fromLatin1(bytes);
+        pos = stop + 2;
+        after_word = true;
+    }
+
+    return out.simplified();
+}
+
+// Append the email addresses in a header value to addresses, normalized
+void extractAddresses(const QByteArray& value, QStringList& addresses)
+{
+    static const char *local_chars = ".!#$%&'*+/=?^_`{|}~-";
+    const auto isLocal = [](const char ch) {
+        return isalnum(static_cast<unsigned char>(ch)) || (ch && strchr(local_chars, ch));
+    };
+    const auto isDomain = [](const char ch) {
+        return isalnum(static_cast<unsigned char>(ch)) || ch == '.' || ch == '-';
+    };
+
+    for(int at = value.indexOf('@'); at >= 0; at = value.indexOf('@', at + 1)) {
+        int begin = at;
+        while(begin > 0 && isLocal(value.at(begin - 1))) {
+            --begin;
+        }
+        int end = at + 1;
+        while(end < value.size() && isDomain(value.at(end))) {
+            ++end;
+        }
+        if (begin == at || end == at + 1) {
+            continue;
+        }
+
+        const auto address = NormalizeChannelValue(
+                    ChannelType::EMAIL, QString::fromLatin1(value.mid(begin, end - begin)));
+        if (!addresses.contains(address)) {
+            addresses << address;
+        }
+    }
+}
+
+QDateTime parseDate(const QByteArray& value)
+{
+    // "Tue, 15 Nov 1994 08:12:31 +0100 (CET)"
+    auto text = QString::fromLatin1(value).simplified();
+    const auto comment = text.indexOf('(');
+    if (comment > 0) {
+        text.truncate(comment);
+    }
+    return QDateTime::fromString(text.trimmed(), Qt::RFC2822Date);
+}
+
+} // anonymous namespace
+
+QString MailIngestSummary::text() const
+{
+    return QStringLiteral("Read %1 messages in %2 files (%3 files unchanged). "
+                          "%4 messages were already there. "
+                          "Linked %5 messages to contacts, as %6 documents.")
+            .arg(messages).arg(files).arg(unchanged).arg(known).arg(linked).arg(documents);
+}
+
+MailIngestWorker::MailIngestWorker(const QString &dbpath, const std::atomic_bool &cancelled)
+    : connection_{QStringLiteral("mail"), dbpath}, cancelled_{cancelled}
+{
+}
+
+void MailIngestWorker::run(const QStringList &paths, int contact, int person)
+{
+    summary_ = {};
+    committed_ = {};
+    target_ = {contact, person};
+    in_batch_ = 0;
+    mbox_path_.clear();
+    owners_.clear();
+
+    if (!open() || !prepare() || !loadSources()) {
+        summary_.error = QStringLiteral("Failed to prepare the database for the mail");
+        emit finished(summary_);
+        return;
+    }
+
+    db_.transaction();
+    for(const auto& path : paths) {
+        if (!ingestPath(path)) {
+            db_.rollback();
+            journal_date_.clear();
+            journal_contact_.clear();
+            journal_person_.clear();
+            journal_document_.clear();
+            journal_text_.clear();
+
+            // Only what is committed counts
+            auto result = committed_;
+            result.cancelled = summary_.cancelled;
+            result.error = summary_.error;
+            if (!result.cancelled && result.error.isEmpty()) {
+                result.error = QStringLiteral("Failed to read the mail in %1").arg(path);
+            }
+            emit finished(result);
+            return;
+        }
+    }
+
+    if (!commit(false)) {
+        summary_ = committed_;
+        summary_.error = QStringLiteral("Failed to commit the mail");
+    }
+
+    qDebug() << "Mail: " << summary_.messages << " messages in " << summary_.files << " files";
+    emit progress(summary_.files, summary_.messages);
+    emit finished(summary_);
+}
+
+bool MailIngestWorker::open()
+{
+    db_ = connection_.open();
+    return db_.isValid();
+}
+
+bool MailIngestWorker::prepare()
+{
+    if (prepared_) {
+        return true;
+    }
+
+    mark_ingested_ = QSqlQuery(db_);
+    find_owners_ = QSqlQuery(db_);
+    insert_document_ = QSqlQuery(db_);
+    save_source_ = QSqlQuery(db_);
+
+    if (!mark_ingested_.prepare(
+                QStringLiteral("insert or ignore into ingested_mail (message_id) values (?)"))
+            || !find_owners_.prepare(
+                QStringLiteral("select ch.contact, c.contact from channel as ch "
+                               "join contact as c on c.id = ch.contact "
+                               "where ch.norm = ? and ch.type = ?"))
+            || !insert_document_.prepare(
+                QStringLiteral("insert into document (contact, person, type, cls, direction, entity, "
+                               "name, notes, added_date, file_date, location) "
+                               "values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"))
+            || !save_source_.prepare(
+                QStringLiteral("insert or replace into mail_source (path, size, mtime, offset) "
+                               "values (?, ?, ?, ?)"))) {
+        qWarning() << "Mail: Failed to prepare statements: " << mark_ingested_.lastError().text()
+                   << find_owners_.lastError().text() << insert_document_.lastError().text()
+                   << save_source_.lastError().text();
+        return false;
+    }
+
+    prepared_ = true;
+    return true;
+}
+
+bool MailIngestWorker::loadSources()
+{
+    sources_.clear();
+
+    QSqlQuery query(db_);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("select path, size, mtime, offset from mail_source"))) {
+        qWarning() << "Mail: Failed to read the mail sources: " << query.lastError().text();
+        return false;
+    }
+
+    while(query.next()) {
+        Source source;
+        source.size = query.value(1).isNull() ? -1 : query.value(1).toLongLong();
+        source.mtime = query.value(2).isNull() ? -1 : query.value(2).toLongLong();
+        source.offset = query.value(3).toLongLong();
+        sources_.insert(query.value(0).toString(), source);
+    }
+
+    return true;
+}
+
+bool MailIngestWorker::ingestPath(const QString &path)
+{
+    const QFileInfo fi{path};
+    if (!fi.isDir()) {
+        return ingestFile(fi.absoluteFilePath());
+    }
+
+    // Maildir++ sub-folders are hidden directories
+    QDirIterator it(fi.absoluteFilePath(), QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        if (cancelled()) {
+            return false;
+        }
+
+        const auto file = it.next();
+
+        // Maildir messages that are still being delivered
+        if (it.fileInfo().dir().dirName() == QStringLiteral("tmp")) {
+            continue;
+        }
+
+        if (!ingestFile(file)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MailIngestWorker::ingestFile(const QString &path)
+{
+    const QFileInfo fi{path};
+    const auto size = fi.size();
+    const auto mtime = fi.lastModified().toMSecsSinceEpoch();
+
+    const auto known = sources_.value(path);
+    if (known.size == size && known.mtime == mtime) {
+        ++summary_.unchanged;
+        return true;
+    }
+
+    if (size == 0) {
+        return true;
+    }
+
+    // One message per file
+    const auto dir = fi.dir().dirName();
+    const bool single = path.endsWith(QStringLiteral(".eml"), Qt::CaseInsensitive)
+            || dir == QStringLiteral("cur") || dir == QStringLiteral("new");
+
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Mail: Failed to open " << path << ": " << file.errorString();
+        return true;
+    }
+
+    const auto map = file.map(0, size);
+    if (!map) {
+        qWarning() << "Mail: Failed to map " << path << ": " << file.errorString();
+        return true;
+    }
+    const auto data = reinterpret_cast<const char *>(map);
+
+    if (!single && !isFromLine(data, 0, size)) {
+        return true; // Not an mbox
+    }
+
+    ++summary_.files;
+    const bool ok = single
+            ? ingestMessage(data, data + size, fi.absoluteFilePath())
+            : ingestMbox(data, size, path);
+    mbox_path_.clear();
+
+    if (!ok) {
+        return false;
+    }
+
+    Source source;
+    source.size = size;
+    source.mtime = mtime;
+    source.offset = size;
+    return saveSource(path, source);
+}
+
+bool MailIngestWorker::ingestMbox(const char *data, const qint64 size, const QString &path)
+{
+    // Continue where the last run stopped, if the file was only appended to
+    const auto known = sources_.value(path);
+    qint64 pos = 0;
+    if (known.offset > 0 && known.offset <= size
+            && (known.offset == size
+                || (data[known.offset - 1] == '\n' && isFromLine(data, known.offset, size)))) {
+        pos = known.offset;
+    }
+
+    mbox_path_ = path;
+    while(pos < size) {
+        if (cancelled()) {
+            return false;
+        }
+
+        const auto headers = nextLine(data, pos, size); // Skip the "From " line
+        const auto next = findFromLine(data, headers, size);
+        mbox_offset_ = next;
+        if (!ingestMessage(data + headers, data + next, {})) {
+            return false;
+        }
+        pos = next;
+    }
+
+    return true;
+}
+
+bool MailIngestWorker::ingestMessage(const char *begin, const char *end, const QString &location)
+{
+    ++summary_.messages;
+    if ((summary_.messages % progress_every) == 0) {
+        emit progress(summary_.files, summary_.messages);
+    }
+
+    MailHeaders headers;
+    const auto header_size = parseHeaders(begin, end, headers);
+
+    auto id = headers.message_id.trimmed();
+    const auto lt = id.indexOf('<');
+    const auto gt = id.indexOf('>', lt + 1);
+    if (lt >= 0 && gt > lt) {
+        id = id.mid(lt + 1, gt - lt - 1);
+    }
+    const bool has_id = !id.isEmpty();
+    if (!has_id) {
+        id = "sha1:" + QCryptographicHash::hash(
+                    QByteArray::fromRawData(begin, static_cast<int>(header_size)),
+                    QCryptographicHash::Sha1).toHex();
+    }
+
+    mark_ingested_.addBindValue(QString::fromLatin1(id));
+    if (!mark_ingested_.exec()) {
+        qWarning() << "Mail: Failed to add " << id << ": " << mark_ingested_.lastError().text();
+        return false;
+    }
+
+    if (mark_ingested_.numRowsAffected() == 0 && !target_.contact) {
+        ++summary_.known;
+        return true;
+    }
+
+    QStringList from, recipients;
+    extractAddresses(headers.from, from);
+    extractAddresses(headers.to, recipients);
+    extractAddresses(headers.cc, recipients);
+
+    // The contacts that get the message. It is incoming if it was
+    // sent by one of them.
+    QVector<Owner> targets;
+    bool incoming = false;
+    const auto add = [&targets](const Owner& owner) {
+        for(const auto& existing : targets) {
+            if (existing.contact == owner.contact) {
+                return;
+            }
+        }
+        targets << owner;
+    };
+
+    if (target_.contact) {
+        targets << target_;
+        for(const auto& address : from) {
+            for(const auto& owner : owners(address)) {
+                incoming = incoming || owner.contact == target_.contact;
+            }
+        }
+    } else {
+        for(const auto& address : from) {
+            for(const auto& owner : owners(address)) {
+                add(owner);
+            }
+        }
+        incoming = !targets.isEmpty();
+        for(const auto& address : recipients) {
+            for(const auto& owner : owners(address)) {
+                add(owner);
+            }
+        }
+    }
+
+    if (!targets.isEmpty()) {
+        ++summary_.linked;
+
+        auto subject = decodeHeader(headers.subject);
+        if (subject.isEmpty()) {
+            subject = QStringLiteral("(no subject)");
+        }
+
+        auto notes = QStringLiteral("From: %1\nTo: %2").arg(decodeHeader(headers.from),
+                                                             decodeHeader(headers.to));
+        if (!headers.cc.isEmpty()) {
+            notes += QStringLiteral("\nCc: %1").arg(decodeHeader(headers.cc));
+        }
+
+        // A message in an mbox is opened in the mail app by its Message-ID (RFC 2392)
+        auto url = location;
+        if (url.isEmpty()) {
+            url = has_id ? QStringLiteral("mid:%1").arg(QString::fromLatin1(QUrl::toPercentEncoding(
+                                                            QString::fromLatin1(id), "@")))
+                         : mbox_path_;
+        }
+
+        const auto now = static_cast<uint>(time(nullptr));
+        const auto date = parseDate(headers.date);
+        const auto direction = incoming ? Document::Direction::INCOMING : Document::Direction::OUTGOING;
+        const auto text = QStringLiteral("%1 email: %2").arg(Document::directionName(direction), subject);
+
+        for(const auto& owner : targets) {
+            insert_document_.addBindValue(owner.contact);
+            insert_document_.addBindValue(NullIfZero(owner.person));
+            insert_document_.addBindValue(static_cast<int>(Document::Type::EMAIL));
+            insert_document_.addBindValue(static_cast<int>(Document::Class::NOTE));
+            insert_document_.addBindValue(static_cast<int>(direction));
+            insert_document_.addBindValue(static_cast<int>(owner.person ? Document::Entity::PERSON
+                                                                        : Document::Entity::CONTACT));
+            insert_document_.addBindValue(subject);
+            insert_document_.addBindValue(notes);
+            insert_document_.addBindValue(now);
+            insert_document_.addBindValue(date.isValid() ? QVariant{date.toTime_t()} : QVariant{QVariant::UInt});
+            insert_document_.addBindValue(url);
+            if (!insert_document_.exec()) {
+                qWarning() << "Mail: Failed to add document: " << insert_document_.lastError().text();
+                return false;
+            }
+
+            journal_date_ << (date.isValid() ? date.toTime_t() : now);
+            journal_contact_ << owner.contact;
+            journal_person_ << NullIfZero(owner.person);
+            journal_document_ << insert_document_.lastInsertId();
+            journal_text_ << text;
+            ++summary_.documents;
+        }
+    }
+
+    if (++in_batch_ >= batchSize) {
+        return commit(true);
+    }
+
+    return true;
+}
+
+const QVector<MailIngestWorker::Owner> &MailIngestWorker::owners(const QString &address)
+{
+    auto it = owners_.find(address);
+    if (it != owners_.end()) {
+        return *it;
+    }
+
+    QVector<Owner> found;
+    find_owners_.addBindValue(address);
+    find_owners_.addBindValue(static_cast<int>(ChannelType::EMAIL));
+    if (find_owners_.exec()) {
+        while(find_owners_.next()) {
+            // A channel belongs to a contact, or to a person in a company
+            const auto channel_owner = find_owners_.value(0).toInt();
+            const auto parent = find_owners_.value(1).toInt();
+            Owner owner;
+            owner.contact = parent ? parent : channel_owner;
+            owner.person = parent ? channel_owner : 0;
+            found << owner;
+        }
+        find_owners_.finish();
+    } else {
+        qWarning() << "Mail: Failed to look up " << address << ": " << find_owners_.lastError().text();
+    }
+
+    return *owners_.insert(address, found);
+}
+
+bool MailIngestWorker::saveSource(const QString &path, const Source &source)
+{
+    save_source_.addBindValue(path);
+    save_source_.addBindValue(source.size < 0 ? QVariant{QVariant::LongLong} : QVariant{source.size});
+    save_source_.addBindValue(source.mtime < 0 ? QVariant{QVariant::LongLong} : QVariant{source.mtime});
+    save_source_.addBindValue(source.offset);
+    if (!save_source_.exec()) {
+        qWarning() << "Mail: Failed to save " << path << ": " << save_source_.lastError().text();
+        return false;
+    }
+
+    sources_.insert(path, source);
+    return true;
+}
+
+bool MailIngestWorker::commit(bool more)
+{
+    // Half way through an mbox; the next run continues from here.
+    // No size or time, so it is not taken as done.
+    if (!mbox_path_.isEmpty()) {
+        Source source;
+        source.offset = mbox_offset_;
+        if (!saveSource(mbox_path_, source)) {
+            return false;
+        }
+    }
+
+    if (!flush() || !db_.commit()) {
+        qWarning() << "Mail: Failed to commit: " << db_.lastError().text();
+        db_.rollback();
+        return false;
+    }
+
+    committed_ = summary_;
+    in_batch_ = 0;
+    emit progress(summary_.files, summary_.messages);
+
+    if (more) {
+        db_.transaction();
+    }
+    return true;
+}
+
+bool MailIngestWorker::flush()
+{
+    if (journal_date_.isEmpty()) {
+        return true;
+    }
+
+    QSqlQuery query(db_);
+    query.prepare(QStringLiteral("insert into journal (type, date, contact, person, document, text) "
+                                 "values (%1, ?, ?, ?, ?, ?)")
+                  .arg(static_cast<int>(JournalModel::Type::ADD_DOCUMENT)));
+    query.addBindValue(journal_date_);
+    query.addBindValue(journal_contact_);
+    query.addBindValue(journal_person_);
+    query.addBindValue(journal_document_);
+    query.addBindValue(journal_text_);
+    journal_date_.clear();
+    journal_contact_.clear();
+    journal_person_.clear();
+    journal_document_.clear();
+    journal_text_.clear();
+
+    if (!query.execBatch()) {
+        qWarning() << "Mail: Failed to add journal entries: " << query.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+bool MailIngestWorker::cancelled()
+{
+    if (cancelled_) {
+        summary_.cancelled = true;
+    }
+    return summary_.cancelled;
+}
+
+MailIngester::MailIngester(QObject *parent)
+    : QObject(parent)
+    , host_{new MailIngestWorker(Database::instance().path(), cancelled_)}
+{
+    qRegisterMetaType<MailIngestSummary>();
+
+    connect(host_.worker(), &MailIngestWorker::progress, this, &MailIngester::progress);
+    connect(host_.worker(), &MailIngestWorker::finished, this, &MailIngester::finished);
+}
+
+MailIngester::~MailIngester()
+{
+    cancelled_ = true;
+}
+
+void MailIngester::start(const QStringList &paths, int contact, int person)
+{
+    cancelled_ = false;
+    const auto worker = host_.worker();
+    host_.post([worker, paths, contact, person] {
+        worker->run(paths, contact, person);
+    });
+}
@@ -0,0 +1,145 @@
+#ifndef MAILINGESTER_H
+#define MAILINGESTER_H
+
+#include <atomic>
+
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
+
+#include "database.h"
+#include "workerhost.h"
+
+// What a mail ingestion added to the database
+struct MailIngestSummary
+{
+    int files = 0;      // Files read
+    int unchanged = 0;  // Files skipped, as they are unchanged since the last run
+    int messages = 0;   // Messages read
+    int known = 0;      // Messages skipped, as their Message-ID is already ingested
+    int linked = 0;     // Messages that matched at least one contact
+    int documents = 0;  // Email documents added
+    bool cancelled = false;
+    QString error;
+
+    // For the user
+    QString text() const;
+};
+
+Q_DECLARE_METATYPE(MailIngestSummary)
+
+// Reads mail files and adds the messages on its own database connection.
+class MailIngestWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Messages per transaction
+    static constexpr int batchSize = 2000;
+
+    MailIngestWorker(const QString& dbpath, const std::atomic_bool& cancelled);
+
+public slots:
+    // paths are files or directories. If contact is set, every message is
+    // linked to that contact (and person), and not to the contacts matching
+    // its addresses, even if it was ingested before.
+    void run(const QStringList& paths, int contact = 0, int person = 0);
+
+signals:
+    void progress(int files, int messages);
+    void finished(const MailIngestSummary& summary);
+
+private:
+    struct Owner {
+        int contact = 0;
+        int person = 0;
+    };
+
+    // What we know about a file from the last run
+    struct Source {
+        qint64 size = -1;
+        qint64 mtime = -1;
+        qint64 offset = 0; // mbox: the end of the last message we have
+    };
+
+    bool open();
+    bool prepare();
+    bool loadSources();
+    bool ingestPath(const QString& path);
+    bool ingestFile(const QString& path);
+    bool ingestMbox(const char *data, const qint64 size, const QString& path);
+    bool ingestMessage(const char *begin, const char *end, const QString& location);
+    const QVector<Owner>& owners(const QString& address);
+    bool saveSource(const QString& path, const Source& source);
+    bool commit(bool more);
+    bool flush();
+    bool cancelled();
+
+    WorkerConnection connection_;
+    const std::atomic_bool& cancelled_;
+    QSqlDatabase db_;
+    bool prepared_ = false;
+
+    MailIngestSummary summary_;
+    MailIngestSummary committed_; // summary_ at the last commit
+    Owner target_;
+    int in_batch_ = 0;
+
+    // The mbox we are reading, and how far we have come, so that a commit
+    // in the middle of it can be resumed from.
+    QString mbox_path_;
+    qint64 mbox_offset_ = 0;
+
+    QSqlQuery mark_ingested_;
+    QSqlQuery find_owners_;
+    QSqlQuery insert_document_;
+    QSqlQuery save_source_;
+    QHash<QString, QVector<Owner>> owners_; // By address, misses included
+    QHash<QString, Source> sources_;
+
+    // Journal entries are written with one execBatch() per transaction
+    QVariantList journal_date_, journal_contact_, journal_person_, journal_document_, journal_text_;
+};
+
+// Links archived mail to the contacts, as EMAIL documents.
+//
+// Reads mbox files, Maildir folders and .eml files, or directory trees of
+// them (like a mail clients profile directory). Each file is memory mapped
+// and only the message headers are parsed; an mbox is scanned for the
+// "From " lines between the messages. The From, To and Cc addresses are
+// matched against the EMAIL channels (channel.norm). Each matching contact
+// gets a document and a journal entry, dated by the message. The messages
+// are written in large transactions on a worker thread.
+//
+// The Message-ID of every message read is kept (ingested_mail), and so
+// are the size and modification time of every file (mail_source). When
+// it runs again, unchanged files are skipped without being opened, new
+// messages appended to an mbox are read from where the last run stopped,
+// and messages that are already ingested are skipped. Messages without
+// any matching contact are not read again either, so mail from a contact
+// that is added later is not linked by a new run.
+class MailIngester : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MailIngester(QObject *parent);
+    ~MailIngester();
+
+    void start(const QStringList& paths, int contact = 0, int person = 0);
+    void cancel() { cancelled_ = true; }
+
+signals:
+    void progress(int files, int messages);
+    void finished(const MailIngestSummary& summary);
+
+private:
+    std::atomic_bool cancelled_{false};
+    WorkerHost<MailIngestWorker> host_;
+};
+
+#endif // MAILINGESTER_H
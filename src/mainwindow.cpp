@@ -12,7 +12,10 @@
 #include "logging.h"
 #include "favoritesdialog.h"
 #include "aboutdialog.h"
+#include "searchdialog.h"
 #include "strategy.h"
+#include "exporter.h"
+#include "transaction.h"
 
 #include <QSettings>
 #include <QDebug>
@@ -20,6 +23,15 @@
 #include <QClipboard>
 #include <QDesktopServices>
 #include <QMessageBox>
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QInputDialog>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
+#include <QSignalBlocker>
 
 using namespace std;
 
@@ -57,6 +69,16 @@ void MainWindow::initialize()
 
     contacts_model_ = new ContactsModel(settings_, this, {});
     contact_px_model = new ContactProxyModel(contacts_model_, this);
+    contact_filter_ = new ContactFilter(*contacts_model_, this);
+    connect(contact_filter_, &ContactFilter::listed, this, [this](const int count, const bool more) {
+        if (more) {
+            ui->statusBar->showMessage(
+                        QStringLiteral("Listing the first %1 matches. Type more to narrow it down.")
+                        .arg(count));
+        } else {
+            ui->statusBar->clearMessage();
+        }
+    });
     persons_model_ = new ContactsModel(settings_, this, {});
     persons_model_->setParent(-1);
     person_px_model = new ContactProxyModel(persons_model_, this);
@@ -68,11 +90,12 @@ void MainWindow::initialize()
     actions_px_model_ = new ActionProxyModel(actions_model_, this);
     documents_model_ = new DocumentsModel(settings_, this, {});
     documents_px_model_ = new DocumentProxyModel(documents_model_, this);
-    contact_upcoming_model_ = new UpcomingModel(settings_, this,
+    upcoming_actions_ = new UpcomingActionsModel(this);
+    contact_upcoming_model_ = new UpcomingModel(*upcoming_actions_, this,
                                                 UpcomingModel::Mode::CONTACT_UPCOMING);
-    today_model_= new UpcomingModel(settings_, this,
+    today_model_= new UpcomingModel(*upcoming_actions_, this,
                                     UpcomingModel::Mode::TODAY);
-    upcoming_model_ = new UpcomingModel(settings_, this,
+    upcoming_model_ = new UpcomingModel(*upcoming_actions_, this,
                                         UpcomingModel::Mode::UPCOMING);
 
     ui->contactsList->setModel(contact_px_model);
@@ -275,9 +298,68 @@ void MainWindow::initialize()
 
     connect(ui->contactTab, &QTabWidget::currentChanged, this, &MainWindow::onContactTabChanged);
 
+    refresh_ = new RefreshScheduler(this);
+
+    refresh_->addPane(RefreshScheduler::alwaysVisible, [this](int contact) {
+        const auto current = ui->contactsList->currentIndex();
+        const bool corporation = current.isValid()
+                && contacts_model_->data(
+                    contacts_model_->index(current.row(),
+                                           contacts_model_->property("type_col").toInt()),
+                    Qt::DisplayRole).toInt() == static_cast<int>(ContactType::CORPORATION);
+
+        persons_model_->setParent(corporation ? contact : -1);
+        persons_model_->select();
+
+        if (!current.isValid()) {
+            channels_model_->setContact(-1);
+        }
+
+        onSyncronizePersonBindings();
+        onValidatePersonsActions();
+    });
+
+    refresh_->addPane(static_cast<int>(PersonTab::PANEL), [this](int contact) {
+        contact_upcoming_model_->setContact(contact > 0 ? contact : UpcomingModel::NO_SELECTION);
+    });
+
+    refresh_->addPane(static_cast<int>(PersonTab::INTENTS), [this](int contact) {
+        intents_model_->setContact(contact);
+        actions_model_->setContact(contact);
+    });
+
+    refresh_->addPane(static_cast<int>(PersonTab::DOCUMENTS), [this](int contact) {
+        documents_model_->setContact(contact);
+    });
+
+    refresh_->addPane(static_cast<int>(PersonTab::LOG), [this](int contact) {
+        log_model_->setContact(contact);
+    });
+
+    refresh_->setCurrentTab(ui->contactTab->currentIndex());
+    connect(ui->contactTab, &QTabWidget::currentChanged, refresh_, &RefreshScheduler::setCurrentTab);
+
     connect(Logging::instance(), &Logging::message, this, &MainWindow::showMessage, Qt::QueuedConnection);
     connect(ui->clearFilter, &QToolButton::clicked, this, &MainWindow::clearFilter);
 
+    if (settings_.value("ipc-enabled", true).toBool()) {
+        ipc_server_ = new IpcServer(this);
+        ipc_server_->listen(settings_.value("ipc-name", IpcServer::defaultName()).toString());
+    }
+
+    if (settings_.value("file-monitor-enabled", true).toBool()) {
+        file_monitor_ = new FileMonitor(settings_.value("file-monitor-interval", 3600).toInt(), this);
+        connect(file_monitor_, &FileMonitor::updated, this, [this](const QList<int>& contacts) {
+            // The documents were updated on another connection
+            for(const auto contact : contacts) {
+                Database::instance().detailCache().invalidate(contact);
+            }
+            documents_model_->select();
+            log_model_->select();
+        });
+    }
+    ui->actionCheck_Document_Files->setEnabled(file_monitor_ != nullptr);
+
     onSyncronizeContactsBindings();
 }
 
@@ -311,15 +393,14 @@ void MainWindow::appModeSelectionChanged()
     onValidatePersonsActions();
 
     if (app_mode_ == AppMode::PANEL) {
-        upcoming_model_->select();
-        today_model_->select();
+        upcoming_actions_->refresh();
     }
 }
 
 void MainWindow::onContactFilterChanged(const QString &text)
 {
     // We can't use filter() - it don't handle special characters.
-    contacts_model_->setNameFilter(text);
+    contact_filter_->setText(text);
 }
 
 void MainWindow::onContactsListRowActivated(const QModelIndex &ix)
@@ -361,6 +442,14 @@ void MainWindow::onSyncronizeContactsBindings()
 
     qDebug() << "onSyncronizeContactsBindings: Current item is" << (current.isValid() ? current.row() : -1);
 
+    // Only what we can take from the current row is done here.
+    // The models for the panes are loaded by refresh_ when the
+    // selection settles.
+
+    // The mapper is set up again with the persons. Until then, don't
+    // let edits go to a row that may not be the one shown.
+    clearMapper();
+
     if (current.isValid()) {
 
         const auto contact_id = contacts_model_->getContactId(current);
@@ -370,24 +459,10 @@ void MainWindow::onSyncronizeContactsBindings()
                                            contacts_model_->property("type_col").toInt()),
                     Qt::DisplayRole).toInt();
 
-        if (contact_type == static_cast<int>(ContactType::CORPORATION)) {
-            ui->contactPeople->setEnabled(true);
-            persons_model_->setParent(contact_id);
-            persons_model_->select();
-        } else {
-            ui->contactPeople->setEnabled(false);
-            persons_model_->setParent(-1);
-            persons_model_->select();
-        }
+        ui->contactPeople->setEnabled(contact_type == static_cast<int>(ContactType::CORPORATION));
 
         syncContactData(contacts_model_, current.row());
 
-        intents_model_->setContact(contact_id);
-        actions_model_->setContact(contact_id);
-        log_model_->setContact(contact_id);
-        documents_model_->setContact(contact_id);
-        contact_upcoming_model_->setContact(contact_id);
-
         ui->documentsView->setContactId(contact_id);
         ui->documentsView->setEntity(Document::Entity::CONTACT, nullptr, contact_id);
         ui->documentsView->setDocumentDropEnabled(true);
@@ -402,37 +477,28 @@ void MainWindow::onSyncronizeContactsBindings()
         ui->actionsView->setContactId(contact_id);
         ui->actionsView->setEntity(Document::Entity::ACTION, actions_model_, -1);
         ui->actionsView->setDocumentDropEnabled(true);
-        setupMapper(current.row());
+
+        refresh_->schedule(contact_id);
 
     } else {
         syncContactData();
-        clearMapper();
 
-        channels_model_->setContact(-1);
         ui->contactPeople->setEnabled(false);
 
-        persons_model_->setParent(-1);
-        persons_model_->select();
-
         ui->personWhoIcon->setPixmap({});
         ui->personWhoName->setText({});
 
-        actions_model_->setContact(-1);
-        intents_model_->setContact(-1);
-        log_model_->setContact(-1);
-        documents_model_->setContact(-1);
-        contact_upcoming_model_->setContact();
-
         ui->documentsView->setContactId(-1);
         ui->documentsView->setDocumentDropEnabled(false);
         ui->contactPeople->setDocumentDropEnabled(false);
         ui->intentsView->setDocumentDropEnabled(false);
         ui->actionsView->setDocumentDropEnabled(true);
+
+        refresh_->schedule(-1);
     }
 
     last_person_clicked = -1;
 
-    onSyncronizePersonBindings();
     onValidateContactActions();
     onValidatePersonsActions();
 }
@@ -704,19 +770,20 @@ void MainWindow::onActionsRowActivated(const QModelIndex &index)
 void MainWindow::onActionsDataChanged(const QModelIndex &, const QModelIndex &, const QVector<int> &)
 {
     onValidateActionActions();
-    contact_upcoming_model_->select();
-    intents_model_->updateState();
+    upcoming_actions_->refresh();
+    intents_model_->updateState(actions_model_->intent());
 }
 
 void MainWindow::onActionsrowsInserted(const QModelIndex &, int , int )
 {
-    intents_model_->updateState();
+    intents_model_->updateState(actions_model_->intent());
 }
 
 void MainWindow::onActionsModelReset()
 {
     onValidateActionActions();
-    contact_upcoming_model_->select();
+    upcoming_actions_->refresh();
+    intents_model_->updateState(actions_model_->intent());
 }
 
 void MainWindow::onValidateActionActions()
@@ -765,6 +832,7 @@ void MainWindow::onDocumentsContextMenuRequested(const QPoint &pos)
     menu->addAction(ui->actionDelete_Document);
     menu->addSeparator();
     menu->addAction(ui->actionOpen_Document);
+    menu->addAction(ui->actionKeep_Document_Copy);
 
     menu->exec(ui->documentsView->mapToGlobal(pos));
 }
@@ -803,6 +871,16 @@ void MainWindow::onValidateDocumentActions()
     ui->actionEdit_Document->setEnabled(enable_modifications);
     ui->actionDelete_Document->setEnabled(enable_modifications);
     ui->actionOpen_Document->setEnabled(enable_modifications);
+
+    // Only a local file can be copied into the database
+    bool enable_copy = false;
+    if (enable_modifications) {
+        const auto row = ui->documentsView->currentIndex().row();
+        const auto rec = documents_model_->record(row);
+        enable_copy = rec.value("type").toInt() == static_cast<int>(Document::Type::FILE)
+                && !Document::localPath(rec.value("location").toString()).isEmpty();
+    }
+    ui->actionKeep_Document_Copy->setEnabled(enable_copy);
 }
 
 void MainWindow::onContactTabChanged(int ix)
@@ -835,6 +913,8 @@ void MainWindow::on_action_Quit_triggered()
 
 void MainWindow::on_actionDelete_Contact_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->contactsList->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -851,6 +931,8 @@ void MainWindow::on_actionDelete_Contact_triggered()
 
 void MainWindow::on_actionAdd_Channel_triggered()
 {
+    refresh_->flush();
+
     if (const auto contact_id = getCurrentPersonId()) {
         auto rec = channels_model_->record();
 
@@ -868,6 +950,8 @@ void MainWindow::on_actionAdd_Channel_triggered()
 
 void MainWindow::on_actionDelete_Channel_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->contactChannels->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -884,6 +968,8 @@ void MainWindow::on_actionDelete_Channel_triggered()
 
 void MainWindow::on_actionEdit_Channel_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->contactChannels->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
@@ -897,6 +983,8 @@ void MainWindow::on_actionEdit_Channel_triggered()
 
 void MainWindow::on_actionVerify_Channel_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->contactChannels->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -1038,6 +1126,8 @@ ChannelType MainWindow::getChannelType() const
 
 void MainWindow::on_actionAdd_Person_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->contactsList->selectionModel()->currentIndex();
 
     if (!current.isValid()) {
@@ -1161,6 +1251,8 @@ QVariant MainWindow::contactData(ContactsModel *model, const char *col, const in
 
 void MainWindow::on_actionEdit_Person_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->contactPeople->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1177,6 +1269,8 @@ void MainWindow::on_actionEdit_Person_triggered()
 
 void MainWindow::on_actionDelete_Person_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->contactPeople->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -1193,6 +1287,8 @@ void MainWindow::on_actionDelete_Person_triggered()
 
 void MainWindow::on_actionAdd_Intent_triggered()
 {
+    refresh_->flush();
+
     const auto current = ui->contactsList->currentIndex();
 
     if (!current.isValid()) {
@@ -1211,11 +1307,12 @@ void MainWindow::on_actionAdd_Intent_triggered()
     connect(dlg, &IntentDialog::addIntent,
             intents_model_, &IntentsModel::addIntent);
     dlg->exec();
-    intents_model_->select();
 }
 
 void MainWindow::on_actionEdit_Intent_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->intentsView->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1229,6 +1326,8 @@ void MainWindow::on_actionEdit_Intent_triggered()
 
 void MainWindow::on_actionDelete_Intent_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->intentsView->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -1247,6 +1346,8 @@ void MainWindow::on_actionDelete_Intent_triggered()
 
 void MainWindow::on_actionAdd_Action_triggered()
 {
+    refresh_->flush();
+
     const auto current = ui->intentsView->currentIndex();
 
     if (!current.isValid()) {
@@ -1261,26 +1362,33 @@ void MainWindow::on_actionAdd_Action_triggered()
     connect(dlg, &ActionDialog::addAction,
             actions_model_, &ActionsModel::addAction);
     dlg->exec();
-    actions_model_->select();
 }
 
 void MainWindow::on_actionEdit_Action_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->actionsView->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
     }
 
+    const auto action = actions_model_->data(
+                actions_model_->index(current.row(), actions_model_->fieldIndex("id"), {}),
+                Qt::DisplayRole).toInt();
+
     auto dlg = new ActionDialog(actions_model_->contact(), this);
     dlg->setModel(actions_model_, current);
     dlg->setAttribute( Qt::WA_DeleteOnClose );
     if (dlg->exec() == QDialog::Accepted) {
-        actions_model_->openNextActions();
+        actions_model_->openNextActions(action);
     }
 }
 
 void MainWindow::on_actionDelete_Action_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->actionsView->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -1297,6 +1405,8 @@ void MainWindow::on_actionDelete_Action_triggered()
 
 void MainWindow::on_actionAction_Done_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->actionsView->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1307,6 +1417,8 @@ void MainWindow::on_actionAction_Done_triggered()
 
 void MainWindow::on_actionExecute_Action_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->actionsView->currentIndex();
 
     if (!selected.isValid()) {
@@ -1347,10 +1459,9 @@ void MainWindow::on_actionExecute_Action_triggered()
 
     // See if the requested contact-person have any such channels
 
-    QSqlQuery query(QStringLiteral(
-        "select value from channel where contact = %1 and type = %2 order by value")
-                    .arg(person)
-                    .arg(channel_type));
+    auto& query = Database::instance().query(QStringLiteral(
+        "select value from channel where contact = ? and type = ? order by value"),
+                    {person, channel_type});
 
     QList<QString> values;
     while(query.next()) {
@@ -1384,18 +1495,38 @@ void MainWindow::on_actionExecute_Action_triggered()
 
 void MainWindow::on_actionMove_Action_Up_triggered()
 {
+    refresh_->flush();
+
+    const auto selected = ui->actionsView->selectionModel()->selectedRows();
+    if (selected.size() > 1) {
+        const auto first = min_element(selected.begin(), selected.end())->row();
+        actions_model_->moveActions(selected, first - 1);
+        return;
+    }
+
     auto current = ui->actionsView->selectionModel()->currentIndex();
     actions_model_->moveUp(current);
 }
 
 void MainWindow::on_actionMove_Action_Down_triggered()
 {
+    refresh_->flush();
+
+    const auto selected = ui->actionsView->selectionModel()->selectedRows();
+    if (selected.size() > 1) {
+        const auto last = max_element(selected.begin(), selected.end())->row();
+        actions_model_->moveActions(selected, last + 2);
+        return;
+    }
+
     auto current = ui->actionsView->selectionModel()->currentIndex();
     actions_model_->moveDown(current);
 }
 
 void MainWindow::on_actionAdd_Document_triggered()
 {
+    refresh_->flush();
+
     const auto current = ui->contactsList->currentIndex();
 
     if (!current.isValid()) {
@@ -1417,6 +1548,8 @@ void MainWindow::on_actionAdd_Document_triggered()
 
 void MainWindow::on_actionEdit_Document_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->documentsView->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1431,6 +1564,8 @@ void MainWindow::on_actionEdit_Document_triggered()
 
 void MainWindow::on_actionDelete_Document_triggered()
 {
+    refresh_->flush();
+
     auto selected = ui->documentsView->selectionModel()->selection().indexes();
 
     if (selected.isEmpty()) {
@@ -1447,6 +1582,8 @@ void MainWindow::on_actionDelete_Document_triggered()
 
 void MainWindow::on_actionOpen_Document_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->documentsView->selectionModel()->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1464,8 +1601,96 @@ void MainWindow::on_actionOpen_Document_triggered()
 
     if (type == Document::Type::NOTE) {
         on_actionEdit_Document_triggered();
-    } else {
-        Document::open(type, what);
+        return;
+    }
+
+    // The file is gone, but there may be a copy in the database
+    const auto id = documents_model_->data(
+                documents_model_->index(current.row(),
+                                        documents_model_->property("id_col").toInt()),
+                Qt::DisplayRole).toInt();
+    const auto local = Document::localPath(what);
+    if ((what.isEmpty() || (!local.isEmpty() && !QFileInfo::exists(local)))
+            && DocumentsModel::hasContent(id)) {
+        const auto name = local.isEmpty()
+                ? documents_model_->data(
+                      documents_model_->index(current.row(),
+                                              documents_model_->property("name_col").toInt()),
+                      Qt::DisplayRole).toString()
+                : QFileInfo{local}.fileName();
+        openDocumentContent(id, name);
+        return;
+    }
+
+    Document::open(type, what);
+}
+
+void MainWindow::openDocumentContent(const int id, const QString &name)
+{
+    // Kept until the application exits, as the viewer may still have it open
+    static QTemporaryDir dir;
+    if (!dir.isValid()) {
+        QMessageBox::warning(this, "Open Document", "Failed to create a temporary directory");
+        return;
+    }
+
+    auto file_name = name;
+    file_name.replace('/', '_').replace('\\', '_');
+    if (file_name.isEmpty()) {
+        file_name = QString::number(id);
+    }
+
+    const QDir doc_dir{dir.filePath(QString::number(id))};
+    QFile file{doc_dir.filePath(file_name)};
+    if (!doc_dir.mkpath(".")
+            || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || !DocumentsModel::getContent(id, file)) {
+        QMessageBox::warning(this, "Open Document",
+                             QStringLiteral("Failed to read the stored copy of %1").arg(name));
+        return;
+    }
+    file.close();
+
+    Document::openFile(QUrl::fromLocalFile(file.fileName()).toString());
+}
+
+void MainWindow::on_actionKeep_Document_Copy_triggered()
+{
+    refresh_->flush();
+
+    auto current = ui->documentsView->selectionModel()->currentIndex();
+    if (!current.isValid()) {
+        return;
+    }
+
+    const auto rec = documents_model_->record(current.row());
+    const auto name = rec.value("name").toString();
+    QFile file{Document::localPath(rec.value("location").toString())};
+    if (file.fileName().isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, "Keep a Copy",
+                             QStringLiteral("Failed to read the file for %1").arg(name));
+        return;
+    }
+
+    Transaction transaction;
+    if (!DocumentsModel::setContent(rec.value("id").toInt(), file)
+            || !JournalModel::instance().addEntry(JournalModel::Type::UPDATED_DOCUMENT,
+                                                  QStringLiteral("Kept a copy of document: %1").arg(name),
+                                                  rec.value("contact").toInt(),
+                                                  rec.value("person").toInt(),
+                                                  rec.value("intent").toInt(),
+                                                  rec.value("activity").toInt(),
+                                                  rec.value("id").toInt())
+            || !transaction.commit()) {
+        QMessageBox::warning(this, "Keep a Copy",
+                             QStringLiteral("Failed to store a copy of %1").arg(name));
+    }
+}
+
+void MainWindow::on_actionCheck_Document_Files_triggered()
+{
+    if (file_monitor_) {
+        file_monitor_->checkNow();
     }
 }
 
@@ -1478,6 +1703,8 @@ void MainWindow::on_actionSettings_triggered()
 
 void MainWindow::on_actionEdit_Contact_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->contactsList->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1506,6 +1733,8 @@ void MainWindow::onContactsDataChanged(const QModelIndex &, const QModelIndex &,
 
 void MainWindow::on_actionRateContact_triggered()
 {
+    refresh_->flush();
+
     auto current = ui->contactsList->currentIndex();
     if (!current.isValid()) {
         return;
@@ -1527,3 +1756,192 @@ void MainWindow::on_action_About_triggered()
     dlg->setAttribute( Qt::WA_DeleteOnClose );
     dlg->exec();
 }
+
+void MainWindow::on_actionSearch_triggered()
+{
+    auto dlg = new SearchDialog(this);
+    dlg->setAttribute( Qt::WA_DeleteOnClose );
+    connect(dlg, &SearchDialog::contactSelected, this, &MainWindow::selectContact);
+    dlg->exec();
+}
+
+void MainWindow::on_actionImport_triggered()
+{
+    const auto path = QFileDialog::getOpenFileName(
+                this, "Import Contacts", {},
+                "Contacts (*.csv *.vcf *.vcard);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    // Per mille, so large files still fit in an int
+    auto progress = new QProgressDialog("Importing contacts...", "Cancel", 0, 1000, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+
+    auto importer = new Importer(this);
+    connect(progress, &QProgressDialog::canceled, importer, [importer] {
+        importer->cancel();
+    });
+    connect(importer, &Importer::progress, progress,
+            [progress](qint64 done, qint64 total, int records) {
+        progress->setLabelText(QStringLiteral("Imported %1 records").arg(records));
+        if (total > 0) {
+            progress->setValue(static_cast<int>(std::min<qint64>(999, done * 1000 / total)));
+        }
+    });
+    connect(importer, &Importer::finished, this,
+            [this, importer, progress](const ImportSummary& summary) {
+        progress->deleteLater();
+        importer->deleteLater();
+        onImportFinished(summary);
+    });
+
+    importer->start(path);
+}
+
+void MainWindow::on_actionIngest_Mail_triggered()
+{
+    const auto dir = QFileDialog::getExistingDirectory(
+                this, "Import Mail from mbox files, Maildir folders or .eml files");
+    if (dir.isEmpty()) {
+        return;
+    }
+
+    // We don't know the total up front
+    auto progress = new QProgressDialog("Reading mail...", "Cancel", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+
+    auto ingester = new MailIngester(this);
+    connect(progress, &QProgressDialog::canceled, ingester, [ingester] {
+        ingester->cancel();
+    });
+    connect(ingester, &MailIngester::progress, progress, [progress](int files, int messages) {
+        progress->setLabelText(QStringLiteral("Read %1 messages in %2 files").arg(messages).arg(files));
+    });
+    connect(ingester, &MailIngester::finished, this,
+            [this, ingester, progress](const MailIngestSummary& summary) {
+        progress->deleteLater();
+        ingester->deleteLater();
+
+        // The rows were added on another connection
+        Database::instance().detailCache().clear();
+        documents_model_->select();
+        log_model_->select();
+
+        if (!summary.error.isEmpty()) {
+            QMessageBox::warning(this, "Import Mail",
+                                 QStringLiteral("%1\n%2").arg(summary.error, summary.text()));
+        } else if (summary.cancelled) {
+            QMessageBox::information(this, "Import Mail",
+                                     QStringLiteral("The import was cancelled.\n%1").arg(summary.text()));
+        } else {
+            QMessageBox::information(this, "Import Mail", summary.text());
+        }
+    });
+
+    ingester->start({dir});
+}
+
+void MainWindow::on_actionExport_triggered()
+{
+    const auto dir = QFileDialog::getExistingDirectory(this, "Export to Directory");
+    if (dir.isEmpty()) {
+        return;
+    }
+
+    const QStringList formats{"CSV", "JSON Lines", "vCard"};
+    bool ok = false;
+    const auto format = QInputDialog::getItem(this, "Export", "Format", formats, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+
+    // Exporting to the same directory again only adds what changed since the last time
+    Exporter::Options options;
+    options.directory = dir;
+    options.format = static_cast<Exporter::Format>(formats.indexOf(format));
+    options.incremental = true;
+    options.content = options.format != Exporter::Format::VCARD;
+
+    auto progress = new QProgressDialog("Exporting...", "Cancel", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+
+    auto job = new ExportJob(options, this);
+    connect(progress, &QProgressDialog::canceled, job, [job] {
+        job->cancel();
+    });
+    connect(job, &ExportJob::finished, this,
+            [this, job, progress](bool ok, const QString& message) {
+        progress->deleteLater();
+        job->deleteLater();
+        if (ok) {
+            QMessageBox::information(this, "Export", message);
+        } else {
+            QMessageBox::warning(this, "Export", message);
+        }
+    });
+
+    job->start();
+}
+
+void MainWindow::onImportFinished(const ImportSummary &summary)
+{
+    // The rows were added on another connection
+    Database::instance().contactNames().clear();
+    Database::instance().detailCache().clear();
+    contacts_model_->select();
+    log_model_->select();
+
+    auto text = QStringLiteral("Added %1 companies, %2 persons and %3 channels.")
+            .arg(summary.companies).arg(summary.persons).arg(summary.channels);
+    if (summary.duplicates) {
+        text += QStringLiteral("\nSkipped %1 contacts that were already there.").arg(summary.duplicates);
+    }
+
+    if (!summary.error.isEmpty()) {
+        QMessageBox::warning(this, "Import Contacts",
+                             QStringLiteral("%1\n%2").arg(summary.error, text));
+    } else if (summary.cancelled) {
+        QMessageBox::information(this, "Import Contacts",
+                                 QStringLiteral("The import was cancelled.\n%1").arg(text));
+    } else {
+        QMessageBox::information(this, "Import Contacts", text);
+    }
+}
+
+void MainWindow::selectContact(int contact)
+{
+    ui->appModeList->setCurrentRow(static_cast<int>(AppMode::CONTACTS));
+
+    // List only that contact, with its name in the filter, rather than
+    // fetching the whole list to find it.
+    const auto name = Database::instance().contactNames().name(contact);
+    {
+        const QSignalBlocker blocker{ui->contactFilter};
+        ui->contactFilter->setText(name);
+    }
+    contact_filter_->setContact(contact, name);
+
+    // Only the rows that are already fetched are searched
+    const auto id_col = contacts_model_->property("id_col").toInt();
+    for(int row = 0;; ++row) {
+        if (row >= contacts_model_->rowCount()) {
+            qDebug() << "selectContact: Did not find contact #" << contact;
+            return;
+        }
+
+        const auto ix = contacts_model_->index(row, id_col, {});
+        if (contacts_model_->data(ix, Qt::DisplayRole).toInt() == contact) {
+            const auto pix = contact_px_model->mapFromSource(
+                        contacts_model_->index(row, contacts_model_->property("name_col").toInt(), {}));
+            ui->contactsList->scrollTo(pix);
+            ui->contactsList->setCurrentIndex(pix);
+            return;
+        }
+    }
+}
@@ -25,6 +25,12 @@
 #include "journalproxymodel.h"
 #include "channelproxymodel.h"
 #include "upcomingmodel.h"
+#include "contactfilter.h"
+#include "refreshscheduler.h"
+#include "importer.h"
+#include "mailingester.h"
+#include "ipcserver.h"
+#include "filemonitor.h"
 
 namespace Ui {
 class MainWindow;
@@ -161,6 +167,10 @@ private slots:
 
     void on_actionOpen_Document_triggered();
 
+    void on_actionKeep_Document_Copy_triggered();
+
+    void on_actionCheck_Document_Files_triggered();
+
     void on_actionSettings_triggered();
 
     void on_actionEdit_Contact_triggered();
@@ -171,12 +181,26 @@ private slots:
 
     void on_action_About_triggered();
 
+    void on_actionSearch_triggered();
+
+    void on_actionImport_triggered();
+
+    void on_actionIngest_Mail_triggered();
+
+    void on_actionExport_triggered();
+
+    // Show the contacts screen with this (top-level) contact selected
+    void selectContact(int contact);
+
 private:
+    void onImportFinished(const ImportSummary& summary);
     QString getChannelValue() const;
     ChannelType getChannelType() const;
     void createContact(ContactType type);
     void openChannel(const ChannelType type, const QString& value);
     bool confirmDelete(const QString& what);
+    // Open the copy of a document kept in the database, as a temporary file
+    void openDocumentContent(const int id, const QString& name);
     void setupMapper(const int row);
     void clearMapper();
 
@@ -211,6 +235,10 @@ protected:
     JournalProxyModel *log_px_model_ = {};
     ContactsModel *contacts_model_ = {};
     ContactsModel *persons_model_ = {}; // contact (persons) at a contact (company)
+    ContactFilter *contact_filter_ = {};
+    IpcServer *ipc_server_ = {};
+    FileMonitor *file_monitor_ = {};
+    RefreshScheduler *refresh_ = {};
     ChannelsModel *channels_model_ = {};
     ChannelProxyModel *channels_px_model_ = {};
     IntentsModel *intents_model_ = {};
@@ -221,6 +249,7 @@ protected:
     DocumentProxyModel *documents_px_model_ = {};
     ContactProxyModel *contact_px_model = {};
     ContactProxyModel * person_px_model = {};
+    UpcomingActionsModel *upcoming_actions_ = {};
     UpcomingModel *contact_upcoming_model_ = {};
     UpcomingModel *upcoming_model_ = {};
     UpcomingModel *today_model_ = {};
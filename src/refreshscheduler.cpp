@@ -0,0 +1,105 @@
+#include "src/refreshscheduler.h"
+
+#include <QDebug>
+
+namespace {
+// How long the selection must stay on a contact before we load it
+constexpr int settle_ms = 120;
+}
+
+RefreshScheduler::RefreshScheduler(QObject *parent)
+    : QObject(parent)
+{
+    settle_timer_.setSingleShot(true);
+    settle_timer_.setInterval(settle_ms);
+    connect(&settle_timer_, &QTimer::timeout, this, &RefreshScheduler::onSettled);
+
+    // Zero interval: one pane per pass through the event loop
+    next_timer_.setInterval(0);
+    connect(&next_timer_, &QTimer::timeout, this, &RefreshScheduler::loadNext);
+}
+
+void RefreshScheduler::addPane(const int tab, loader_t loader)
+{
+    Pane pane;
+    pane.tab = tab;
+    pane.loader = std::move(loader);
+    panes_.push_back(std::move(pane));
+}
+
+void RefreshScheduler::flush()
+{
+    settle_timer_.stop();
+    next_timer_.stop();
+
+    const auto generation = generation_;
+    for(auto& pane : panes_) {
+        if (generation != generation_) {
+            return; // A pane changed the selection
+        }
+        if (pane.loaded != generation_) {
+            load(pane);
+        }
+    }
+}
+
+void RefreshScheduler::schedule(int contact)
+{
+    contact_ = contact;
+
+    // Whatever is pending is for the previous selection
+    ++generation_;
+    next_timer_.stop();
+    settle_timer_.start();
+}
+
+void RefreshScheduler::setCurrentTab(int tab)
+{
+    current_tab_ = tab;
+
+    if (settle_timer_.isActive()) {
+        return; // onSettled() will take it from here
+    }
+
+    for(auto& pane : panes_) {
+        if (pane.tab == tab && pane.loaded != generation_) {
+            load(pane);
+        }
+    }
+}
+
+void RefreshScheduler::onSettled()
+{
+    qDebug() << "RefreshScheduler: Loading contact " << contact_;
+
+    const auto generation = generation_;
+    for(auto& pane : panes_) {
+        if (generation != generation_) {
+            return; // A pane changed the selection
+        }
+        if (pane.tab == alwaysVisible || pane.tab == current_tab_) {
+            load(pane);
+        }
+    }
+
+    next_timer_.start();
+}
+
+void RefreshScheduler::loadNext()
+{
+    for(auto& pane : panes_) {
+        if (pane.loaded != generation_) {
+            load(pane);
+            return;
+        }
+    }
+
+    next_timer_.stop();
+}
+
+void RefreshScheduler::load(Pane &pane)
+{
+    // Set it first. The loader may cause a new schedule().
+    pane.loaded = generation_;
+    pane.loader(contact_);
+}
@@ -0,0 +1,70 @@
+#ifndef REFRESHSCHEDULER_H
+#define REFRESHSCHEDULER_H
+
+#include <functional>
+#include <vector>
+
+#include <QObject>
+#include <QTimer>
+
+// Loads the panes that depend on the current contact.
+//
+// Selection changes are coalesced: nothing is loaded until the selection
+// has been stable for a short while, so moving through the contact list
+// with the arrow keys only loads the contact we stop at. Then the panes
+// that are visible (the ones that are always shown, and the current tab)
+// are loaded at once, and the rest one at a time from the event loop.
+// When the selection moves on, the panes still pending for the previous
+// contact are dropped. A pane that has not been loaded yet is loaded when
+// its tab is shown.
+//
+// The models all use the applications database connection, so the loading
+// happens on the GUI thread. It is just split up so the UI stays responsive.
+class RefreshScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    using loader_t = std::function<void (int contact)>;
+
+    // Used as tab for panes that are always visible
+    static constexpr int alwaysVisible = -1;
+
+    explicit RefreshScheduler(QObject *parent = nullptr);
+
+    // Add a pane. Panes on the same tab are loaded in the order they are added.
+    void addPane(const int tab, loader_t loader);
+
+    // Load everything that is still pending, now. The add, edit and delete
+    // commands call it first, so they never work on the models of the
+    // previous contact while the selection settles.
+    void flush();
+
+public slots:
+    // The selection moved to contact (-1 if nothing is selected)
+    void schedule(int contact);
+
+    // The user switched to another tab
+    void setCurrentTab(int tab);
+
+private slots:
+    void onSettled();
+    void loadNext();
+
+private:
+    struct Pane {
+        int tab = alwaysVisible;
+        loader_t loader;
+        quint64 loaded = 0; // generation
+    };
+
+    void load(Pane& pane);
+
+    std::vector<Pane> panes_;
+    QTimer settle_timer_;
+    QTimer next_timer_;
+    quint64 generation_ = 0;
+    int contact_ = -1;
+    int current_tab_ = 0;
+};
+
+#endif // REFRESHSCHEDULER_H
@@ -0,0 +1,89 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded, lock-free queue for many producers and one consumer.
+//
+// Each slot carries a sequence number that tells whose turn it is:
+// a producer claims a position by advancing head_, and publishes the
+// value by bumping the slot's sequence. The consumer only reads slots
+// that have been published, and hands them back by bumping the
+// sequence once more. push() fails instead of blocking when the
+// buffer is full.
+//
+// capacity must be a power of two.
+template <typename T, size_t capacity>
+class RingBuffer
+{
+    static_assert(capacity >= 2 && (capacity & (capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+public:
+    RingBuffer() {
+        for(size_t i = 0; i < capacity; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator = (const RingBuffer&) = delete;
+
+    // Safe to call from any thread
+    bool push(T&& value) {
+        auto pos = head_.load(std::memory_order_relaxed);
+        for(;;) {
+            auto& slot = slots_[pos & mask];
+            const auto seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only call from the consumer thread
+    bool pop(T& value) {
+        auto& slot = slots_[tail_ & mask];
+        const auto seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != tail_ + 1) {
+            return false; // Empty, or the producer is not done yet
+        }
+
+        value = std::move(slot.value);
+        slot.value = {};
+        slot.seq.store(tail_ + capacity, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+    // Only call from the consumer thread
+    bool empty() const {
+        return slots_[tail_ & mask].seq.load(std::memory_order_acquire) != tail_ + 1;
+    }
+
+private:
+    static constexpr size_t mask = capacity - 1;
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::array<Slot, capacity> slots_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) size_t tail_ = 0;
+};
+
+#endif // RINGBUFFER_H
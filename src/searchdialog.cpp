@@ -0,0 +1,60 @@
+#include "src/searchdialog.h"
+#include "ui_searchdialog.h"
+
+#include <QHeaderView>
+
+#include "src/database.h"
+
+SearchDialog::SearchDialog(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::SearchDialog)
+{
+    ui->setupUi(this);
+
+    model_ = new SearchModel(this);
+    ui->results->setModel(model_);
+    ui->results->hideColumn(SearchModel::H_ID);
+    ui->results->hideColumn(SearchModel::H_CONTACT_ID);
+    ui->results->hideColumn(SearchModel::H_RANK);
+    ui->results->hideColumn(SearchModel::H_SOURCE);
+    ui->results->horizontalHeader()->setSectionResizeMode(SearchModel::H_HIT, QHeaderView::Stretch);
+
+    if (!Database::instance().hasSearchIndex()) {
+        ui->query->setEnabled(false);
+        ui->status->setText("Full-text search is not supported by the installed sqlite library.");
+    }
+
+    // Don't search for every keystroke
+    timer_.setSingleShot(true);
+    timer_.setInterval(150);
+    connect(&timer_, &QTimer::timeout, this, &SearchDialog::search);
+    connect(ui->query, &QLineEdit::textChanged, this, [this] { timer_.start(); });
+    connect(ui->query, &QLineEdit::returnPressed, this, &SearchDialog::search);
+    connect(ui->results, &QTableView::activated, this, &SearchDialog::onActivated);
+}
+
+SearchDialog::~SearchDialog()
+{
+    delete ui;
+}
+
+void SearchDialog::search()
+{
+    timer_.stop();
+    model_->search(ui->query->text());
+
+    if (ui->query->text().trimmed().isEmpty()) {
+        ui->status->clear();
+    } else {
+        ui->status->setText(QStringLiteral("%1 hits").arg(model_->rowCount()));
+    }
+}
+
+void SearchDialog::onActivated(const QModelIndex &ix)
+{
+    const auto contact = model_->getContactId(ix);
+    if (contact > 0) {
+        emit contactSelected(contact);
+        accept();
+    }
+}
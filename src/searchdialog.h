@@ -0,0 +1,35 @@
+#ifndef SEARCHDIALOG_H
+#define SEARCHDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+
+#include "searchmodel.h"
+
+namespace Ui {
+class SearchDialog;
+}
+
+class SearchDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SearchDialog(QWidget *parent = 0);
+    ~SearchDialog();
+
+signals:
+    // The user picked a hit belonging to this contact
+    void contactSelected(int contact);
+
+private slots:
+    void search();
+    void onActivated(const QModelIndex& ix);
+
+private:
+    Ui::SearchDialog *ui;
+    SearchModel *model_ = {};
+    QTimer timer_;
+};
+
+#endif // SEARCHDIALOG_H
@@ -0,0 +1,116 @@
+#include "src/searchmodel.h"
+
+#include <QDebug>
+#include <QRegularExpression>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+
+#include "src/database.h"
+
+namespace {
+// Max hits from each source, and in total
+constexpr int source_limit = 50;
+constexpr int total_limit = 200;
+
+// Each source is limited by its own rank first, so FTS5 can stop early
+// even when a common word matches millions of journal entries.
+// The bm25 ranks of different tables don't compare, so the hits are
+// ordered by source before rank.
+QString sourceQuery(const int source, const char *kind, const char *table,
+                    const char *contact, const char *title)
+{
+    return QStringLiteral(
+                "SELECT * FROM (SELECT '%1' AS kind, %2_fts.rowid AS id, %3 AS contact, "
+                "NULL AS contact_name, %4 AS title, "
+                "snippet(%2_fts, -1, '', '', '...', 12) AS hit, %2_fts.rank AS rank, "
+                "%6 AS source "
+                "FROM %2_fts JOIN %2 AS t ON t.id = %2_fts.rowid "
+                "WHERE %2_fts MATCH ? ORDER BY %2_fts.rank LIMIT %5)")
+            .arg(kind).arg(table).arg(contact).arg(title).arg(source_limit).arg(source);
+}
+}
+
+SearchModel::SearchModel(QObject *parent)
+    : QSqlQueryModel{parent}
+{
+}
+
+QVariant SearchModel::data(const QModelIndex &ix, int role) const
+{
+    if (ix.isValid() && role == Qt::DisplayRole) {
+        if (ix.column() == H_CONTACT_NAME) {
+            return Database::instance().contactNames().name(getContactId(ix));
+        }
+    }
+
+    return QSqlQueryModel::data(ix, role);
+}
+
+QVariant SearchModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
+        switch(section) {
+        case H_KIND:
+            return QStringLiteral("Type");
+        case H_CONTACT_NAME:
+            return QStringLiteral("Contact");
+        case H_TITLE:
+            return QStringLiteral("Name");
+        case H_HIT:
+            return QStringLiteral("Found");
+        }
+    }
+
+    return QSqlQueryModel::headerData(section, orientation, role);
+}
+
+int SearchModel::getContactId(const QModelIndex &ix) const
+{
+    return QSqlQueryModel::data(index(ix.row(), H_CONTACT_ID, {}), Qt::DisplayRole).toInt();
+}
+
+QString SearchModel::toMatchExpression(const QString &text)
+{
+    QStringList terms;
+    // Empty words are skipped below (QString::SkipEmptyParts is deprecated from Qt 5.14)
+    for(auto word : text.split(QRegularExpression("\\s+"))) {
+        word.remove('"');
+        if (!word.isEmpty()) {
+            terms << QStringLiteral("\"%1\"*").arg(word);
+        }
+    }
+
+    return terms.join(' ');
+}
+
+void SearchModel::search(const QString &text)
+{
+    const auto match = toMatchExpression(text);
+
+    if (match.isEmpty() || !Database::instance().hasSearchIndex()) {
+        clear();
+        return;
+    }
+
+    static const int sources = 5;
+    static const QString sql = QStringList{
+            sourceQuery(0, "Contact", "contact", "coalesce(t.contact, t.id)", "t.name"),
+            sourceQuery(1, "Document", "document", "t.contact", "t.name"),
+            sourceQuery(2, "Intent", "intent", "t.contact", "t.abstract"),
+            sourceQuery(3, "Action", "action", "t.contact", "t.name"),
+            sourceQuery(4, "Journal", "journal", "t.contact", "NULL"),
+        }.join(" UNION ALL ") + QStringLiteral(" ORDER BY source, rank LIMIT %1").arg(total_limit);
+
+    QSqlQuery query;
+    query.prepare(sql);
+    for(int i = 0; i < sources; ++i) {
+        query.addBindValue(match);
+    }
+    if (!query.exec()) {
+        qWarning() << "Search failed: " << query.lastError().text()
+                   << " Query: " << sql;
+    }
+
+    setQuery(query);
+}
@@ -0,0 +1,37 @@
+#ifndef SEARCHMODEL_H
+#define SEARCHMODEL_H
+
+#include <QSqlQueryModel>
+
+// Ranked full-text search over contacts, documents, intents, actions and the journal.
+// The hits are listed by source, in that order, and by rank within each source.
+class SearchModel : public QSqlQueryModel
+{
+    Q_OBJECT
+public:
+    enum Headers {
+        H_KIND,
+        H_ID,
+        H_CONTACT_ID,
+        H_CONTACT_NAME,
+        H_TITLE,
+        H_HIT,
+        H_RANK,  // bm25, only comparable within one source
+        H_SOURCE // The order of the source in the results
+    };
+
+    SearchModel(QObject *parent);
+
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    int getContactId(const QModelIndex& ix) const;
+
+    // Turn what the user typed into an FTS5 query: all the words, as prefixes
+    static QString toMatchExpression(const QString& text);
+
+public slots:
+    void search(const QString& text);
+};
+
+#endif // SEARCHMODEL_H
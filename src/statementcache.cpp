@@ -0,0 +1,67 @@
+#include "src/statementcache.h"
+
+#include <QDebug>
+#include <QSqlError>
+
+StatementCache::StatementCache(QSqlDatabase db)
+    : db_{std::move(db)}
+{
+}
+
+StatementCache::~StatementCache()
+{
+    clear();
+}
+
+QSqlQuery &StatementCache::prepare(const QString &sql)
+{
+    auto it = statements_.find(sql);
+    if (it == statements_.end()) {
+        QSqlQuery query(db_);
+        if (!query.prepare(sql)) {
+            qWarning() << "Failed to prepare statement: " << query.lastError().text()
+                       << " Query: " << sql;
+        }
+        it = statements_.insert(sql, query);
+    } else {
+        // Reset the statement in case the last user did not read all the rows.
+        // An active statement keeps a read-transaction open in sqlite.
+        it->finish();
+    }
+
+    return *it;
+}
+
+QSqlQuery &StatementCache::exec(const QString &sql, const QVariantList &args)
+{
+    auto& query = prepare(sql);
+
+    for(int i = 0; i < args.size(); ++i) {
+        query.bindValue(i, args.at(i));
+    }
+
+    if (!query.exec()) {
+        qWarning() << "Query failed: " << query.lastError().text()
+                   << " Query: " << sql;
+    }
+
+    return query;
+}
+
+QVariant StatementCache::scalar(const QString &sql, const QVariantList &args)
+{
+    auto& query = exec(sql, args);
+
+    QVariant value;
+    if (query.next()) {
+        value = query.value(0);
+    }
+    query.finish();
+
+    return value;
+}
+
+void StatementCache::clear()
+{
+    statements_.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QVariant>
+
+// Prepared statements for one database connection, keyed by their SQL text.
+//
+// A statement is prepared the first time it is used, and then re-used with
+// new bound values. Since the same SQL text always gives the same QSqlQuery,
+// don't run a statement again while you are still iterating over its result.
+class StatementCache
+{
+public:
+    explicit StatementCache(QSqlDatabase db);
+    ~StatementCache();
+
+    // Get the prepared statement for sql
+    QSqlQuery& prepare(const QString& sql);
+
+    // Bind the arguments to the positional placeholders ('?') and execute.
+    // Errors are logged. Check the return value from next() or isActive().
+    QSqlQuery& exec(const QString& sql, const QVariantList& args = {});
+
+    // Execute, and return the first column in the first row (or an invalid QVariant)
+    QVariant scalar(const QString& sql, const QVariantList& args = {});
+
+    void clear();
+
+private:
+    QSqlDatabase db_;
+    QHash<QString, QSqlQuery> statements_;
+};
+
+#endif // STATEMENTCACHE_H
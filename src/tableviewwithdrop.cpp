@@ -6,6 +6,11 @@
 #include <QFileInfo>
 #include <QDateTime>
 #include <QMessageBox>
+#include <QProgressDialog>
+
+#include "src/filedrop.h"
+#include "src/journalmodel.h"
+#include "src/mailingester.h"
 
 TableViewWithDrop::TableViewWithDrop(QWidget *parent)
     : QTableView(parent)
@@ -79,6 +84,49 @@ void TableViewWithDrop::dropEvent(QDropEvent *event)
             qDebug() << text;
         }
 
+        // Saved mail, dropped from a mail client or a file manager
+        QStringList mail;
+        if (mime->hasUrls() && (entity_ == Document::Entity::CONTACT
+                                || entity_ == Document::Entity::PERSON)) {
+            for(const auto& url : mime->urls()) {
+                if (!url.isLocalFile() || !url.path().endsWith(".eml", Qt::CaseInsensitive)) {
+                    mail.clear();
+                    break;
+                }
+                mail << url.toLocalFile();
+            }
+        }
+
+        if (!mail.isEmpty()) {
+            const auto row = entity_model_ ? rowAt(event->pos().y()) : -1;
+            if (!entity_model_ || row >= 0) {
+                event->acceptProposedAction();
+                addMail(row, mail);
+                return;
+            }
+        }
+
+        // Several files, or a folder, are added at once without a dialog
+        QStringList files;
+        bool folder = false;
+        if (mime->hasUrls()) {
+            for(const auto& url : mime->urls()) {
+                if (url.isLocalFile()) {
+                    files << url.toLocalFile();
+                    folder = folder || QFileInfo{files.last()}.isDir();
+                }
+            }
+        }
+
+        if (files.size() > 1 || folder) {
+            const auto row = entity_model_ ? rowAt(event->pos().y()) : -1;
+            if (!entity_model_ || row >= 0) {
+                event->acceptProposedAction();
+                addFiles(row, files);
+                return;
+            }
+        }
+
         if (mime->hasUrls() && !mime->urls().isEmpty()) {
             const auto url = mime->urls().first();
             //const auto type = Document::deduceType(url);
@@ -104,7 +152,7 @@ void TableViewWithDrop::dropEvent(QDropEvent *event)
     }
 }
 
-void TableViewWithDrop::addDocument(const int row, const QUrl& url)
+int TableViewWithDrop::entityId(const int row)
 {
     int id = -1;
     if (row >= 0) {
@@ -115,7 +163,7 @@ void TableViewWithDrop::addDocument(const int row, const QUrl& url)
             QMessageBox::warning(this, "Failed to get the ID for the entity",
                                  "You must drop on an item in the list");
             qWarning() << "Failed to get the ID for the entity";
-            return;
+            return -1;
         }
 
     } else {
@@ -126,27 +174,27 @@ void TableViewWithDrop::addDocument(const int row, const QUrl& url)
         QMessageBox::warning(this, "No entity id to drop to",
                              "You must drop on an item in the list");
         qWarning() << "No entity id to drop to";
-        return;
+        return -1;
     }
 
-    const auto type = Document::deduceType(url);
+    return id;
+}
 
-    int contact = contact_id_, person = 0, intent = 0, action = 0;
-    if (entity_ == Document::Entity::CONTACT) {
-        contact = id;
-    } else if (entity_ == Document::Entity::PERSON) {
-        person = id;
-    } else if (entity_ == Document::Entity::INTENT) {
-        intent = id;
-    } else if (entity_ == Document::Entity::ACTION) {
-        action = id;
+void TableViewWithDrop::addDocument(const int row, const QUrl& url)
+{
+    const auto id = entityId(row);
+    if (id < 0) {
+        return;
     }
 
-    auto rec = document_model_->getRecord(contact,
+    const auto type = Document::deduceType(url);
+    const auto to = target(id);
+
+    auto rec = document_model_->getRecord(to.contact,
                                            type,
                                            Document::Class::NOTE,
                                            Document::Direction::INTERNAL,
-                                           entity_, person, intent, action);
+                                           entity_, to.person, to.intent, to.action);
     rec.setValue("location", url.toString());
 
     if (type == Document::Type::FILE) {
@@ -155,6 +203,7 @@ void TableViewWithDrop::addDocument(const int row, const QUrl& url)
         const auto name = fi.fileName();
         rec.setValue("name", name);
         rec.setValue("file_date", fi.lastModified());
+        rec.setValue("file_size", fi.size());
     }
 
     auto dlg = new DocumentDialog(rec, 0, this);
@@ -164,3 +213,89 @@ void TableViewWithDrop::addDocument(const int row, const QUrl& url)
     dlg->exec();
 
 }
+
+FileDropTarget TableViewWithDrop::target(const int id) const
+{
+    FileDropTarget to;
+    to.contact = contact_id_;
+    to.entity = entity_;
+    if (entity_ == Document::Entity::CONTACT) {
+        to.contact = id;
+    } else if (entity_ == Document::Entity::PERSON) {
+        to.person = id;
+    } else if (entity_ == Document::Entity::INTENT) {
+        to.intent = id;
+    } else if (entity_ == Document::Entity::ACTION) {
+        to.action = id;
+    }
+    return to;
+}
+
+void TableViewWithDrop::addFiles(const int row, const QStringList &paths)
+{
+    const auto id = entityId(row);
+    if (id < 0) {
+        return;
+    }
+
+    const auto to = target(id);
+    auto progress = new QProgressDialog("Adding files...", "Cancel", 0, 0, this);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+
+    auto drop = new FileDrop(to, this);
+    connect(progress, &QProgressDialog::canceled, drop, [drop] {
+        drop->cancel();
+    });
+    connect(drop, &FileDrop::progress, progress, [progress](int done, int total) {
+        progress->setMaximum(total);
+        progress->setValue(done);
+    });
+    connect(drop, &FileDrop::finished, this,
+            [this, drop, progress, to](const FileDropSummary& summary) {
+        progress->deleteLater();
+        drop->deleteLater();
+
+        // The rows were added on another connection
+        Database::instance().detailCache().invalidate(to.contact);
+        document_model_->select();
+        JournalModel::instance().select();
+
+        if (!summary.error.isEmpty()) {
+            QMessageBox::warning(this, "Failed to add the files",
+                                 QStringLiteral("%1\n%2").arg(summary.error, summary.text()));
+        } else if (!summary.cancelled) {
+            QMessageBox::information(this, "Added files", summary.text());
+        }
+    });
+
+    drop->start(paths);
+}
+
+void TableViewWithDrop::addMail(const int row, const QStringList &paths)
+{
+    const auto id = entityId(row);
+    if (id < 0) {
+        return;
+    }
+
+    const auto to = target(id);
+    const auto contact = to.contact;
+
+    auto ingester = new MailIngester(this);
+    connect(ingester, &MailIngester::finished, this,
+            [this, ingester, contact](const MailIngestSummary& summary) {
+        ingester->deleteLater();
+
+        // The rows were added on another connection
+        Database::instance().detailCache().invalidate(contact);
+        document_model_->select();
+        JournalModel::instance().select();
+
+        if (!summary.error.isEmpty()) {
+            QMessageBox::warning(this, "Failed to add the mail", summary.error);
+        }
+    });
+
+    ingester->start(paths, to.contact, to.person);
+}
@@ -4,6 +4,7 @@
 #include "document.h"
 #include "documentsmodel.h"
 #include "documentdialog.h"
+#include "filedrop.h"
 #include <QTableView>
 
 
@@ -26,8 +27,17 @@ protected:
     void dropEvent(QDropEvent *event) override;
 
 private:
+    // The id of the entity at row, or of the pane if row is -1. Returns -1 on error.
+    int entityId(const int row);
+    FileDropTarget target(const int id) const;
     void addDocument(const int row, const QUrl& url);
 
+    // Add many files without a dialog, with a FileDrop
+    void addFiles(const int row, const QStringList& paths);
+
+    // Link dropped .eml files to the contact or person, with a MailIngester
+    void addMail(const int row, const QStringList& paths);
+
     bool enabled_ = false;
     DocumentsModel *document_model_ = {};
     QSqlTableModel *entity_model_ = {};
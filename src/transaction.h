@@ -0,0 +1,47 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include "database.h"
+
+// Scope for one unit of work on the applications database connection.
+//
+// Everything done while the scope is alive, including journal entries,
+// is committed together by commit(). If the scope ends without a
+// commit, the work is rolled back. Scopes can be nested; only the
+// outermost one talks to the database, and a rollback in an inner
+// scope makes the outer commit fail.
+class Transaction {
+public:
+    Transaction(Database& db = Database::instance())
+        : db_{db}, active_{db_.beginTransaction()}
+    {
+    }
+
+    ~Transaction() {
+        rollback();
+    }
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator = (const Transaction&) = delete;
+
+    bool commit() {
+        if (!active_) {
+            return false;
+        }
+        active_ = false;
+        return db_.commitTransaction();
+    }
+
+    void rollback() {
+        if (active_) {
+            active_ = false;
+            db_.rollbackTransaction();
+        }
+    }
+
+private:
+    Database& db_;
+    bool active_ = false;
+};
+
+#endif // TRANSACTION_H
@@ -7,69 +7,66 @@
 
 #include "action.h"
 #include "contact.h"
+#include "database.h"
 
-UpcomingModel::UpcomingModel(QSettings &settings, QObject *parent, Mode mode)
-    : QSqlQueryModel{parent}
-    , mode_{mode}
-    , settings_{settings}
+namespace {
+
+// start_date < strftime('%s', date('now')), computed here so the
+// (state, start_date) index can be used for the range.
+uint startOfTodayUtc()
 {
-    select();
+    return QDateTime(QDateTime::currentDateTimeUtc().date(), QTime(0, 0), Qt::UTC).toTime_t();
 }
 
-void UpcomingModel::setContact(int contact)
+} // anonymous namespace
+
+UpcomingActionsModel::UpcomingActionsModel(QObject *parent)
+    : QSqlQueryModel{parent}
 {
-    contact_ = contact;
+    refresh_timer_.setSingleShot(true);
+    refresh_timer_.setInterval(0);
+    connect(&refresh_timer_, &QTimer::timeout, this, &UpcomingActionsModel::select);
+
     select();
 }
 
-void UpcomingModel::select()
+void UpcomingActionsModel::refresh()
 {
-    //beginResetModel();
-    setQuery(createQuery());
-    //endResetModel();
+    refresh_timer_.start();
 }
 
-QSqlQuery UpcomingModel::createQuery() const
+void UpcomingActionsModel::select()
 {
-    QString where_statement;
-
-    switch(mode_) {
+    refresh_timer_.stop();
 
-    case Mode::CONTACT_UPCOMING:
-        where_statement = QStringLiteral(
-                    "a.contact = %1 AND a.state < 4 AND a.start_date < (strftime('%s', date('now')))")
-                .arg(contact_);
-        break;
-    case Mode::TODAY:
-        where_statement = QStringLiteral(
-                    "a.state == 1 AND a.start_date < (strftime('%s', date('now')))");
-        break;
-    case Mode::UPCOMING:
-        where_statement = QStringLiteral(
-                    "a.state < 4 AND a.start_date < (strftime('%s', date('now')))");
-        break;
-    }
-
-    const auto sql_statement = QStringLiteral(
-            "SELECT a.id, a.state, a.start_date, a.contact, c.name,  c.status, a.intent, i.abstract, a.person, p.name, a.name, a.due_date, a.desired_outcome "
+    // Everything before DONE. Listing the states lets sqlite seek the
+    // start_date range for each of them in the index.
+    static const QString sql_statement = QStringLiteral(
+            "SELECT a.id, a.state, a.start_date, a.contact, c.name,  c.status, a.intent, i.abstract, a.person, NULL, a.name, a.due_date, a.desired_outcome "
                  "FROM action as a "
                  "LEFT JOIN contact as c on c.id = a.contact "
                  "LEFT JOIN intent as i on i.id = a.intent "
-                 "LEFT JOIN contact as p on p.id = a.person "
-                 "WHERE %1 "
-                 "ORDER BY a.start_date ASC "
-                ).arg(where_statement);
+                 "WHERE a.state IN (0, 1, 2, 3) AND a.start_date < ? "
+                 "ORDER BY a.start_date ASC ");
 
     QSqlQuery query;
-    if (!query.exec(sql_statement)) {
+    query.prepare(sql_statement);
+    query.addBindValue(startOfTodayUtc());
+    if (!query.exec()) {
         qWarning() << "Failed to query for the actions: " << query.lastError()
                    << " Query: " << sql_statement;
     }
 
-    return query;
+    setQuery(query);
+
+    // The lists filter on all the rows, and this way the statement is
+    // done and don't keep a read-transaction open.
+    while(canFetchMore()) {
+        fetchMore();
+    }
 }
 
-QVariant UpcomingModel::data(const QModelIndex &ix, int role) const
+QVariant UpcomingActionsModel::data(const QModelIndex &ix, int role) const
 {
     if (ix.isValid()) {
         if (role == Qt::DisplayRole || role == Qt::EditRole) {
@@ -81,6 +78,12 @@ QVariant UpcomingModel::data(const QModelIndex &ix, int role) const
                 return when.date();
             }
 
+            if (ix.column() == H_PERSON_NAME) {
+                const auto cix = index(ix.row(), H_PERSON_ID, {});
+                return Database::instance().contactNames().name(
+                            QSqlQueryModel::data(cix, Qt::DisplayRole).toInt());
+            }
+
         } else if (role == Qt::DecorationRole) {
             if (ix.column() == H_START_DATE) {
                 const auto cix = index(ix.row(), H_STATE, {});
@@ -96,10 +99,6 @@ QVariant UpcomingModel::data(const QModelIndex &ix, int role) const
                 return GetActionStateIcon(std::max(0, QSqlQueryModel::data(ix, Qt::DisplayRole).toInt()));
             }
 
-            if (ix.column() == H_STATE) {
-                return GetActionStateIcon(std::max(0, QSqlQueryModel::data(ix, Qt::DisplayRole).toInt()));
-            }
-
             if (ix.column() == H_CONTACT_STATUS) {
                 return GetContactStatusIcon(std::max(0, QSqlQueryModel::data(ix, Qt::DisplayRole).toInt()));
             }
@@ -112,3 +111,35 @@ QVariant UpcomingModel::data(const QModelIndex &ix, int role) const
 
     return QSqlQueryModel::data(ix, role);
 }
+
+
+UpcomingModel::UpcomingModel(UpcomingActionsModel &actions, QObject *parent, Mode mode)
+    : QSortFilterProxyModel{parent}
+    , mode_{mode}
+{
+    setSourceModel(&actions);
+}
+
+void UpcomingModel::setContact(int contact)
+{
+    contact_ = contact;
+    invalidateFilter();
+}
+
+bool UpcomingModel::filterAcceptsRow(int row, const QModelIndex &parent) const
+{
+    const auto value = [&](const int col) {
+        return sourceModel()->data(sourceModel()->index(row, col, parent), Qt::EditRole).toInt();
+    };
+
+    switch(mode_) {
+    case Mode::CONTACT_UPCOMING:
+        return contact_ != NO_SELECTION && value(H_CONTACT_ID) == contact_;
+    case Mode::TODAY:
+        return value(H_STATE) == static_cast<int>(ActionState::OPEN);
+    case Mode::UPCOMING:
+        return true;
+    }
+
+    return false;
+}
@@ -2,19 +2,19 @@
 #define UPCOMINGMODEL_H
 
 #include <QSettings>
+#include <QSortFilterProxyModel>
 #include <QSqlQueryModel>
+#include <QTimer>
 
-
-class UpcomingModel : public QSqlQueryModel
+// All the actions that are not done and have started, for the
+// Today, Upcoming and contact Upcoming lists.
+//
+// The rows are selected once per change and shared by the UpcomingModel
+// projections, so the lists don't each run the same query.
+class UpcomingActionsModel : public QSqlQueryModel
 {
     Q_OBJECT
 public:
-    enum class Mode {
-        CONTACT_UPCOMING,
-        TODAY,
-        UPCOMING
-    };
-
     enum Headers {
       H_ID,
       H_STATE,
@@ -31,22 +31,59 @@ public:
       H_DESIRED_OUTCOME
     };
 
-    constexpr static int NO_SELECTION = -1;
-
-    UpcomingModel(QSettings& settings, QObject *parent, Mode mode);
+    explicit UpcomingActionsModel(QObject *parent);
 
     QVariant data(const QModelIndex &index, int role) const override;
 
-
 public slots:
-    void setContact(int contact = NO_SELECTION);
+    // Select again when we get back to the event loop. Several calls
+    // for the same change give one select.
+    void refresh();
+
     void select();
 
 private:
-    QSqlQuery createQuery() const;
+    QTimer refresh_timer_;
+};
 
+// One of the lists over UpcomingActionsModel
+class UpcomingModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    enum class Mode {
+        CONTACT_UPCOMING,
+        TODAY,
+        UPCOMING
+    };
+
+    using Headers = UpcomingActionsModel::Headers;
+    static constexpr Headers H_ID = UpcomingActionsModel::H_ID;
+    static constexpr Headers H_STATE = UpcomingActionsModel::H_STATE;
+    static constexpr Headers H_START_DATE = UpcomingActionsModel::H_START_DATE;
+    static constexpr Headers H_CONTACT_ID = UpcomingActionsModel::H_CONTACT_ID;
+    static constexpr Headers H_CONTACT_NAME = UpcomingActionsModel::H_CONTACT_NAME;
+    static constexpr Headers H_CONTACT_STATUS = UpcomingActionsModel::H_CONTACT_STATUS;
+    static constexpr Headers H_INTENT_ID = UpcomingActionsModel::H_INTENT_ID;
+    static constexpr Headers H_INTENT_ABSTRACT = UpcomingActionsModel::H_INTENT_ABSTRACT;
+    static constexpr Headers H_PERSON_ID = UpcomingActionsModel::H_PERSON_ID;
+    static constexpr Headers H_PERSON_NAME = UpcomingActionsModel::H_PERSON_NAME;
+    static constexpr Headers H_NAME = UpcomingActionsModel::H_NAME;
+    static constexpr Headers H_DUE_DATE = UpcomingActionsModel::H_DUE_DATE;
+    static constexpr Headers H_DESIRED_OUTCOME = UpcomingActionsModel::H_DESIRED_OUTCOME;
+
+    constexpr static int NO_SELECTION = -1;
+
+    UpcomingModel(UpcomingActionsModel& actions, QObject *parent, Mode mode);
+
+public slots:
+    void setContact(int contact = NO_SELECTION);
+
+protected:
+    bool filterAcceptsRow(int row, const QModelIndex &parent) const override;
+
+private:
     const Mode mode_;
-    QSettings& settings_;
     int contact_ = NO_SELECTION;
 };
 
@@ -1,5 +1,7 @@
 #include "src/utility.h"
 
+#include <QCryptographicHash>
+#include <QFile>
 
 time_t ToTime(const QDate &date)
 {
@@ -11,3 +13,35 @@ time_t ToTime(const QDate &date)
 
     return std::mktime(&tm);
 }
+
+QVariant NullIfZero(const int value)
+{
+    return value ? QVariant{value} : QVariant{QVariant::Int};
+}
+
+QString HashFile(const QString &path, const std::atomic_bool *cancelled)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QCryptographicHash hasher(QCryptographicHash::Sha256);
+    QByteArray buffer(1024 * 1024, '\0');
+    while(true) {
+        if (cancelled && *cancelled) {
+            return {};
+        }
+
+        const auto bytes = file.read(buffer.data(), buffer.size());
+        if (bytes < 0) {
+            return {};
+        }
+        if (bytes == 0) {
+            break;
+        }
+        hasher.addData(buffer.constData(), static_cast<int>(bytes));
+    }
+
+    return QString::fromLatin1(hasher.result().toHex());
+}
@@ -1,10 +1,20 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
+#include <atomic>
 #include <ctime>
 #include <QDate>
+#include <QString>
+#include <QVariant>
 
 time_t ToTime(const QDate& date);
 
+// A NULL for the optional references (person, intent, activity) that are 0
+QVariant NullIfZero(const int value);
+
+// SHA-256 of a files content, hex encoded, like the BlobStore hashes.
+// Returns an empty string if the file can not be read, or if cancelled.
+QString HashFile(const QString& path, const std::atomic_bool *cancelled = nullptr);
+
 
 #endif // UTILITY_H
@@ -0,0 +1,60 @@
+#ifndef WORKERHOST_H
+#define WORKERHOST_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+
+#include "database.h"
+
+// Runs a worker object (with a WorkerConnection) on its own thread, for
+// the controller that owns it.
+//
+// With an in-memory database the worker stays in the calling thread, and
+// post() runs the work at once. The destructor stops the thread and waits
+// for the worker, so set the workers cancel flag before it runs, and
+// declare the flag before the host.
+template <typename T>
+class WorkerHost
+{
+public:
+    explicit WorkerHost(T *worker, const QThread::Priority priority = QThread::InheritPriority)
+        : worker_{worker}
+    {
+        if (Database::instance().path() != ":memory:") {
+            worker_->moveToThread(&thread_);
+            QObject::connect(&thread_, &QThread::finished, worker_, &QObject::deleteLater);
+            thread_.start(priority);
+        }
+    }
+
+    ~WorkerHost() {
+        if (thread_.isRunning()) {
+            thread_.quit();
+            thread_.wait();
+        } else {
+            delete worker_;
+        }
+    }
+
+    WorkerHost(const WorkerHost&) = delete;
+    WorkerHost& operator = (const WorkerHost&) = delete;
+
+    T *worker() const noexcept { return worker_; }
+
+    // Call fn in the workers thread
+    template <typename Fn>
+    void post(Fn fn) {
+        if (thread_.isRunning()) {
+            QTimer::singleShot(0, worker_, std::move(fn));
+        } else {
+            fn();
+        }
+    }
+
+private:
+    QThread thread_;
+    T *worker_ = {};
+};
+
+#endif // WORKERHOST_H